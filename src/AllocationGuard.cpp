@@ -0,0 +1,78 @@
+#include "./AllocationGuard.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+namespace hwm {
+
+namespace {
+	thread_local int g_allocation_guard_depth = 0;
+}
+
+AllocationGuard::AllocationGuard()
+{
+	++g_allocation_guard_depth;
+}
+
+AllocationGuard::~AllocationGuard()
+{
+	--g_allocation_guard_depth;
+}
+
+bool AllocationGuard::IsActive()
+{
+	return g_allocation_guard_depth > 0;
+}
+
+AllocationGuardSuspender::AllocationGuardSuspender()
+	:	saved_depth_(g_allocation_guard_depth)
+{
+	g_allocation_guard_depth = 0;
+}
+
+AllocationGuardSuspender::~AllocationGuardSuspender()
+{
+	g_allocation_guard_depth = saved_depth_;
+}
+
+}	// ::hwm
+
+#if defined(_DEBUG)
+
+//! デバッグビルドでのみ、グローバルなoperator new/deleteを置き換えて、
+//! AllocationGuardが有効なスレッドでのメモリ確保を検出する。
+namespace {
+
+void * GuardedAllocate(std::size_t size)
+{
+	assert(!hwm::AllocationGuard::IsActive() && "memory allocation in real-time context");
+	if(size == 0) { size = 1; }
+	void *p = std::malloc(size);
+	if(!p) { throw std::bad_alloc(); }
+	return p;
+}
+
+}	// unnamed
+
+void * operator new(std::size_t size) { return GuardedAllocate(size); }
+void * operator new[](std::size_t size) { return GuardedAllocate(size); }
+
+void * operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+	try { return GuardedAllocate(size); } catch(...) { return nullptr; }
+}
+
+void * operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+	try { return GuardedAllocate(size); } catch(...) { return nullptr; }
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::nothrow_t const &) noexcept { std::free(p); }
+void operator delete[](void *p, std::nothrow_t const &) noexcept { std::free(p); }
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "./ScopeExit.hpp"
+
+namespace hwm {
+
+//! リアルタイムスレッドで実行されるコードの中でヒープ確保が行われていないことを検証するためのクラス
+/*!
+	デバッグビルド(_DEBUG)では、グローバルなoperator newを置き換えて、
+	AllocationGuardが有効な間にメモリ確保が行われるとassertする。
+	リリースビルドではなにもしない。
+	チェックはスレッドごとに行われるため、他のスレッドでのメモリ確保には影響しない。
+*/
+struct AllocationGuard
+{
+	AllocationGuard();
+	~AllocationGuard();
+
+	AllocationGuard(AllocationGuard const &) = delete;
+	AllocationGuard & operator=(AllocationGuard const &) = delete;
+
+	//! 現在のスレッドでメモリ確保が禁止されているかどうか
+	static bool IsActive();
+};
+
+//! AllocationGuardのスコープ内で、一時的にメモリ確保を許可するためのクラス
+struct AllocationGuardSuspender
+{
+	AllocationGuardSuspender();
+	~AllocationGuardSuspender();
+
+	AllocationGuardSuspender(AllocationGuardSuspender const &) = delete;
+	AllocationGuardSuspender & operator=(AllocationGuardSuspender const &) = delete;
+
+private:
+	int saved_depth_;
+};
+
+}	// ::hwm
+
+#if defined(_DEBUG)
+#define HWM_ASSERT_NO_ALLOCATION() \
+	hwm::AllocationGuard HWM_SCOPE_EXIT_CAT(hwm_allocation_guard_, __LINE__)
+#define HWM_ALLOW_ALLOCATION() \
+	hwm::AllocationGuardSuspender HWM_SCOPE_EXIT_CAT(hwm_allocation_guard_suspender_, __LINE__)
+#else
+#define HWM_ASSERT_NO_ALLOCATION()
+#define HWM_ALLOW_ALLOCATION()
+#endif
@@ -0,0 +1,24 @@
+#include "./AudioDevice.hpp"
+
+#include <stdexcept>
+
+#include "./NullAudioDevice.hpp"
+#include "./PortAudioDevice.hpp"
+
+namespace hwm {
+
+std::unique_ptr<AudioDevice>
+		CreateAudioDevice(std::string const &driver_name)
+{
+	if(driver_name == "portaudio") {
+		return std::unique_ptr<AudioDevice>(new PortAudioDevice());
+	} else if(driver_name == "null") {
+		return std::unique_ptr<AudioDevice>(new NullAudioDevice(NullAudioDevice::Mode::kPaced));
+	} else if(driver_name == "null-free") {
+		return std::unique_ptr<AudioDevice>(new NullAudioDevice(NullAudioDevice::Mode::kFreeRunning));
+	}
+
+	throw std::runtime_error("unknown audio driver : " + driver_name);
+}
+
+}	// ::hwm
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace hwm {
+
+//! オーディオの入出力を行うドライバーの基底クラス
+/*!
+	Open()で指定したコールバックを、ドライバーのオーディオスレッドからブロックごとに呼び出す。
+	コールバックにはチャンネルごとのバッファが渡される。
+*/
+class AudioDevice
+{
+public:
+	//! オーディオスレッドから呼び出されるコールバック
+	/*!
+		inputsはnum_inputs個、outputsはnum_outputs個のチャンネルの先頭ポインタの配列で、
+		各チャンネルはnum_frames個のサンプルを持つ。num_framesはブロックサイズを超えない。
+	*/
+	typedef std::function<void(float const * const * inputs, size_t num_inputs,
+							   float ** outputs, size_t num_outputs,
+							   size_t num_frames)> callback_t;
+
+	struct Config
+	{
+		Config()
+			:	sampling_rate_(44100)
+			,	block_size_(512)
+			,	num_inputs_(0)
+			,	num_outputs_(2)
+		{}
+
+		int		sampling_rate_;
+		size_t	block_size_;
+		size_t	num_inputs_;
+		size_t	num_outputs_;
+	};
+
+	AudioDevice() : num_xruns_(0) {}
+	virtual ~AudioDevice() {}
+
+	AudioDevice(AudioDevice const &) = delete;
+	AudioDevice & operator=(AudioDevice const &) = delete;
+
+	//! @throw std::runtime_error デバイスを開けなかった場合
+	virtual void	Open(Config const &config, callback_t callback) = 0;
+	virtual void	Close() = 0;
+	virtual bool	IsOpened() const = 0;
+
+	//! @throw std::runtime_error 開始できなかった場合
+	virtual void	Start() = 0;
+	virtual void	Stop() = 0;
+
+	virtual char const *
+					GetDriverName() const = 0;
+
+	virtual Config const &
+					GetConfig() const = 0;
+
+	//! これまでに発生したアンダーラン/オーバーランの回数
+	size_t			GetNumXruns() const { return num_xruns_.load(std::memory_order_relaxed); }
+
+protected:
+	void			AddXrun() { num_xruns_.fetch_add(1, std::memory_order_relaxed); }
+	void			ResetXruns() { num_xruns_.store(0, std::memory_order_relaxed); }
+
+private:
+	std::atomic<size_t>	num_xruns_;
+};
+
+//! driver_nameのドライバーを作成する。
+/*!
+	"portaudio" : PortAudioのデフォルトデバイス
+	"null"      : サウンドカードを使用しないNullAudioDevice(実時間のペースで処理する)
+	"null-free" : 待機せずに処理し続けるNullAudioDevice
+	@throw std::runtime_error 不明なドライバー名の場合
+*/
+std::unique_ptr<AudioDevice>
+		CreateAudioDevice(std::string const &driver_name);
+
+}	// ::hwm
@@ -0,0 +1,125 @@
+#include "./AudioTap.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+namespace hwm {
+
+AudioTap::AudioTap(size_t num_channels, size_t sampling_rate, size_t capacity, OverflowPolicy policy)
+	:	sampling_rate_(sampling_rate)
+	,	policy_(policy)
+	,	read_pos_(0)
+	,	write_pos_(0)
+	,	pending_samples_(0)
+	,	num_dropped_samples_(0)
+{
+	assert(capacity > 0);
+	size_t n = 1;
+	while(n < capacity) { n <<= 1; }
+	buffer_.resize(num_channels, n);
+	mask_ = n - 1;
+}
+
+bool AudioTap::BeginWrite(size_t num_samples)
+{
+	assert(pending_samples_ == 0);
+
+	size_t const capacity = GetCapacity();
+	if(num_samples > capacity) {
+		num_dropped_samples_.fetch_add(num_samples, std::memory_order_relaxed);
+		return false;
+	}
+
+	size_t const write_pos = write_pos_.load(std::memory_order_relaxed);
+	for( ; ; ) {
+		size_t const used = write_pos - read_pos_.load(std::memory_order_acquire);
+		if(capacity - used >= num_samples) {
+			break;
+		}
+
+		if(policy_ == OverflowPolicy::kDrop) {
+			num_dropped_samples_.fetch_add(num_samples, std::memory_order_relaxed);
+			return false;
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(500));
+	}
+
+	pending_samples_ = num_samples;
+	return true;
+}
+
+void AudioTap::WriteChannels(size_t first_channel, float const * const * channels, size_t num_channels)
+{
+	assert(first_channel + num_channels <= GetNumChannels());
+
+	if(pending_samples_ == 0) {
+		return;
+	}
+
+	size_t const pos = write_pos_.load(std::memory_order_relaxed) & mask_;
+	size_t const first_part = std::min(pending_samples_, GetCapacity() - pos);
+	size_t const second_part = pending_samples_ - first_part;
+
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		float *dest = buffer_.data()[first_channel + ch];
+		std::copy_n(channels[ch], first_part, dest + pos);
+		std::copy_n(channels[ch] + first_part, second_part, dest);
+	}
+}
+
+void AudioTap::EndWrite()
+{
+	if(pending_samples_ == 0) {
+		return;
+	}
+
+	write_pos_.store(write_pos_.load(std::memory_order_relaxed) + pending_samples_, std::memory_order_release);
+	pending_samples_ = 0;
+}
+
+bool AudioTap::Write(float const * const * channels, size_t num_samples)
+{
+	if(!BeginWrite(num_samples)) {
+		return false;
+	}
+	WriteChannels(0, channels, GetNumChannels());
+	EndWrite();
+	return true;
+}
+
+size_t AudioTap::GetNumWritable() const
+{
+	return GetCapacity() - (write_pos_.load(std::memory_order_relaxed) - read_pos_.load(std::memory_order_acquire));
+}
+
+size_t AudioTap::GetNumReadable() const
+{
+	return write_pos_.load(std::memory_order_acquire) - read_pos_.load(std::memory_order_relaxed);
+}
+
+size_t AudioTap::Read(float * const * dest, size_t max_samples)
+{
+	size_t const read_pos = read_pos_.load(std::memory_order_relaxed);
+	size_t const num_samples = std::min(max_samples, write_pos_.load(std::memory_order_acquire) - read_pos);
+	if(num_samples == 0) {
+		return 0;
+	}
+
+	size_t const pos = read_pos & mask_;
+	size_t const first_part = std::min(num_samples, GetCapacity() - pos);
+	size_t const second_part = num_samples - first_part;
+
+	for(size_t ch = 0; ch < GetNumChannels(); ++ch) {
+		float const *src = buffer_.data()[ch];
+		std::copy_n(src + pos, first_part, dest[ch]);
+		std::copy_n(src, second_part, dest[ch] + first_part);
+	}
+
+	read_pos_.store(read_pos + num_samples, std::memory_order_release);
+	return num_samples;
+}
+
+}	// ::hwm
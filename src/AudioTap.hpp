@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "./Buffer.hpp"
+
+namespace hwm {
+
+//! オーディオスレッドの出力を、別の1つのスレッドへコピーして受け渡すためのリングバッファ
+/*!
+	書き込みは1つのスレッド(オーディオスレッド)から、読み出しは別の1つのスレッドからのみ行う。
+	どちらの操作もロックやメモリ確保を行わない。
+
+	複数のバスの出力を1つのタップにまとめて書き込めるように、書き込みは
+	BeginWrite(), WriteChannels(), EndWrite()の3段階に分かれている。
+	EndWrite()を呼ぶまで、書き込んだサンプルは読み出し側に公開されない。
+*/
+class AudioTap
+{
+public:
+	//! リングバッファに空きがない時の振る舞い
+	enum class OverflowPolicy {
+		//! ブロックを破棄して、破棄したサンプル数を数える。リアルタイム処理用。
+		kDrop,
+		//! 空きができるまで待機する。オフラインレンダリング用。
+		kWait,
+	};
+
+	//! @param capacity 保持できるサンプル数。内部では2のべき乗に切り上げられる。
+	AudioTap(size_t num_channels, size_t sampling_rate, size_t capacity,
+			 OverflowPolicy policy = OverflowPolicy::kDrop);
+
+	AudioTap(AudioTap const &) = delete;
+	AudioTap & operator=(AudioTap const &) = delete;
+
+	size_t	GetNumChannels() const { return buffer_.channels(); }
+	size_t	GetSamplingRate() const { return sampling_rate_; }
+	size_t	GetCapacity() const { return buffer_.samples(); }
+
+	//! num_samplesサンプルの書き込みを開始する。書き込み側のスレッドから呼び出す。
+	//! @return 空きがなくブロックを破棄する場合はfalse。その場合もEndWrite()は呼び出してよい。
+	bool	BeginWrite(size_t num_samples);
+
+	//! [first_channel, first_channel + num_channels)のチャンネルに、BeginWriteで指定した長さのサンプルを書き込む
+	void	WriteChannels(size_t first_channel, float const * const * channels, size_t num_channels);
+
+	//! 書き込んだサンプルを読み出し側に公開する
+	void	EndWrite();
+
+	//! すべてのチャンネルを書き込む
+	bool	Write(float const * const * channels, size_t num_samples);
+
+	//! 書き込み可能なサンプル数。書き込み側のスレッドから呼び出す。
+	size_t	GetNumWritable() const;
+
+	//! 読み出し可能なサンプル数。読み出し側のスレッドから呼び出す。
+	size_t	GetNumReadable() const;
+
+	//! 最大でmax_samplesサンプルをdestに読み出す。読み出し側のスレッドから呼び出す。
+	//! destはGetNumChannels()個のチャンネルを持つこと。
+	//! @return 読み出したサンプル数
+	size_t	Read(float * const * dest, size_t max_samples);
+
+	//! 空きがなくて破棄されたサンプル数
+	std::uint64_t
+			GetNumDroppedSamples() const { return num_dropped_samples_.load(std::memory_order_relaxed); }
+
+private:
+	Buffer<float>				buffer_;
+	size_t						mask_;
+	size_t						sampling_rate_;
+	OverflowPolicy				policy_;
+	std::atomic<size_t>			read_pos_;
+	std::atomic<size_t>			write_pos_;
+	//! BeginWriteで指定されたサンプル数。ブロックを破棄する場合は0
+	size_t						pending_samples_;
+	std::atomic<std::uint64_t>	num_dropped_samples_;
+};
+
+}	// ::hwm
@@ -0,0 +1,295 @@
+#include "./AutomationLane.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace hwm {
+
+struct AutomationLane::Candidates
+{
+	Candidates()
+		:	size_(0)
+		,	overflowed_(false)
+	{}
+
+	//! 直前の点と同じオフセットの場合は、値を上書きする
+	void push(std::uint64_t offset, double value)
+	{
+		if(size_ > 0 && points_[size_ - 1].offset_ == static_cast<std::int32_t>(offset)) {
+			points_[size_ - 1].value_ = value;
+			return;
+		}
+
+		if(size_ == kMaxCandidates) {
+			overflowed_ = true;
+			return;
+		}
+
+		points_[size_].offset_ = static_cast<std::int32_t>(offset);
+		points_[size_].value_ = value;
+		++size_;
+	}
+
+	RenderedPoint	points_[kMaxCandidates];
+	size_t			size_;
+	bool			overflowed_;
+};
+
+void AutomationLane::AddPoint(std::uint64_t position, double value, float curve)
+{
+	auto const index = std::upper_bound(positions_.begin(), positions_.end(), position) - positions_.begin();
+	positions_.insert(positions_.begin() + index, position);
+	values_.insert(values_.begin() + index, value);
+	curves_.insert(curves_.begin() + index, curve);
+}
+
+void AutomationLane::Clear()
+{
+	positions_.clear();
+	values_.clear();
+	curves_.clear();
+}
+
+double AutomationLane::GetValueAt(std::uint64_t position) const
+{
+	if(empty()) {
+		return 0;
+	}
+	return Evaluate(FindRegion(position, 0), position);
+}
+
+size_t AutomationLane::FindRegion(std::uint64_t position, size_t hint) const
+{
+	size_t const n = positions_.size();
+	auto contains = [&](size_t region) {
+		return	(region == 0 || positions_[region - 1] <= position) &&
+				(region == n || position < positions_[region]);
+	};
+
+	//! 通常の再生では、前回の区間かその次の区間に含まれる
+	if(hint <= n && contains(hint)) {
+		return hint;
+	}
+	if(hint < n && contains(hint + 1)) {
+		return hint + 1;
+	}
+
+	return std::upper_bound(positions_.begin(), positions_.end(), position) - positions_.begin();
+}
+
+double AutomationLane::Evaluate(size_t region, std::uint64_t position) const
+{
+	if(region == 0) {
+		return values_.front();
+	}
+	if(region == positions_.size()) {
+		return values_.back();
+	}
+
+	std::uint64_t const p0 = positions_[region - 1];
+	std::uint64_t const p1 = positions_[region];
+	double const v0 = values_[region - 1];
+	double const v1 = values_[region];
+	double const curve = curves_[region - 1];
+
+	double const t = static_cast<double>(position - p0) / static_cast<double>(p1 - p0);
+	double const shape = (curve == 0) ? t : std::expm1(curve * t) / std::expm1(curve);
+	return v0 + (v1 - v0) * shape;
+}
+
+bool AutomationLane::IsCurved(size_t region) const
+{
+	return	region > 0 && region < positions_.size() &&
+			curves_[region - 1] != 0 &&
+			values_[region - 1] != values_[region];
+}
+
+void AutomationLane::Subdivide(size_t region,
+							   std::uint64_t block_start,
+							   std::uint64_t a, double fa,
+							   std::uint64_t b, double fb,
+							   double tolerance,
+							   Candidates &candidates) const
+{
+	if(b - a < 2 || candidates.overflowed_) {
+		return;
+	}
+
+	std::uint64_t const m = a + (b - a) / 2;
+	double const fm = Evaluate(region, m);
+	double const linear = fa + (fb - fa) * static_cast<double>(m - a) / static_cast<double>(b - a);
+	if(std::abs(fm - linear) <= tolerance) {
+		return;
+	}
+
+	Subdivide(region, block_start, a, fa, m, fm, tolerance, candidates);
+	candidates.push(m - block_start, fm);
+	Subdivide(region, block_start, m, fm, b, fb, tolerance, candidates);
+}
+
+bool AutomationLane::GenerateCandidates(std::uint64_t block_start, size_t num_samples, double tolerance,
+										size_t &region, Candidates &candidates) const
+{
+	size_t const n = positions_.size();
+	std::uint64_t const last = block_start + num_samples - 1;
+
+	std::uint64_t pos = block_start;
+	double value = Evaluate(region, pos);
+	candidates.push(0, value);
+
+	//! ブロック内にあるブレークポイントを順に処理する。
+	//! regionはblock_startを含む区間なので、positions_[region] > block_startになっている。
+	while(region < n && positions_[region] <= last) {
+		std::uint64_t const boundary = positions_[region];
+
+		size_t next = region + 1;
+		while(next < n && positions_[next] == boundary) {
+			++next;
+		}
+
+		//! 曲線の終点の値と、ブレークポイントを通過した後の値。同じ位置に複数ある場合は異なる。
+		double const left = values_[region];
+		double const right = values_[next - 1];
+
+		if(IsCurved(region)) {
+			Subdivide(region, block_start, pos, value, boundary, left, tolerance, candidates);
+		}
+
+		//! 不連続に変化する場合は、直前のサンプルまで元の曲線の値を保持させる
+		if(left != right) {
+			candidates.push(boundary - 1 - block_start, Evaluate(region, boundary - 1));
+		}
+		candidates.push(boundary - block_start, right);
+
+		region = next;
+		pos = boundary;
+		value = right;
+	}
+
+	double const last_value = Evaluate(region, last);
+	if(IsCurved(region)) {
+		Subdivide(region, block_start, pos, value, last, last_value, tolerance, candidates);
+	}
+	candidates.push(last - block_start, last_value);
+
+	return !candidates.overflowed_;
+}
+
+size_t AutomationLane::RenderBlock(std::uint64_t block_start,
+								   size_t num_samples,
+								   double tolerance,
+								   PlaybackState &state,
+								   RenderedPoint *dest,
+								   size_t max_points) const
+{
+	if(empty() || num_samples == 0 || max_points < 2) {
+		return 0;
+	}
+
+	size_t const start_region = FindRegion(block_start, state.region_);
+
+	//! 許容誤差を緩めていっても収まらない場合(不連続な変化が多すぎる場合など)は、末尾の点を切り捨てる
+	static constexpr int kMaxRetries = 16;
+
+	Candidates candidates;
+	size_t region = start_region;
+	size_t num_points = 0;
+	for(int retry = 0; retry <= kMaxRetries; ++retry, tolerance *= 2) {
+		candidates = Candidates();
+		region = start_region;
+		bool const fits = GenerateCandidates(block_start, num_samples, tolerance, region, candidates);
+
+		//! 始点(anchor)から候補を伸ばしていき、間の候補がすべて直線から
+		//! tolerance以内に収まらなくなったら、その直前の候補を次の始点にする。
+		//! 最後の候補のために、destの末尾を1つ空けておく。
+		auto const *points = candidates.points_;
+		size_t const size = candidates.size_;
+		bool truncated = false;
+		size_t anchor = 0;
+		num_points = 0;
+		dest[num_points++] = points[0];
+		for(size_t end = 2; end < size && !truncated; ++end) {
+			double const x0 = points[anchor].offset_;
+			double const slope =
+				(points[end].value_ - points[anchor].value_) / (points[end].offset_ - x0);
+			for(size_t i = anchor + 1; i < end; ++i) {
+				double const linear = points[anchor].value_ + slope * (points[i].offset_ - x0);
+				if(std::abs(points[i].value_ - linear) <= tolerance) {
+					continue;
+				}
+
+				if(num_points + 1 == max_points) {
+					truncated = true;
+				} else {
+					anchor = end - 1;
+					dest[num_points++] = points[anchor];
+				}
+				break;
+			}
+		}
+		if(size > 1) {
+			dest[num_points++] = points[size - 1];
+		}
+
+		if(fits && !truncated) {
+			break;
+		}
+	}
+
+	state.region_ = region;
+
+	//! プラグインは最後の点の値を保持するので、値が変化しない末尾の点は送らなくてよい
+	if(num_points >= 2 && dest[num_points - 1].value_ == dest[num_points - 2].value_) {
+		--num_points;
+	}
+
+	bool const unchanged =
+		state.has_last_value_ &&
+		std::all_of(dest, dest + num_points,
+					[&state](RenderedPoint const &pt) { return pt.value_ == state.last_value_; });
+	if(unchanged) {
+		return 0;
+	}
+
+	state.last_value_ = dest[num_points - 1].value_;
+	state.has_last_value_ = true;
+	return num_points;
+}
+
+AutomationLane & AutomationSet::GetLane(ParamID id)
+{
+	size_t const index = LowerBound(id);
+	if(index == ids_.size() || ids_[index] != id) {
+		ids_.insert(ids_.begin() + index, id);
+		lanes_.insert(lanes_.begin() + index, AutomationLane());
+		states_.insert(states_.begin() + index, AutomationLane::PlaybackState());
+	}
+	return lanes_[index];
+}
+
+AutomationLane const * AutomationSet::FindLane(ParamID id) const
+{
+	size_t const index = LowerBound(id);
+	if(index == ids_.size() || ids_[index] != id) {
+		return nullptr;
+	}
+	return &lanes_[index];
+}
+
+void AutomationSet::RemoveLane(ParamID id)
+{
+	size_t const index = LowerBound(id);
+	if(index == ids_.size() || ids_[index] != id) {
+		return;
+	}
+	ids_.erase(ids_.begin() + index);
+	lanes_.erase(lanes_.begin() + index);
+	states_.erase(states_.begin() + index);
+}
+
+size_t AutomationSet::LowerBound(ParamID id) const
+{
+	return std::lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin();
+}
+
+}	// ::hwm
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "pluginterfaces/vst/vsttypes.h"
+
+namespace hwm {
+
+//! 1つのパラメータのオートメーションを表す、ブレークポイントの曲線
+/*!
+	ブレークポイントの位置(サンプル)、値(正規化された値)、次のブレークポイントまでの曲率を、
+	それぞれ別の配列に保持する。再生位置の探索では位置の配列だけを走査する。
+
+	曲率が0の区間は直線で、0以外の区間は指数曲線で補間する。
+	曲率が正の場合は終点側で、負の場合は始点側で急に変化する。
+	同じ位置に複数のブレークポイントを置くと、その位置で値が不連続に変化する。
+	最初のブレークポイントより前では最初の値を、最後のブレークポイントより後では最後の値を保持する。
+*/
+class AutomationLane
+{
+public:
+	//! RenderBlockで出力される点
+	struct RenderedPoint
+	{
+		//! ブロックの先頭からのサンプル数
+		std::int32_t	offset_;
+		double			value_;
+	};
+
+	//! RenderBlockで再生位置を追跡するための状態。レーンごとに1つ用意する。
+	struct PlaybackState
+	{
+		PlaybackState()
+			:	region_(0)
+			,	last_value_(0)
+			,	has_last_value_(false)
+		{}
+
+		//! 前回のブロックの末尾を含む区間。その位置より前にあるブレークポイントの数
+		size_t	region_;
+		//! 前回までに出力した最後の値
+		double	last_value_;
+		bool	has_last_value_;
+	};
+
+	//! RenderBlockの許容誤差のデフォルト値
+	static constexpr double kDefaultTolerance = 1.0 / 1024;
+
+	//! ブレークポイントを追加する。
+	//! 同じ位置のブレークポイントがすでにある場合は、それらの後ろに追加する。
+	//! @param curve 次のブレークポイントまでの区間の曲率
+	void	AddPoint(std::uint64_t position, double value, float curve = 0);
+
+	void	Clear();
+
+	size_t	GetNumPoints() const { return positions_.size(); }
+	bool	empty() const { return positions_.empty(); }
+
+	std::uint64_t
+			GetPosition(size_t index) const { return positions_[index]; }
+	double	GetValue(size_t index) const { return values_[index]; }
+	float	GetCurve(size_t index) const { return curves_[index]; }
+
+	//! positionでの値を返す。ブレークポイントがない場合は0を返す。
+	double	GetValueAt(std::uint64_t position) const;
+
+	//! [block_start, block_start + num_samples)の曲線を、ブロック内のオフセットを持つ点の列に変換する
+	/*!
+		VST3のプラグインは点と点の間を直線で補間するので、
+		直線の区間はブロックの境界とブレークポイントの位置の点だけを出力し、
+		曲線の区間は、直線で近似した誤差がtolerance以下になるまで二分割していく。
+		さらに、前後の点を結ぶ直線からの誤差がtolerance以下に収まる点は間引く。
+		点の数がmax_pointsを超える場合は、toleranceを2倍にして変換し直す。
+
+		値が前回出力した値から変化していないブロックでは、点を出力しない。
+		メモリ確保を行わないので、オーディオスレッドから呼び出せる。
+
+		@return destに書き込んだ点の数
+	*/
+	size_t	RenderBlock(std::uint64_t block_start,
+						size_t num_samples,
+						double tolerance,
+						PlaybackState &state,
+						RenderedPoint *dest,
+						size_t max_points) const;
+
+private:
+	//! 1回の変換で生成する点の候補の最大数
+	static constexpr size_t kMaxCandidates = 64;
+
+	struct Candidates;
+
+	//! positionを含む区間を返す。hintの区間かその次の区間であれば、探索を行わない。
+	size_t	FindRegion(std::uint64_t position, size_t hint) const;
+	//! region番目の区間の曲線のpositionでの値
+	double	Evaluate(size_t region, std::uint64_t position) const;
+	bool	IsCurved(size_t region) const;
+
+	//! toleranceで点の候補を生成する。
+	//! @return 候補がkMaxCandidatesに収まらなかった場合はfalse
+	bool	GenerateCandidates(std::uint64_t block_start, size_t num_samples, double tolerance,
+							   size_t &region, Candidates &candidates) const;
+	void	Subdivide(size_t region,
+					  std::uint64_t block_start,
+					  std::uint64_t a, double fa,
+					  std::uint64_t b, double fb,
+					  double tolerance,
+					  Candidates &candidates) const;
+
+	std::vector<std::uint64_t>	positions_;
+	std::vector<double>			values_;
+	std::vector<float>			curves_;
+};
+
+//! ParamIDごとのAutomationLaneの集合
+/*!
+	Vst3Plugin::SetAutomationでオーディオスレッドに渡すと、
+	ProcessAudioのたびに再生位置のブロックの区間がパラメータの変更として送信される。
+	渡した後は、UIスレッドから変更してはならない。
+*/
+class AutomationSet
+{
+public:
+	typedef Steinberg::Vst::ParamID ParamID;
+
+	//! idのレーンを返す。まだなければ空のレーンを作成する。
+	AutomationLane &
+			GetLane(ParamID id);
+
+	//! @return idのレーンがなければnullptr
+	AutomationLane const *
+			FindLane(ParamID id) const;
+
+	void	RemoveLane(ParamID id);
+
+	size_t	GetNumLanes() const { return ids_.size(); }
+	ParamID	GetParamID(size_t index) const { return ids_[index]; }
+	AutomationLane const &
+			GetLaneByIndex(size_t index) const { return lanes_[index]; }
+	AutomationLane::PlaybackState &
+			GetPlaybackState(size_t index) { return states_[index]; }
+
+private:
+	size_t	LowerBound(ParamID id) const;
+
+	//! IDの昇順に並べたレーン
+	std::vector<ParamID>						ids_;
+	std::vector<AutomationLane>					lanes_;
+	std::vector<AutomationLane::PlaybackState>	states_;
+};
+
+}	// ::hwm
@@ -1,42 +1,151 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 namespace hwm {
 
+//! チャンネルごとにサンプルを保持するオーディオバッファ
+/*!
+	各チャンネルの先頭は64バイト境界にアラインされ、
+	チャンネル間の間隔(stride)はキャッシュラインの倍数にパディングされる。
+
+	reserveで確保した容量の範囲内でのresizeはメモリ確保を行わず、
+	チャンネルの先頭のポインタ(data()の各要素)も変化しないので、オーディオスレッドから呼び出してもよい。
+	容量を超えるresizeでは確保し直して、既存のサンプルをコピーする。
+	resizeによって新たに使用可能になった領域は0で初期化される。
+*/
 template<class T>
 struct Buffer
 {
 	typedef T value_type;
+
+	//! チャンネルの先頭のアライメント(バイト)
+	static constexpr size_t kAlignment = 64;
+
 	Buffer()
 		:	channel_(0)
 		,	sample_(0)
+		,	channel_capacity_(0)
+		,	sample_capacity_(0)
 	{}
 
 	Buffer(size_t num_channels, size_t num_samples)
+		:	Buffer()
 	{
 		resize(num_channels, num_samples);
 	}
 
+	Buffer(Buffer const &rhs)
+		:	Buffer()
+	{
+		*this = rhs;
+	}
+
+	Buffer & operator=(Buffer const &rhs)
+	{
+		if(this != &rhs) {
+			channel_ = 0;
+			sample_ = 0;
+			reserve(rhs.channel_capacity_, rhs.sample_capacity_);
+			resize(rhs.channels(), rhs.samples());
+			for(size_t ch = 0; ch < channels(); ++ch) {
+				std::copy_n(rhs.data()[ch], samples(), data()[ch]);
+			}
+		}
+		return *this;
+	}
+
+	Buffer(Buffer &&rhs)
+		:	Buffer()
+	{
+		swap(rhs);
+	}
+
+	Buffer & operator=(Buffer &&rhs)
+	{
+		Buffer(std::move(rhs)).swap(*this);
+		return *this;
+	}
+
+	void swap(Buffer &rhs)
+	{
+		std::swap(storage_, rhs.storage_);
+		std::swap(buffer_heads_, rhs.buffer_heads_);
+		std::swap(channel_, rhs.channel_);
+		std::swap(sample_, rhs.sample_);
+		std::swap(channel_capacity_, rhs.channel_capacity_);
+		std::swap(sample_capacity_, rhs.sample_capacity_);
+	}
+
 	size_t samples() const { return sample_; }
 	size_t channels() const { return channel_; }
 
+	size_t sample_capacity() const { return sample_capacity_; }
+	size_t channel_capacity() const { return channel_capacity_; }
+
+	//! チャンネル間の間隔(要素数)
+	size_t stride() const { return sample_capacity_; }
+
 	value_type ** data() { return buffer_heads_.data(); }
 	value_type const * const * data() const { return buffer_heads_.data(); }
 
+	//! 少なくともnum_channels x num_samplesの容量を確保する。
+	//! 容量が変化した場合は、既存のサンプルはコピーされ、チャンネルの先頭のポインタは変化する。
+	void reserve(size_t num_channels, size_t num_samples)
+	{
+		num_channels = std::max(num_channels, channel_capacity_);
+		num_samples = std::max(RoundUpSamples(num_samples), sample_capacity_);
+
+		if(num_channels == channel_capacity_ && num_samples == sample_capacity_) {
+			return;
+		}
+
+		size_t const num_bytes = num_channels * num_samples * sizeof(value_type) + kAlignment;
+		std::unique_ptr<char[]> new_storage(new char[num_bytes]);
+
+		void *aligned = new_storage.get();
+		size_t space = num_bytes;
+		std::align(kAlignment, num_channels * num_samples * sizeof(value_type), aligned, space);
+		value_type *new_base = static_cast<value_type *>(aligned);
+		std::fill_n(new_base, num_channels * num_samples, value_type());
+
+		std::vector<value_type *> new_heads(num_channels);
+		for(size_t ch = 0; ch < num_channels; ++ch) {
+			new_heads[ch] = new_base + (ch * num_samples);
+		}
+
+		for(size_t ch = 0; ch < channel_; ++ch) {
+			std::copy_n(buffer_heads_[ch], sample_, new_heads[ch]);
+		}
+
+		storage_.swap(new_storage);
+		buffer_heads_.swap(new_heads);
+		channel_capacity_ = num_channels;
+		sample_capacity_ = num_samples;
+	}
+
+	//! 容量の範囲内であればメモリ確保を行わない。
 	void resize(size_t num_channels, size_t num_samples)
 	{
-		std::vector<value_type> tmp(num_channels * num_samples);
-		std::vector<value_type *> tmp_heads(num_channels);
+		reserve(num_channels, num_samples);
+
+		//! 新たに使用可能になる領域を0で初期化する
+		for(size_t ch = 0; ch < std::min(channel_, num_channels); ++ch) {
+			if(num_samples > sample_) {
+				std::fill(buffer_heads_[ch] + sample_, buffer_heads_[ch] + num_samples, value_type());
+			}
+		}
+		for(size_t ch = channel_; ch < num_channels; ++ch) {
+			std::fill_n(buffer_heads_[ch], num_samples, value_type());
+		}
 
 		channel_ = num_channels;
 		sample_ = num_samples;
-
-		buffer_.swap(tmp);
-		buffer_heads_.swap(tmp_heads);
-		for(size_t i = 0; i < num_channels; ++i) {
-			buffer_heads_[i] = buffer_.data() + (i * num_samples);
-		}
 	}
 
 	void resize_samples(size_t num_samples)
@@ -49,12 +158,36 @@ struct Buffer
 		resize(num_channels, samples());
 	}
 
-public:
-	std::vector<value_type> buffer_;
+	//! 使用中の領域を0で埋める
+	void clear()
+	{
+		for(size_t ch = 0; ch < channel_; ++ch) {
+			std::fill_n(buffer_heads_[ch], sample_, value_type());
+		}
+	}
+
+	//! 指定したチャンネル数とサンプル数に必要な容量をすでに確保しているかどうか
+	bool fits(size_t num_channels, size_t num_samples) const
+	{
+		return num_channels <= channel_capacity_ && num_samples <= sample_capacity_;
+	}
+
+private:
+	//! strideがキャッシュラインの倍数になるように、サンプル数を切り上げる
+	static size_t RoundUpSamples(size_t num_samples)
+	{
+		size_t const unit = std::max<size_t>(kAlignment / sizeof(value_type), 1);
+		return (num_samples + unit - 1) / unit * unit;
+	}
+
+	std::unique_ptr<char[]> storage_;
+	//! channel_capacity_個のチャンネルの先頭。容量が変化しない限り変わらない。
 	std::vector<value_type *> buffer_heads_;
 
 	size_t channel_;
 	size_t sample_;
+	size_t channel_capacity_;
+	size_t sample_capacity_;
 };
 
 }	// hwm
@@ -0,0 +1,163 @@
+#include "./InputSource.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "debugger_output.hpp"
+
+namespace hwm {
+
+namespace {
+
+	//! ファイルの読み込みスレッドが一度に読み込むフレーム数
+	size_t const kFileReadFrames = 4096;
+	//! FileInputSource::Readでタップから一度に読み出すサンプル数
+	size_t const kFileTransferSamples = 1024;
+	auto const kFileReadInterval = std::chrono::milliseconds(2);
+
+}	// unnamed
+
+GeneratorInputSource::GeneratorInputSource(TestWaveform waveform, size_t sampling_rate)
+	:	wavetable_(TestWavetable::Get(waveform, sampling_rate))
+	,	pos_(0)
+{}
+
+void GeneratorInputSource::Read(float * const * dest, size_t num_channels, size_t num_samples)
+{
+	size_t next_pos = pos_;
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		next_pos = wavetable_->Read(pos_, dest[ch], num_samples);
+	}
+	pos_ = next_pos;
+}
+
+LiveInputSource::LiveInputSource(size_t first_device_channel, size_t num_channels)
+	:	first_device_channel_(first_device_channel)
+	,	heads_(num_channels)
+	,	device_inputs_(nullptr)
+	,	num_device_inputs_(0)
+	,	num_device_frames_(0)
+	,	consumed_(0)
+{}
+
+void LiveInputSource::SetDeviceInputs(float const * const * inputs, size_t num_inputs, size_t num_frames)
+{
+	device_inputs_ = inputs;
+	num_device_inputs_ = inputs ? num_inputs : 0;
+	num_device_frames_ = num_frames;
+	consumed_ = 0;
+}
+
+float const * const * LiveInputSource::ReadInPlace(size_t num_channels, size_t num_samples)
+{
+	if(num_channels > heads_.size() ||
+	   first_device_channel_ + num_channels > num_device_inputs_ ||
+	   consumed_ + num_samples > num_device_frames_)
+	{
+		return nullptr;
+	}
+
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		heads_[ch] = device_inputs_[first_device_channel_ + ch] + consumed_;
+	}
+	consumed_ += num_samples;
+	return heads_.data();
+}
+
+void LiveInputSource::Read(float * const * dest, size_t num_channels, size_t num_samples)
+{
+	size_t const available = std::min(num_samples, num_device_frames_ - std::min(consumed_, num_device_frames_));
+
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		size_t const device_channel = first_device_channel_ + ch;
+		if(ch < heads_.size() && device_channel < num_device_inputs_) {
+			std::copy_n(device_inputs_[device_channel] + consumed_, available, dest[ch]);
+			std::fill(dest[ch] + available, dest[ch] + num_samples, 0.0f);
+		} else {
+			std::fill_n(dest[ch], num_samples, 0.0f);
+		}
+	}
+	consumed_ += available;
+}
+
+FileInputSource::FileInputSource(String const &path, bool loop, size_t prefetch_samples)
+	:	loop_(loop)
+	,	stop_requested_(false)
+	,	num_underrun_samples_(0)
+{
+	reader_.Open(path);
+
+	tap_.reset(new AudioTap(reader_.GetNumChannels(),
+							static_cast<size_t>(reader_.GetSamplingRate()),
+							std::max(prefetch_samples, kFileReadFrames)));
+	read_buffer_.resize(reader_.GetNumChannels(), kFileTransferSamples);
+
+	thread_ = std::thread([this] { ThreadProc(); });
+}
+
+FileInputSource::~FileInputSource()
+{
+	stop_requested_.store(true);
+	thread_.join();
+}
+
+void FileInputSource::ThreadProc()
+{
+	Buffer<float> buffer(reader_.GetNumChannels(), kFileReadFrames);
+	bool reached_end = false;
+
+	while(!stop_requested_.load()) {
+		size_t const space = tap_->GetNumWritable();
+		if(reached_end || space < kFileReadFrames) {
+			std::this_thread::sleep_for(kFileReadInterval);
+			continue;
+		}
+
+		size_t n = 0;
+		try {
+			n = reader_.Read(buffer.data(), kFileReadFrames);
+			if(n == 0 && loop_ && reader_.GetNumFrames() > 0) {
+				reader_.Seek(0);
+				n = reader_.Read(buffer.data(), kFileReadFrames);
+			}
+		} catch(std::exception &e) {
+			hwm::dout << "Failed to read the input file : " << e.what() << std::endl;
+		}
+
+		if(n == 0) {
+			reached_end = true;
+			continue;
+		}
+
+		//! 空きを確認してから書き込むので、ブロックが破棄されることはない
+		tap_->Write(buffer.data(), n);
+	}
+}
+
+void FileInputSource::Read(float * const * dest, size_t num_channels, size_t num_samples)
+{
+	size_t const file_channels = tap_->GetNumChannels();
+
+	size_t pos = 0;
+	while(pos < num_samples) {
+		size_t const n = tap_->Read(read_buffer_.data(), std::min(num_samples - pos, kFileTransferSamples));
+		if(n == 0) {
+			break;
+		}
+
+		for(size_t ch = 0; ch < num_channels; ++ch) {
+			std::copy_n(read_buffer_.data()[ch % file_channels], n, dest[ch] + pos);
+		}
+		pos += n;
+	}
+
+	if(pos < num_samples) {
+		for(size_t ch = 0; ch < num_channels; ++ch) {
+			std::fill(dest[ch] + pos, dest[ch] + num_samples, 0.0f);
+		}
+		num_underrun_samples_.fetch_add(num_samples - pos, std::memory_order_relaxed);
+	}
+}
+
+}	// ::hwm
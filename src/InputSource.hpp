@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "./AudioTap.hpp"
+#include "./Buffer.hpp"
+#include "./TestWavetable.hpp"
+#include "./WaveFileReader.hpp"
+
+namespace hwm {
+
+//! プラグインの入力バスに渡すオーディオを供給するクラスのインターフェース
+/*!
+	Vst3Plugin::SetInputSourceで入力バスごとに設定する。
+	ReadInPlace/Readはオーディオスレッドから呼び出されるので、
+	実装ではロックやメモリ確保を行ってはならない。
+*/
+class InputSource
+{
+public:
+	virtual ~InputSource() {}
+
+	//! 次のnum_samplesサンプルを、コピーせずに参照できるバッファがあれば返して、その分を読み進める。
+	/*!
+		返すバッファは少なくともnum_channels個のチャンネルを持ち、
+		次にReadInPlace/Readが呼ばれるまで有効でなければならない。
+		@return 直接参照できない場合はnullptr。その場合は続けてReadが呼び出される。
+	*/
+	virtual
+	float const * const *
+			ReadInPlace(size_t /*num_channels*/, size_t /*num_samples*/)
+	{
+		return nullptr;
+	}
+
+	//! 次のnum_samplesサンプルを、num_channels個のチャンネルを持つdestに書き込む
+	virtual
+	void	Read(float * const * dest, size_t num_channels, size_t num_samples) = 0;
+};
+
+//! TestWavetableの信号を繰り返し供給する
+class GeneratorInputSource
+	:	public InputSource
+{
+public:
+	GeneratorInputSource(TestWaveform waveform, size_t sampling_rate);
+
+	void	Read(float * const * dest, size_t num_channels, size_t num_samples) override;
+
+private:
+	std::shared_ptr<TestWavetable const>	wavetable_;
+	size_t									pos_;
+};
+
+//! オーディオデバイスの入力をそのまま供給する
+/*!
+	オーディオデバイスのコールバックの先頭でSetDeviceInputsを呼び出して、
+	そのコールバックの入力バッファを設定する。
+	デバイスに十分なチャンネル数がある場合は、デバイスのバッファをコピーせずに入力バスに渡す。
+*/
+class LiveInputSource
+	:	public InputSource
+{
+public:
+	//! デバイスの[first_device_channel, first_device_channel + num_channels)のチャンネルを使用する
+	LiveInputSource(size_t first_device_channel, size_t num_channels);
+
+	//! オーディオデバイスのコールバックから呼び出す
+	void	SetDeviceInputs(float const * const * inputs, size_t num_inputs, size_t num_frames);
+
+	float const * const *
+			ReadInPlace(size_t num_channels, size_t num_samples) override;
+
+	//! デバイスに足りないチャンネルやサンプルは無音で埋める
+	void	Read(float * const * dest, size_t num_channels, size_t num_samples) override;
+
+private:
+	size_t						first_device_channel_;
+	std::vector<float const *>	heads_;
+	float const * const *		device_inputs_;
+	size_t						num_device_inputs_;
+	size_t						num_device_frames_;
+	//! 現在のデバイスのバッファのうち、読み出し済みのサンプル数
+	size_t						consumed_;
+};
+
+//! Waveファイルを別スレッドで先読みして供給する
+/*!
+	ファイルの読み込みは専用のスレッドで行い、AudioTapのリングバッファを通してオーディオスレッドに渡す。
+	ファイルのチャンネル数が入力バスより少ない場合は、ファイルのチャンネルを繰り返して割り当てる。
+	先読みが間に合わなかった場合や、ループしない設定でファイルの終端に達した場合は無音を供給する。
+*/
+class FileInputSource
+	:	public InputSource
+{
+public:
+	//! @param prefetch_samples 先読みしておくサンプル数
+	//! @throw std::runtime_error ファイルが開けなかった場合
+	FileInputSource(String const &path, bool loop, size_t prefetch_samples = 1 << 16);
+	~FileInputSource();
+
+	size_t	GetNumChannels() const { return reader_.GetNumChannels(); }
+	int		GetSamplingRate() const { return reader_.GetSamplingRate(); }
+
+	void	Read(float * const * dest, size_t num_channels, size_t num_samples) override;
+
+	//! 先読みが間に合わなかったり、ファイルの終端に達していたりして、無音で埋めたサンプル数
+	std::uint64_t
+			GetNumUnderrunSamples() const { return num_underrun_samples_.load(std::memory_order_relaxed); }
+
+private:
+	void	ThreadProc();
+
+	WaveFileReader				reader_;
+	bool						loop_;
+	std::unique_ptr<AudioTap>	tap_;
+	//! オーディオスレッドでタップから読み出すための作業用バッファ
+	Buffer<float>				read_buffer_;
+	std::atomic<bool>			stop_requested_;
+	std::atomic<std::uint64_t>	num_underrun_samples_;
+	std::thread					thread_;
+};
+
+}	// ::hwm
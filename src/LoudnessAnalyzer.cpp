@@ -0,0 +1,610 @@
+#include "./LoudnessAnalyzer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "./Simd.hpp"
+
+namespace hwm {
+
+double const LoudnessStatistics::kNoValue = -std::numeric_limits<double>::infinity();
+
+namespace {
+
+	double const kPi = 3.141592653589793;
+
+	//! ゲーティングブロックを構成するサブブロック(100ms)の数
+	size_t const kMomentarySubBlocks = 4;
+	size_t const kShortTermSubBlocks = 30;
+
+	double const kAbsoluteGate = -70.0;
+	double const kRelativeGate = -10.0;
+	double const kHistogramBinWidth = 0.1;
+	//! -70LUFSから+10LUFSまで。それより大きいブロックは最後のビンに入れる
+	size_t const kNumHistogramBins = 800;
+
+	//! K特性のフィルタとトゥルーピークを一度に処理するサンプル数
+	size_t const kChunkSamples = 1024;
+
+	size_t const kTruePeakPhases = 4;
+	size_t const kTruePeakTapsPerPhase = 12;
+
+	//! 解析スレッドがタップを読み出す間隔
+	auto const kAnalysisInterval = std::chrono::milliseconds(5);
+	//! 解析スレッドがタップから一度に読み出すサンプル数
+	size_t const kReadSamples = 4096;
+
+	double EnergyToLoudness(double energy)
+	{
+		return (energy > 0) ? -0.691 + 10 * std::log10(energy) : LoudnessStatistics::kNoValue;
+	}
+
+	//! 4レーンの浮動小数点数のベクトル
+#if defined(HWM_SIMD_SSE2)
+	struct Vec4 { __m128 v_; };
+	inline Vec4 Set(float a, float b, float c, float d) { return { _mm_setr_ps(a, b, c, d) }; }
+	inline Vec4 Broadcast(float x) { return { _mm_set1_ps(x) }; }
+	inline Vec4 Load(float const *p) { return { _mm_loadu_ps(p) }; }
+	inline void Store(float *p, Vec4 a) { _mm_storeu_ps(p, a.v_); }
+	inline Vec4 operator+(Vec4 a, Vec4 b) { return { _mm_add_ps(a.v_, b.v_) }; }
+	inline Vec4 operator-(Vec4 a, Vec4 b) { return { _mm_sub_ps(a.v_, b.v_) }; }
+	inline Vec4 operator*(Vec4 a, Vec4 b) { return { _mm_mul_ps(a.v_, b.v_) }; }
+	inline Vec4 Abs(Vec4 a) { return { _mm_and_ps(a.v_, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))) }; }
+	inline Vec4 Max(Vec4 a, Vec4 b) { return { _mm_max_ps(a.v_, b.v_) }; }
+#elif defined(HWM_SIMD_NEON)
+	struct Vec4 { float32x4_t v_; };
+	inline Vec4 Set(float a, float b, float c, float d) { float const tmp[4] = { a, b, c, d }; return { vld1q_f32(tmp) }; }
+	inline Vec4 Broadcast(float x) { return { vdupq_n_f32(x) }; }
+	inline Vec4 Load(float const *p) { return { vld1q_f32(p) }; }
+	inline void Store(float *p, Vec4 a) { vst1q_f32(p, a.v_); }
+	inline Vec4 operator+(Vec4 a, Vec4 b) { return { vaddq_f32(a.v_, b.v_) }; }
+	inline Vec4 operator-(Vec4 a, Vec4 b) { return { vsubq_f32(a.v_, b.v_) }; }
+	inline Vec4 operator*(Vec4 a, Vec4 b) { return { vmulq_f32(a.v_, b.v_) }; }
+	inline Vec4 Abs(Vec4 a) { return { vabsq_f32(a.v_) }; }
+	inline Vec4 Max(Vec4 a, Vec4 b) { return { vmaxq_f32(a.v_, b.v_) }; }
+#else
+	struct Vec4 { float v_[4]; };
+	inline Vec4 Set(float a, float b, float c, float d) { return { { a, b, c, d } }; }
+	inline Vec4 Broadcast(float x) { return { { x, x, x, x } }; }
+	inline Vec4 Load(float const *p) { return { { p[0], p[1], p[2], p[3] } }; }
+	inline void Store(float *p, Vec4 a) { std::copy_n(a.v_, 4, p); }
+	template<class F>
+	inline Vec4 Apply(Vec4 a, Vec4 b, F f) { return { { f(a.v_[0], b.v_[0]), f(a.v_[1], b.v_[1]), f(a.v_[2], b.v_[2]), f(a.v_[3], b.v_[3]) } }; }
+	inline Vec4 operator+(Vec4 a, Vec4 b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+	inline Vec4 operator-(Vec4 a, Vec4 b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+	inline Vec4 operator*(Vec4 a, Vec4 b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+	inline Vec4 Abs(Vec4 a) { return Apply(a, a, [](float x, float) { return std::fabs(x); }); }
+	inline Vec4 Max(Vec4 a, Vec4 b) { return Apply(a, b, [](float x, float y) { return std::max(x, y); }); }
+#endif
+
+	float HorizontalMax(Vec4 a)
+	{
+		float tmp[4];
+		Store(tmp, a);
+		return std::max(std::max(tmp[0], tmp[1]), std::max(tmp[2], tmp[3]));
+	}
+
+	//! b0, b1, b2, a1, a2
+	typedef std::array<float, 5> BiquadCoefficients;
+
+	//! ITU-R BS.1770-4のK特性のフィルタ(シェルビングフィルタとハイパスフィルタ)の係数を、
+	//! 任意のサンプリングレートについて求める
+	std::array<BiquadCoefficients, 2> GetKWeightingCoefficients(size_t sampling_rate)
+	{
+		std::array<BiquadCoefficients, 2> result;
+
+		{
+			double const f0 = 1681.974450955533;
+			double const gain_dB = 3.999843853973347;
+			double const q = 0.7071752369554196;
+
+			double const k = std::tan(kPi * f0 / sampling_rate);
+			double const vh = std::pow(10.0, gain_dB / 20.0);
+			double const vb = std::pow(vh, 0.4996667741545416);
+			double const a0 = 1.0 + k / q + k * k;
+
+			result[0] = {{
+				static_cast<float>((vh + vb * k / q + k * k) / a0),
+				static_cast<float>(2.0 * (k * k - vh) / a0),
+				static_cast<float>((vh - vb * k / q + k * k) / a0),
+				static_cast<float>(2.0 * (k * k - 1.0) / a0),
+				static_cast<float>((1.0 - k / q + k * k) / a0),
+			}};
+		}
+
+		{
+			double const f0 = 38.13547087602444;
+			double const q = 0.5003270373238773;
+
+			double const k = std::tan(kPi * f0 / sampling_rate);
+			double const a0 = 1.0 + k / q + k * k;
+
+			result[1] = {{
+				1.0f,
+				-2.0f,
+				1.0f,
+				static_cast<float>(2.0 * (k * k - 1.0) / a0),
+				static_cast<float>((1.0 - k / q + k * k) / a0),
+			}};
+		}
+
+		return result;
+	}
+
+	//! 第一種変形ベッセル関数(0次)
+	double BesselI0(double x)
+	{
+		double sum = 1;
+		double term = 1;
+		for(int k = 1; k < 32; ++k) {
+			term *= (x / (2 * k)) * (x / (2 * k));
+			sum += term;
+		}
+		return sum;
+	}
+
+	typedef std::array<std::array<float, kTruePeakTapsPerPhase>, kTruePeakPhases> TruePeakCoefficients;
+
+	//! 4倍オーバーサンプリング用のカイザー窓付きsincフィルタを、位相ごとに分解した係数
+	TruePeakCoefficients const & GetTruePeakCoefficients()
+	{
+		static TruePeakCoefficients const coefficients = [] {
+			size_t const length = kTruePeakPhases * kTruePeakTapsPerPhase;
+			double const beta = 5.0;
+			double const center = (length - 1) / 2.0;
+
+			std::array<double, kTruePeakPhases * kTruePeakTapsPerPhase> h;
+			for(size_t i = 0; i < length; ++i) {
+				double const t = (i - center) / kTruePeakPhases;
+				double const sinc = (t == 0) ? 1.0 : std::sin(kPi * t) / (kPi * t);
+				double const r = (i - center) / center;
+				double const window = BesselI0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / BesselI0(beta);
+				h[i] = sinc * window;
+			}
+
+			TruePeakCoefficients result;
+			for(size_t p = 0; p < kTruePeakPhases; ++p) {
+				//! 各位相のDCゲインを1にする
+				double sum = 0;
+				for(size_t k = 0; k < kTruePeakTapsPerPhase; ++k) { sum += h[k * kTruePeakPhases + p]; }
+				for(size_t k = 0; k < kTruePeakTapsPerPhase; ++k) {
+					result[p][k] = static_cast<float>(h[k * kTruePeakPhases + p] / sum);
+				}
+			}
+			return result;
+		}();
+
+		return coefficients;
+	}
+
+	//! 解析スレッドで非正規化数の計算による速度低下を防ぐ
+	void EnableFlushToZero()
+	{
+#if defined(HWM_SIMD_SSE2)
+		_mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+	}
+
+}	// unnamed
+
+struct LoudnessMeter::FilterLanes
+{
+	std::array<BiquadCoefficients, 2> coefficients_;
+	//! [stage][state][lane]
+	float state_[2][2][4];
+};
+
+LoudnessMeter::LoudnessMeter(size_t num_channels, size_t sampling_rate)
+	:	num_channels_(num_channels)
+	,	sampling_rate_(sampling_rate)
+	,	sub_block_samples_(std::max<size_t>(sampling_rate / 10, 1))
+	,	channel_weights_(num_channels, 1.0)
+	,	filters_((num_channels + 3) / 4)
+	,	recent_energies_(kShortTermSubBlocks)
+	,	histogram_count_(kNumHistogramBins)
+	,	histogram_energy_(kNumHistogramBins)
+	,	true_peak_history_(num_channels, (kTruePeakTapsPerPhase - 1) + kChunkSamples)
+{
+	auto const coefficients = GetKWeightingCoefficients(sampling_rate);
+	for(auto &lanes: filters_) {
+		lanes.coefficients_ = coefficients;
+	}
+
+	Reset();
+}
+
+LoudnessMeter::~LoudnessMeter()
+{}
+
+void LoudnessMeter::SetChannelWeight(size_t channel, double weight)
+{
+	assert(channel < num_channels_);
+	channel_weights_[channel] = weight;
+}
+
+void LoudnessMeter::Reset()
+{
+	sub_block_pos_ = 0;
+	sub_block_energy_.assign(num_channels_, 0.0);
+	for(auto &lanes: filters_) {
+		std::fill_n(&lanes.state_[0][0][0], 2 * 2 * 4, 0.0f);
+	}
+
+	std::fill(recent_energies_.begin(), recent_energies_.end(), 0.0);
+	num_sub_blocks_ = 0;
+
+	std::fill(histogram_count_.begin(), histogram_count_.end(), 0);
+	std::fill(histogram_energy_.begin(), histogram_energy_.end(), 0.0);
+
+	true_peak_history_.clear();
+	true_peak_ = 0;
+
+	max_momentary_energy_ = 0;
+	max_short_term_energy_ = 0;
+	num_samples_ = 0;
+}
+
+void LoudnessMeter::Process(float const * const * channels, size_t num_samples)
+{
+	size_t offset = 0;
+	while(offset < num_samples) {
+		size_t const n = std::min({ num_samples - offset, sub_block_samples_ - sub_block_pos_, kChunkSamples });
+
+		ProcessChunk(channels, offset, n);
+		ProcessTruePeak(channels, offset, n);
+
+		offset += n;
+		sub_block_pos_ += n;
+		if(sub_block_pos_ == sub_block_samples_) {
+			CompleteSubBlock();
+		}
+	}
+
+	num_samples_ += num_samples;
+}
+
+void LoudnessMeter::ProcessChunk(float const * const * channels, size_t offset, size_t num_samples)
+{
+	static float const silence[kChunkSamples] = {};
+	assert(num_samples <= kChunkSamples);
+
+	for(size_t group = 0; group < filters_.size(); ++group) {
+		auto &lanes = filters_[group];
+
+		//! チャンネル数が4の倍数でない場合、余ったレーンには無音を入力する
+		float const *src[4];
+		for(size_t lane = 0; lane < 4; ++lane) {
+			size_t const ch = group * 4 + lane;
+			src[lane] = (ch < num_channels_) ? channels[ch] + offset : silence;
+		}
+
+		Vec4 b0[2], b1[2], b2[2], a1[2], a2[2], s1[2], s2[2];
+		for(size_t stage = 0; stage < 2; ++stage) {
+			auto const &c = lanes.coefficients_[stage];
+			b0[stage] = Broadcast(c[0]);
+			b1[stage] = Broadcast(c[1]);
+			b2[stage] = Broadcast(c[2]);
+			a1[stage] = Broadcast(c[3]);
+			a2[stage] = Broadcast(c[4]);
+			s1[stage] = Load(lanes.state_[stage][0]);
+			s2[stage] = Load(lanes.state_[stage][1]);
+		}
+
+		Vec4 sum = Broadcast(0);
+		for(size_t i = 0; i < num_samples; ++i) {
+			Vec4 x = Set(src[0][i], src[1][i], src[2][i], src[3][i]);
+
+			//! Transposed Direct Form II
+			for(size_t stage = 0; stage < 2; ++stage) {
+				Vec4 const y = b0[stage] * x + s1[stage];
+				s1[stage] = b1[stage] * x - a1[stage] * y + s2[stage];
+				s2[stage] = b2[stage] * x - a2[stage] * y;
+				x = y;
+			}
+
+			sum = sum + x * x;
+		}
+
+		for(size_t stage = 0; stage < 2; ++stage) {
+			Store(lanes.state_[stage][0], s1[stage]);
+			Store(lanes.state_[stage][1], s2[stage]);
+		}
+
+		float energies[4];
+		Store(energies, sum);
+		for(size_t lane = 0; lane < 4 && group * 4 + lane < num_channels_; ++lane) {
+			sub_block_energy_[group * 4 + lane] += energies[lane];
+		}
+	}
+}
+
+void LoudnessMeter::ProcessTruePeak(float const * const * channels, size_t offset, size_t num_samples)
+{
+	auto const &coefficients = GetTruePeakCoefficients();
+	size_t const history = kTruePeakTapsPerPhase - 1;
+
+	for(size_t ch = 0; ch < num_channels_; ++ch) {
+		//! x[history + i]が、このチャンクのi番目のサンプル
+		float *x = true_peak_history_.data()[ch];
+		std::copy_n(channels[ch] + offset, num_samples, x + history);
+
+		Vec4 peak = Broadcast(0);
+		size_t i = 0;
+		for( ; i + 4 <= num_samples; i += 4) {
+			for(size_t p = 0; p < kTruePeakPhases; ++p) {
+				Vec4 acc = Broadcast(0);
+				for(size_t k = 0; k < kTruePeakTapsPerPhase; ++k) {
+					acc = acc + Broadcast(coefficients[p][k]) * Load(x + history + i - k);
+				}
+				peak = Max(peak, Abs(acc));
+			}
+		}
+
+		float max_value = HorizontalMax(peak);
+		for( ; i < num_samples; ++i) {
+			for(size_t p = 0; p < kTruePeakPhases; ++p) {
+				float acc = 0;
+				for(size_t k = 0; k < kTruePeakTapsPerPhase; ++k) {
+					acc += coefficients[p][k] * x[history + i - k];
+				}
+				max_value = std::max(max_value, std::fabs(acc));
+			}
+		}
+
+		true_peak_ = std::max(true_peak_, max_value);
+
+		//! 次のチャンクのために末尾のサンプルを先頭に移す
+		std::copy_n(x + num_samples, history, x);
+	}
+}
+
+void LoudnessMeter::CompleteSubBlock()
+{
+	double energy = 0;
+	for(size_t ch = 0; ch < num_channels_; ++ch) {
+		energy += channel_weights_[ch] * sub_block_energy_[ch] / sub_block_samples_;
+		sub_block_energy_[ch] = 0;
+	}
+	sub_block_pos_ = 0;
+
+	recent_energies_[num_sub_blocks_ % kShortTermSubBlocks] = energy;
+	++num_sub_blocks_;
+
+	if(num_sub_blocks_ >= kMomentarySubBlocks) {
+		//! 75%ずつ重なった400msのゲーティングブロック
+		double const block_energy = GetWindowEnergy(kMomentarySubBlocks);
+		max_momentary_energy_ = std::max(max_momentary_energy_, block_energy);
+
+		double const loudness = EnergyToLoudness(block_energy);
+		if(loudness >= kAbsoluteGate) {
+			size_t const bin = std::min<size_t>(static_cast<size_t>((loudness - kAbsoluteGate) / kHistogramBinWidth),
+												kNumHistogramBins - 1);
+			histogram_count_[bin] += 1;
+			histogram_energy_[bin] += block_energy;
+		}
+	}
+
+	if(num_sub_blocks_ >= kShortTermSubBlocks) {
+		max_short_term_energy_ = std::max(max_short_term_energy_, GetWindowEnergy(kShortTermSubBlocks));
+	}
+}
+
+//! 直近のnum_sub_blocks個のサブブロックの平均のエネルギー。測定開始前の区間は無音として扱う。
+double LoudnessMeter::GetWindowEnergy(size_t num_sub_blocks) const
+{
+	assert(num_sub_blocks <= kShortTermSubBlocks);
+
+	double sum = 0;
+	size_t const n = std::min(num_sub_blocks, num_sub_blocks_);
+	for(size_t i = 0; i < n; ++i) {
+		sum += recent_energies_[(num_sub_blocks_ - 1 - i) % kShortTermSubBlocks];
+	}
+	return sum / num_sub_blocks;
+}
+
+double LoudnessMeter::GetIntegratedEnergy() const
+{
+	std::uint64_t count = 0;
+	double energy = 0;
+	for(size_t i = 0; i < kNumHistogramBins; ++i) {
+		count += histogram_count_[i];
+		energy += histogram_energy_[i];
+	}
+
+	if(count == 0) {
+		return 0;
+	}
+
+	//! 相対ゲートの位置はビンの幅の精度で扱う
+	double const relative_gate = EnergyToLoudness(energy / count) + kRelativeGate;
+	size_t const first_bin = static_cast<size_t>(std::max(0.0, (relative_gate - kAbsoluteGate) / kHistogramBinWidth));
+
+	count = 0;
+	energy = 0;
+	for(size_t i = first_bin; i < kNumHistogramBins; ++i) {
+		count += histogram_count_[i];
+		energy += histogram_energy_[i];
+	}
+
+	return (count > 0) ? energy / count : 0;
+}
+
+LoudnessStatistics LoudnessMeter::GetStatistics() const
+{
+	LoudnessStatistics stats;
+	stats.momentary_ = EnergyToLoudness(GetWindowEnergy(kMomentarySubBlocks));
+	stats.short_term_ = EnergyToLoudness(GetWindowEnergy(kShortTermSubBlocks));
+	stats.integrated_ = EnergyToLoudness(GetIntegratedEnergy());
+	stats.max_momentary_ = EnergyToLoudness(max_momentary_energy_);
+	stats.max_short_term_ = EnergyToLoudness(max_short_term_energy_);
+	stats.true_peak_ = (true_peak_ > 0) ? 20 * std::log10(true_peak_) : LoudnessStatistics::kNoValue;
+	stats.num_samples_ = num_samples_;
+	return stats;
+}
+
+struct LoudnessAnalyzer::Stem
+{
+	Stem(std::shared_ptr<AudioTap> tap, LoudnessStatistics const &initial_stats)
+		:	tap_(std::move(tap))
+		,	meter_(tap_->GetNumChannels(), tap_->GetSamplingRate())
+		,	read_buffer_(tap_->GetNumChannels(), kReadSamples)
+		,	stats_(initial_stats)
+		,	reset_requested_(false)
+	{}
+
+	std::shared_ptr<AudioTap>			tap_;
+	LoudnessMeter						meter_;
+	Buffer<float>						read_buffer_;
+	TripleBuffer<LoudnessStatistics>	stats_;
+	std::atomic<bool>					reset_requested_;
+};
+
+LoudnessAnalyzer::LoudnessAnalyzer()
+	:	num_passes_started_(0)
+	,	num_passes_(0)
+	,	flush_requested_(false)
+	,	stop_requested_(false)
+{
+	thread_ = std::thread([this] { ThreadProc(); });
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_requested_ = true;
+	}
+	wakeup_.notify_one();
+	pass_completed_.notify_all();
+	thread_.join();
+}
+
+std::shared_ptr<AudioTap>
+		LoudnessAnalyzer::CreateTap(size_t num_channels, size_t sampling_rate, size_t capacity, AudioTap::OverflowPolicy policy)
+{
+	auto tap = std::make_shared<AudioTap>(num_channels, sampling_rate, capacity, policy);
+
+	auto stem = std::make_shared<Stem>(tap, LoudnessMeter(num_channels, sampling_rate).GetStatistics());
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	stems_.push_back(std::move(stem));
+	return tap;
+}
+
+void LoudnessAnalyzer::RemoveTap(AudioTap const *tap)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	stems_.erase(std::remove_if(stems_.begin(), stems_.end(),
+								[tap](std::shared_ptr<Stem> const &stem) { return stem->tap_.get() == tap; }),
+				 stems_.end());
+}
+
+bool LoudnessAnalyzer::GetStatistics(AudioTap const *tap, LoudnessStatistics &stats)
+{
+	std::shared_ptr<Stem> stem;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stem = FindStem(tap);
+	}
+	if(!stem) {
+		return false;
+	}
+
+	//! 結果はトリプルバッファで公開されているので、解析中でもロックせずに読み出せる
+	stem->stats_.Update();
+	stats = stem->stats_.GetReadBuffer();
+	return true;
+}
+
+void LoudnessAnalyzer::ResetStatistics(AudioTap const *tap)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto stem = FindStem(tap);
+	if(stem) {
+		stem->reset_requested_.store(true);
+	}
+}
+
+void LoudnessAnalyzer::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	//! この後に開始するパスは、この時点までに書き込まれたサンプルをすべて読み出す
+	std::uint64_t const target = num_passes_started_ + 1;
+	flush_requested_ = true;
+	wakeup_.notify_one();
+	pass_completed_.wait(lock, [&] { return num_passes_ >= target || stop_requested_; });
+}
+
+std::shared_ptr<LoudnessAnalyzer::Stem>
+		LoudnessAnalyzer::FindStem(AudioTap const *tap)
+{
+	for(auto &stem: stems_) {
+		if(stem->tap_.get() == tap) {
+			return stem;
+		}
+	}
+	return nullptr;
+}
+
+void LoudnessAnalyzer::ThreadProc()
+{
+	EnableFlushToZero();
+
+	//! 解析中はロックを解放するので、このパスで処理するタップの一覧を複製しておく
+	std::vector<std::shared_ptr<Stem>> stems;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while(!stop_requested_) {
+		flush_requested_ = false;
+		std::uint64_t const pass = ++num_passes_started_;
+		stems = stems_;
+
+		lock.unlock();
+		for(auto &stem: stems) {
+			ProcessStem(*stem);
+		}
+		lock.lock();
+
+		stems.clear();
+		num_passes_ = pass;
+		pass_completed_.notify_all();
+
+		wakeup_.wait_for(lock, kAnalysisInterval, [this] { return stop_requested_ || flush_requested_; });
+	}
+}
+
+void LoudnessAnalyzer::ProcessStem(Stem &stem)
+{
+	bool updated = false;
+
+	if(stem.reset_requested_.exchange(false)) {
+		stem.meter_.Reset();
+		updated = true;
+	}
+
+	//! 書き込みが読み出しより速い場合でも、1回のパスで処理する量はタップの容量までにする
+	size_t const limit = stem.tap_->GetCapacity();
+	for(size_t total = 0; total < limit; ) {
+		size_t const n = stem.tap_->Read(stem.read_buffer_.data(), stem.read_buffer_.samples());
+		if(n == 0) {
+			break;
+		}
+
+		stem.meter_.Process(stem.read_buffer_.data(), n);
+		total += n;
+		updated = true;
+	}
+
+	if(updated) {
+		stem.stats_.GetWriteBuffer() = stem.meter_.GetStatistics();
+		stem.stats_.Publish();
+	}
+}
+
+}	// ::hwm
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./AudioTap.hpp"
+#include "./Buffer.hpp"
+#include "./TripleBuffer.hpp"
+
+namespace hwm {
+
+//! ラウドネスの測定結果
+struct LoudnessStatistics
+{
+	//! 無音などで値が存在しない場合の値(-inf)
+	static double const kNoValue;
+
+	//! 400msのウィンドウのラウドネス(LUFS)
+	double			momentary_;
+	//! 3sのウィンドウのラウドネス(LUFS)
+	double			short_term_;
+	//! ゲーティングを適用した、測定開始からのラウドネス(LUFS)
+	double			integrated_;
+	double			max_momentary_;
+	double			max_short_term_;
+	//! 4倍オーバーサンプリングで求めた、全チャンネルのトゥルーピーク(dBTP)
+	double			true_peak_;
+	//! 測定したサンプル数
+	std::uint64_t	num_samples_;
+};
+
+//! ITU-R BS.1770-4 / EBU R128に基づいてラウドネスとトゥルーピークを測定するクラス
+/*!
+	K特性のフィルタは4チャンネルずつSIMDのレーンに割り当てて処理し、
+	トゥルーピークは48タップ(4位相 x 12タップ)のポリフェーズFIRで4倍にオーバーサンプリングして求める。
+	Integratedのゲーティングには、0.1LU刻みのヒストグラムを使用するので、
+	測定時間によらずメモリ使用量と計算量は一定になる。
+
+	オーディオスレッドから直接呼び出すことは想定していない。
+	AudioTapを通してLoudnessAnalyzerのスレッドで処理する。
+*/
+class LoudnessMeter
+{
+public:
+	LoudnessMeter(size_t num_channels, size_t sampling_rate);
+	~LoudnessMeter();
+
+	size_t	GetNumChannels() const { return num_channels_; }
+	size_t	GetSamplingRate() const { return sampling_rate_; }
+
+	//! チャンネルの重み付け。デフォルトはすべて1.0。
+	//! 5.1chのサラウンドチャンネルには1.41を、LFEには0を指定する。
+	void	SetChannelWeight(size_t channel, double weight);
+
+	void	Process(float const * const * channels, size_t num_samples);
+
+	//! 測定結果を初期状態に戻す
+	void	Reset();
+
+	LoudnessStatistics
+			GetStatistics() const;
+
+private:
+	//! 4チャンネル分のK特性フィルタの状態
+	struct FilterLanes;
+
+	//! 各チャンネルの[offset, offset + num_samples)を処理する。num_samplesはサブブロックの境界を越えないこと。
+	void	ProcessChunk(float const * const * channels, size_t offset, size_t num_samples);
+	void	ProcessTruePeak(float const * const * channels, size_t offset, size_t num_samples);
+	void	CompleteSubBlock();
+	double	GetWindowEnergy(size_t num_sub_blocks) const;
+	double	GetIntegratedEnergy() const;
+
+	size_t					num_channels_;
+	size_t					sampling_rate_;
+	//! 100msのサンプル数。ゲーティングブロック(400ms)はこれを75%ずつ重ねて4つ並べたもの
+	size_t					sub_block_samples_;
+	size_t					sub_block_pos_;
+	//! 現在のサブブロックのチャンネルごとの二乗和
+	std::vector<double>		sub_block_energy_;
+	std::vector<double>		channel_weights_;
+	std::vector<FilterLanes>	filters_;
+
+	//! 直近のサブブロックのエネルギー(重み付けしたチャンネルの平均二乗和の合計)のリングバッファ
+	std::vector<double>		recent_energies_;
+	size_t					num_sub_blocks_;
+
+	//! ゲーティングブロックのヒストグラム。ビンごとのブロック数とエネルギーの合計を保持する。
+	std::vector<std::uint64_t>	histogram_count_;
+	std::vector<double>			histogram_energy_;
+
+	//! トゥルーピーク用に、前回の処理の末尾のサンプルを先頭に残しておく作業用バッファ
+	Buffer<float>			true_peak_history_;
+	float					true_peak_;
+
+	double					max_momentary_energy_;
+	double					max_short_term_energy_;
+	std::uint64_t			num_samples_;
+};
+
+//! 複数のAudioTapの出力を、オーディオスレッドとは別のスレッドでLoudnessMeterに通して測定するクラス
+/*!
+	CreateTapで作成したタップにオーディオスレッドから出力を書き込むと、
+	解析用のスレッドが定期的にタップを読み出して測定し、結果をトリプルバッファで公開する。
+	1つのスレッドですべてのタップを処理するので、多数のバスを同時に測定できる。
+	mutex_はタップの一覧の変更と参照の間だけ保持し、解析中は保持しないので、
+	GetStatisticsなどが解析の終わりを待たされることはない。
+*/
+class LoudnessAnalyzer
+{
+public:
+	LoudnessAnalyzer();
+	~LoudnessAnalyzer();
+
+	LoudnessAnalyzer(LoudnessAnalyzer const &) = delete;
+	LoudnessAnalyzer & operator=(LoudnessAnalyzer const &) = delete;
+
+	//! 測定対象のタップを作成する
+	/*!
+		@param capacity タップに保持できるサンプル数。
+		解析スレッドの処理間隔より十分長くすること。
+	*/
+	std::shared_ptr<AudioTap>
+			CreateTap(size_t num_channels,
+					  size_t sampling_rate,
+					  size_t capacity,
+					  AudioTap::OverflowPolicy policy = AudioTap::OverflowPolicy::kDrop);
+
+	//! タップを測定対象から外す
+	void	RemoveTap(AudioTap const *tap);
+
+	//! タップの最新の測定結果を取得する。1つのスレッドからのみ呼び出すこと。
+	//! @return tapが測定対象でなければfalse
+	bool	GetStatistics(AudioTap const *tap, LoudnessStatistics &stats);
+
+	//! タップの測定結果を初期状態に戻す
+	void	ResetStatistics(AudioTap const *tap);
+
+	//! この呼び出しの時点でタップに書き込まれているサンプルを、すべて測定し終わるまで待機する
+	void	Flush();
+
+private:
+	struct Stem;
+
+	void	ThreadProc();
+	void	ProcessStem(Stem &stem);
+	//! mutex_をロックした状態で呼び出す
+	std::shared_ptr<Stem>
+			FindStem(AudioTap const *tap);
+
+	std::mutex					mutex_;
+	std::condition_variable		wakeup_;
+	std::condition_variable		pass_completed_;
+	//! 解析中にRemoveTapで外されたタップも、そのパスが終わるまで解析スレッドが保持する
+	std::vector<std::shared_ptr<Stem>>	stems_;
+	//! 開始したパスの数と、完了したパスの数
+	std::uint64_t				num_passes_started_;
+	std::uint64_t				num_passes_;
+	bool						flush_requested_;
+	bool						stop_requested_;
+	std::thread					thread_;
+};
+
+}	// ::hwm
@@ -0,0 +1,179 @@
+#include "./LzCodec.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace hwm {
+
+namespace {
+
+	//! 一致とみなす最小の長さ
+	constexpr size_t kMinMatch = 4;
+	constexpr size_t kMaxOffset = 65535;
+	constexpr int kHashBits = 14;
+	constexpr std::uint32_t kNoPosition = static_cast<std::uint32_t>(-1);
+
+	//! トークンの4bitに収まらない長さは、255が続くバイト列で表す
+	constexpr size_t kNibbleMax = 15;
+
+	std::uint32_t Read32(std::uint8_t const *p)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	size_t Hash(std::uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - kHashBits);
+	}
+
+	void WriteLength(std::vector<char> &dest, size_t length)
+	{
+		while(length >= 255) {
+			dest.push_back(static_cast<char>(255));
+			length -= 255;
+		}
+		dest.push_back(static_cast<char>(length));
+	}
+
+	bool ReadLength(std::uint8_t const *&pos, std::uint8_t const *end, size_t &length)
+	{
+		for( ; ; ) {
+			if(pos == end) {
+				return false;
+			}
+			std::uint8_t const b = *pos++;
+			length += b;
+			if(b != 255) {
+				return true;
+			}
+		}
+	}
+
+	//! リテラル列と一致を1つのシーケンスとして書き出す。match_lengthが0の場合は最後のシーケンス
+	void WriteSequence(std::vector<char> &dest,
+					   std::uint8_t const *literals, size_t literal_length,
+					   size_t offset, size_t match_length)
+	{
+		size_t const match_code = (match_length > 0) ? match_length - kMinMatch : 0;
+		std::uint8_t const token =
+			static_cast<std::uint8_t>((std::min(literal_length, kNibbleMax) << 4) | std::min(match_code, kNibbleMax));
+		dest.push_back(static_cast<char>(token));
+
+		if(literal_length >= kNibbleMax) {
+			WriteLength(dest, literal_length - kNibbleMax);
+		}
+		dest.insert(dest.end(), literals, literals + literal_length);
+
+		if(match_length == 0) {
+			return;
+		}
+
+		dest.push_back(static_cast<char>(offset & 0xFF));
+		dest.push_back(static_cast<char>(offset >> 8));
+		if(match_code >= kNibbleMax) {
+			WriteLength(dest, match_code - kNibbleMax);
+		}
+	}
+
+}	// unnamed
+
+void LzCodec::Compress(char const *src, size_t size, std::vector<char> &dest)
+{
+	dest.clear();
+	dest.reserve(size + size / 255 + 16);
+
+	auto const *in = reinterpret_cast<std::uint8_t const *>(src);
+	std::vector<std::uint32_t> table(size_t(1) << kHashBits, kNoPosition);
+
+	size_t anchor = 0;
+	size_t pos = 0;
+	while(pos + kMinMatch <= size) {
+		std::uint32_t const sequence = Read32(in + pos);
+		size_t const h = Hash(sequence);
+		std::uint32_t const candidate = table[h];
+		table[h] = static_cast<std::uint32_t>(pos);
+
+		if(candidate == kNoPosition || pos - candidate > kMaxOffset || Read32(in + candidate) != sequence) {
+			//! 一致が見つからない区間が続くほど、大きく読み飛ばして圧縮できないデータを速く通過する
+			pos += 1 + ((pos - anchor) >> 6);
+			continue;
+		}
+
+		size_t length = kMinMatch;
+		while(pos + length < size && in[candidate + length] == in[pos + length]) {
+			++length;
+		}
+
+		WriteSequence(dest, in + anchor, pos - anchor, pos - candidate, length);
+		pos += length;
+		anchor = pos;
+
+		//! 一致の末尾付近の位置も登録しておき、次の一致を見つけやすくする
+		if(pos >= 2 && pos - 2 + kMinMatch <= size) {
+			table[Hash(Read32(in + pos - 2))] = static_cast<std::uint32_t>(pos - 2);
+		}
+	}
+
+	WriteSequence(dest, in + anchor, size - anchor, 0, 0);
+}
+
+bool LzCodec::Decompress(char const *src, size_t size, size_t original_size, std::vector<char> &dest)
+{
+	dest.resize(original_size);
+
+	auto const *pos = reinterpret_cast<std::uint8_t const *>(src);
+	auto const *end = pos + size;
+	auto *out = reinterpret_cast<std::uint8_t *>(dest.data());
+	size_t written = 0;
+
+	for( ; ; ) {
+		if(pos == end) {
+			return false;
+		}
+		std::uint8_t const token = *pos++;
+
+		size_t literal_length = token >> 4;
+		if(literal_length == kNibbleMax && !ReadLength(pos, end, literal_length)) {
+			return false;
+		}
+		if(literal_length > static_cast<size_t>(end - pos) || literal_length > original_size - written) {
+			return false;
+		}
+		std::memcpy(out + written, pos, literal_length);
+		pos += literal_length;
+		written += literal_length;
+
+		//! 最後のシーケンスはリテラル列だけで終わる
+		if(written == original_size) {
+			return pos == end;
+		}
+
+		if(end - pos < 2) {
+			return false;
+		}
+		size_t const offset = pos[0] | (pos[1] << 8);
+		pos += 2;
+
+		size_t match_length = token & 0x0F;
+		if(match_length == kNibbleMax && !ReadLength(pos, end, match_length)) {
+			return false;
+		}
+		match_length += kMinMatch;
+
+		if(offset == 0 || offset > written || match_length > original_size - written) {
+			return false;
+		}
+
+		//! 一致の範囲が重なる場合があるので、1バイトずつコピーする
+		auto const *match = out + written - offset;
+		for(size_t i = 0; i < match_length; ++i) {
+			out[written + i] = match[i];
+		}
+		written += match_length;
+	}
+}
+
+}	// ::hwm
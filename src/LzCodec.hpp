@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace hwm {
+
+//! 外部ライブラリに依存しない、LZ77系の単純で高速な可逆圧縮
+/*!
+	LZ4のブロック形式に近い形式で、リテラル列と、直前64KB以内の一致(オフセットと長さ)の組を並べる。
+	プラグインの状態データのように、同じバイト列やゼロ埋めが繰り返し現れるデータを想定している。
+	圧縮率よりも速度を優先していて、ハッシュテーブルで見つかった最初の候補だけを一致として使用する。
+
+	圧縮後のデータには元のサイズを含めないので、展開するときは別途保存しておいたサイズを指定する。
+*/
+struct LzCodec
+{
+	//! srcを圧縮してdestに書き込む。destの元の内容は破棄される。
+	static
+	void	Compress(char const *src, size_t size, std::vector<char> &dest);
+
+	//! Compressで圧縮したデータを展開して、destに書き込む。
+	//! @param original_size 圧縮前のサイズ
+	//! @return データが壊れている場合はfalse
+	static
+	bool	Decompress(char const *src, size_t size, size_t original_size, std::vector<char> &dest);
+};
+
+}	// ::hwm
@@ -0,0 +1,122 @@
+#include "./MappedFile.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "./StrCnv.hpp"
+
+namespace hwm {
+
+MappedFile::MappedFile()
+	:	data_(nullptr)
+	,	size_(0)
+{}
+
+#if defined(_MSC_VER)
+
+//! mmapのない環境では、ファイル全体をヒープに読み込んで代用する
+MappedFile::MappedFile(String const &path)
+	:	MappedFile()
+{
+	std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+	if(!ifs) {
+		throw std::runtime_error("cannot open the file");
+	}
+
+	auto const end = ifs.tellg();
+	if(end < 0) {
+		throw std::runtime_error("cannot get the file size");
+	}
+
+	size_t const size = static_cast<size_t>(end);
+	if(size > 0) {
+		std::unique_ptr<char[]> buffer(new char[size]);
+		ifs.seekg(0);
+		if(!ifs.read(buffer.get(), static_cast<std::streamsize>(size))) {
+			throw std::runtime_error("cannot read the file");
+		}
+		data_ = buffer.release();
+		size_ = size;
+	}
+}
+
+#else
+
+MappedFile::MappedFile(String const &path)
+	:	MappedFile()
+{
+	int const fd = ::open(to_utf8(path).c_str(), O_RDONLY);
+	if(fd < 0) {
+		throw std::runtime_error("cannot open the file");
+	}
+
+	struct stat st;
+	if(::fstat(fd, &st) != 0) {
+		::close(fd);
+		throw std::runtime_error("cannot get the file size");
+	}
+
+	size_t const size = static_cast<size_t>(st.st_size);
+	if(size > 0) {
+		void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(mapped == MAP_FAILED) {
+			::close(fd);
+			throw std::runtime_error("cannot map the file");
+		}
+		data_ = static_cast<char const *>(mapped);
+		size_ = size;
+	}
+
+	//! マップした後はファイルディスクリプタを閉じてもよい
+	::close(fd);
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile &&rhs)
+	:	data_(rhs.data_)
+	,	size_(rhs.size_)
+{
+	rhs.data_ = nullptr;
+	rhs.size_ = 0;
+}
+
+MappedFile & MappedFile::operator=(MappedFile &&rhs)
+{
+	if(this != &rhs) {
+		Close();
+		std::swap(data_, rhs.data_);
+		std::swap(size_, rhs.size_);
+	}
+	return *this;
+}
+
+void MappedFile::Close()
+{
+	if(data_) {
+#if defined(_MSC_VER)
+		delete [] data_;
+#else
+		::munmap(const_cast<char *>(data_), size_);
+#endif
+	}
+	data_ = nullptr;
+	size_ = 0;
+}
+
+}	// ::hwm
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+namespace hwm {
+
+//! ファイル全体を読み出し専用でメモリにマップするクラス
+/*!
+	ファイルの内容はコピーされず、参照したページだけがOSによって読み込まれる。
+	サイズが0のファイルはマップせず、data()はnullptrになる。
+	mmapを使用できないWindows(MSVC)では、ファイル全体をメモリに読み込んで代用する。
+*/
+class MappedFile
+{
+public:
+	MappedFile();
+
+	//! @throw std::runtime_error ファイルを開けない場合
+	explicit
+	MappedFile(String const &path);
+
+	~MappedFile();
+
+	MappedFile(MappedFile &&rhs);
+	MappedFile & operator=(MappedFile &&rhs);
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile & operator=(MappedFile const &) = delete;
+
+	char const *	data() const { return data_; }
+	size_t			size() const { return size_; }
+
+	void	Close();
+
+private:
+	char const *	data_;
+	size_t			size_;
+};
+
+}	// ::hwm
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace hwm {
+
+//! 固定長の、マルチプロデューサー・シングルコンシューマー用ロックフリーキュー
+/*!
+	pushは複数のスレッドから同時に呼び出せるが、popは1つのスレッドからのみ呼び出すこと。
+	各要素にシーケンス番号を持たせて、プロデューサー同士はtail_のCASだけで書き込み位置を確保する。
+	popはwait-freeで、どちらの操作もメモリ確保を行わないため、リアルタイムスレッドから呼び出せる。
+	キューが一杯の時、pushは要素を追加せずにfalseを返す。
+*/
+template<class T>
+struct MpscQueue
+{
+	typedef T value_type;
+
+	//! @param capacity キューに保持できる要素数。内部では2のべき乗に切り上げられる。
+	explicit
+	MpscQueue(size_t capacity)
+		:	head_(0)
+		,	tail_(0)
+	{
+		assert(capacity > 0);
+		size_t n = 1;
+		while(n < capacity) { n <<= 1; }
+		cells_.reset(new Cell[n]);
+		for(size_t i = 0; i < n; ++i) {
+			cells_[i].sequence_.store(i, std::memory_order_relaxed);
+		}
+		capacity_ = n;
+		mask_ = n - 1;
+	}
+
+	MpscQueue(MpscQueue const &) = delete;
+	MpscQueue & operator=(MpscQueue const &) = delete;
+
+	size_t capacity() const { return capacity_; }
+
+	//! どのスレッドから呼び出してもよい
+	bool push(value_type const &value)
+	{
+		size_t pos = tail_.load(std::memory_order_relaxed);
+		for( ; ; ) {
+			Cell &cell = cells_[pos & mask_];
+			size_t const sequence = cell.sequence_.load(std::memory_order_acquire);
+			auto const diff = static_cast<std::ptrdiff_t>(sequence - pos);
+			if(diff == 0) {
+				if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.value_ = value;
+					cell.sequence_.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if(diff < 0) {
+				//! コンシューマーがまだ取り出していない要素で一杯
+				return false;
+			} else {
+				pos = tail_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//! コンシューマースレッドから呼び出す。
+	//! 位置を確保したプロデューサーが書き込みを終えていない要素は、まだ取り出さない。
+	bool pop(value_type &value)
+	{
+		size_t const head = head_.load(std::memory_order_relaxed);
+		Cell &cell = cells_[head & mask_];
+		if(cell.sequence_.load(std::memory_order_acquire) != head + 1) {
+			return false;
+		}
+
+		value = std::move(cell.value_);
+		cell.sequence_.store(head + capacity_, std::memory_order_release);
+		head_.store(head + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t>	sequence_;
+		value_type			value_;
+	};
+
+	std::unique_ptr<Cell[]>	cells_;
+	size_t capacity_;
+	size_t mask_;
+	alignas(64) std::atomic<size_t> head_;
+	alignas(64) std::atomic<size_t> tail_;
+};
+
+}	// ::hwm
@@ -0,0 +1,113 @@
+#include "./NullAudioDevice.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "./AllocationGuard.hpp"
+
+namespace hwm {
+
+NullAudioDevice::NullAudioDevice(Mode mode)
+	:	mode_(mode)
+	,	is_opened_(false)
+	,	is_running_(false)
+	,	statistics_()
+{}
+
+NullAudioDevice::~NullAudioDevice()
+{
+	Close();
+}
+
+char const * NullAudioDevice::GetDriverName() const
+{
+	return (mode_ == Mode::kPaced) ? "null" : "null-free";
+}
+
+void NullAudioDevice::Open(Config const &config, callback_t callback)
+{
+	Close();
+
+	config_ = config;
+	callback_ = std::move(callback);
+	input_buffer_.resize(config_.num_inputs_, config_.block_size_);
+	output_buffer_.resize(config_.num_outputs_, config_.block_size_);
+	ResetXruns();
+	is_opened_ = true;
+}
+
+void NullAudioDevice::Close()
+{
+	Stop();
+	is_opened_ = false;
+}
+
+void NullAudioDevice::Start()
+{
+	assert(IsOpened());
+	if(is_running_) {
+		return;
+	}
+
+	statistics_ = Statistics();
+	is_running_ = true;
+	thread_ = std::thread([this] { ThreadProc(); });
+}
+
+void NullAudioDevice::Stop()
+{
+	if(!is_running_) {
+		return;
+	}
+
+	is_running_ = false;
+	thread_.join();
+}
+
+void NullAudioDevice::ThreadProc()
+{
+	typedef std::chrono::steady_clock clock_type;
+
+	auto const period = std::chrono::duration_cast<clock_type::duration>(
+		std::chrono::duration<double>(static_cast<double>(config_.block_size_) / config_.sampling_rate_));
+
+	auto const start_time = clock_type::now();
+	auto deadline = start_time + period;
+
+	Statistics stat = {};
+
+	while(is_running_.load(std::memory_order_relaxed)) {
+		auto const callback_begin = clock_type::now();
+		{
+			HWM_ASSERT_NO_ALLOCATION();
+			input_buffer_.clear();
+			callback_(input_buffer_.data(), config_.num_inputs_,
+					  output_buffer_.data(), config_.num_outputs_,
+					  config_.block_size_);
+		}
+		auto const callback_end = clock_type::now();
+
+		double const callback_seconds = std::chrono::duration<double>(callback_end - callback_begin).count();
+		stat.num_callbacks_ += 1;
+		stat.num_frames_ += config_.block_size_;
+		stat.total_callback_seconds_ += callback_seconds;
+		stat.max_callback_seconds_ = std::max(stat.max_callback_seconds_, callback_seconds);
+
+		if(mode_ == Mode::kPaced) {
+			if(callback_end > deadline) {
+				//! 実際のデバイスであれば出力が途切れている。
+				//! 遅れを取り戻そうとして連続で呼び出さないように、次の周期を現在時刻から数え直す。
+				AddXrun();
+				deadline = callback_end + period;
+			} else {
+				std::this_thread::sleep_until(deadline);
+				deadline += period;
+			}
+		}
+	}
+
+	stat.elapsed_seconds_ = std::chrono::duration<double>(clock_type::now() - start_time).count();
+	statistics_ = stat;
+}
+
+}	// ::hwm
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "./AudioDevice.hpp"
+#include "./Buffer.hpp"
+
+namespace hwm {
+
+//! サウンドカードを使用せずに、タイマーでコールバックを呼び出すドライバー
+/*!
+	kPacedでは、ブロックサイズとサンプリングレートから決まる周期で、
+	高精度のタイマー(std::chrono::steady_clock)に合わせてコールバックを呼び出す。
+	コールバックが次の周期の開始時刻までに終わらなかった場合はxrunとして数える。
+
+	kFreeRunningでは、待機せずにコールバックを呼び出し続ける。
+	ホストの処理のオーバーヘッドやスループットの計測に使用する。
+
+	入力には無音が渡され、出力は破棄される。
+*/
+class NullAudioDevice
+	:	public AudioDevice
+{
+public:
+	enum class Mode {
+		kPaced,
+		kFreeRunning,
+	};
+
+	//! コールバックの処理時間の統計
+	struct Statistics
+	{
+		std::uint64_t	num_callbacks_;
+		std::uint64_t	num_frames_;
+		double			total_callback_seconds_;
+		double			max_callback_seconds_;
+		double			elapsed_seconds_;
+	};
+
+	explicit
+	NullAudioDevice(Mode mode = Mode::kPaced);
+	~NullAudioDevice();
+
+	void	Open(Config const &config, callback_t callback) override;
+	void	Close() override;
+	bool	IsOpened() const override { return is_opened_; }
+
+	void	Start() override;
+	void	Stop() override;
+
+	char const *
+			GetDriverName() const override;
+
+	Config const &
+			GetConfig() const override { return config_; }
+
+	Mode	GetMode() const { return mode_; }
+
+	//! Stop()の後に呼び出すこと
+	Statistics
+			GetStatistics() const { return statistics_; }
+
+private:
+	void	ThreadProc();
+
+	Mode				mode_;
+	Config				config_;
+	callback_t			callback_;
+	bool				is_opened_;
+	std::thread			thread_;
+	std::atomic<bool>	is_running_;
+	Buffer<float>		input_buffer_;
+	Buffer<float>		output_buffer_;
+	Statistics			statistics_;
+};
+
+}	// ::hwm
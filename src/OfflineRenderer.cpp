@@ -0,0 +1,82 @@
+#include "./OfflineRenderer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+
+#include "./ScopeExit.hpp"
+
+namespace hwm {
+
+using namespace Steinberg;
+
+OfflineRenderer::OfflineRenderer(Vst3Plugin &plugin, int sampling_rate, int block_size)
+	:	plugin_(&plugin)
+	,	sampling_rate_(sampling_rate)
+	,	block_size_(block_size)
+{
+	assert(sampling_rate > 0);
+	assert(block_size > 0);
+}
+
+void OfflineRenderer::SetBlockCallback(block_callback_t callback)
+{
+	block_callback_ = callback;
+}
+
+OfflineRenderer::Result
+		OfflineRenderer::Render(std::uint64_t num_samples, WaveFileWriter &writer)
+{
+	assert(!plugin_->IsResumed());
+	assert(writer.IsOpened());
+	assert(writer.GetNumChannels() == plugin_->GetNumOutputs());
+
+	auto const last_process_mode = plugin_->GetProcessMode();
+
+	plugin_->SetProcessMode(Vst::ProcessModes::kOffline);
+	plugin_->SetBlockSize(block_size_);
+	plugin_->SetSamplingRate(sampling_rate_);
+	plugin_->Resume();
+
+	HWM_SCOPE_EXIT([this, last_process_mode] {
+		plugin_->Suspend();
+		plugin_->SetProcessMode(last_process_mode);
+	});
+
+	auto const start = std::chrono::steady_clock::now();
+
+	std::uint64_t pos = 0;
+	while(pos < num_samples) {
+		size_t const duration =
+			static_cast<size_t>(std::min<std::uint64_t>(block_size_, num_samples - pos));
+
+		if(block_callback_) {
+			block_callback_(*plugin_, pos, duration);
+		}
+
+		if(plugin_->GetSymbolicSampleSize() == Vst::SymbolicSampleSizes::kSample64) {
+			double const * const * result = plugin_->ProcessAudio64(pos, duration);
+			writer.Write(result, duration);
+		} else {
+			float const * const * result = plugin_->ProcessAudio(pos, duration);
+			writer.Write(result, duration);
+		}
+		pos += duration;
+	}
+
+	auto const end = std::chrono::steady_clock::now();
+
+	Result result;
+	result.rendered_samples_ = pos;
+	result.elapsed_seconds_ = std::chrono::duration<double>(end - start).count();
+	result.realtime_factor_ =
+		(result.elapsed_seconds_ > 0)
+		?	(pos / static_cast<double>(sampling_rate_)) / result.elapsed_seconds_
+		:	0;
+
+	return result;
+}
+
+}	// ::hwm
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "./Vst3Plugin.hpp"
+#include "./WaveFileWriter.hpp"
+
+namespace hwm {
+
+//! オーディオデバイスを使用せずに、Vst3PluginをCPUが許す限りの速度で処理させてファイルに書き出すクラス
+/*!
+	Renderの間、プラグインはVst::ProcessModes::kOfflineでsetupProcessingされる。
+	Renderの呼び出し前にプラグインはSuspendされていなければならない。
+	Renderが終わると、プラグインのProcessModeは元に戻され、Suspendされた状態になる。
+*/
+struct OfflineRenderer
+{
+	//! 各ブロックの処理の前に呼び出されるコールバック。
+	//! ノートやパラメータの変更をプラグインに送るために使用する。
+	typedef std::function<void(Vst3Plugin &plugin, size_t frame_pos, size_t num_samples)> block_callback_t;
+
+	struct Result
+	{
+		//! レンダリングしたサンプル数
+		std::uint64_t	rendered_samples_;
+		//! レンダリングにかかった時間(秒)
+		double			elapsed_seconds_;
+		//! レンダリングしたオーディオの長さ / elapsed_seconds_
+		double			realtime_factor_;
+	};
+
+	OfflineRenderer(Vst3Plugin &plugin, int sampling_rate, int block_size);
+
+	void	SetBlockCallback(block_callback_t callback);
+
+	//! num_samplesサンプル分をレンダリングしてwriterに書き出す。
+	//! writerはプラグインの出力チャンネル数でOpenされていなければならない。
+	Result	Render(std::uint64_t num_samples, WaveFileWriter &writer);
+
+private:
+	Vst3Plugin *		plugin_;
+	int					sampling_rate_;
+	int					block_size_;
+	block_callback_t	block_callback_;
+};
+
+}	// ::hwm
@@ -0,0 +1,209 @@
+#include "./PeakMeterBank.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "./Simd.hpp"
+
+namespace hwm {
+
+PeakMeterBank::PeakMeterBank(size_t num_channels, size_t sampling_rate, dB_t release_speed, dB_t minimum_dB)
+	:	sampling_rate_(sampling_rate)
+	,	hold_time_(0)
+	,	hold_samples_(0)
+	,	release_speed_(0)
+	,	release_level_per_sample_(0)
+	,	minimum_dB_(minimum_dB)
+	,	snapshot_(Snapshot(num_channels, ChannelLevel { minimum_dB, minimum_dB, minimum_dB }))
+	,	reset_highest_level_(false)
+{
+	SetReleaseSpeed(release_speed);
+
+	//! PeakMeterと同じく、最初のピークは即座に最小値まで下降させる
+	ChannelState const initial_state = { minimum_dB, minimum_dB, minimum_dB, -minimum_dB, 0 };
+	channels_.assign(num_channels, initial_state);
+}
+
+void PeakMeterBank::SetHoldTime(Msec duration)
+{
+	hold_time_ = duration;
+	hold_samples_ = static_cast<size_t>(sampling_rate_ * (duration / 1000.0));
+}
+
+void PeakMeterBank::SetReleaseSpeed(dB_t speed)
+{
+	release_speed_ = -speed;
+	release_level_per_sample_ = release_speed_ / sampling_rate_;
+}
+
+void PeakMeterBank::SetSamplingRate(size_t sampling_rate)
+{
+	dB_t const release_speed = -release_speed_;
+	sampling_rate_ = sampling_rate;
+	SetReleaseSpeed(release_speed);
+	SetHoldTime(hold_time_);
+}
+
+void PeakMeterBank::ResetHighestLevel()
+{
+	reset_highest_level_.store(true, std::memory_order_relaxed);
+}
+
+float PeakMeterBank::FindAbsMax(float const *samples, size_t num_samples)
+{
+	size_t i = 0;
+	float result = 0;
+
+#if defined(HWM_SIMD_AVX)
+	if(num_samples >= 8) {
+		__m256 const abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+		__m256 vmax = _mm256_setzero_ps();
+		for( ; i + 8 <= num_samples; i += 8) {
+			vmax = _mm256_max_ps(vmax, _mm256_and_ps(_mm256_loadu_ps(samples + i), abs_mask));
+		}
+		__m128 const m = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+		float tmp[4];
+		_mm_storeu_ps(tmp, m);
+		result = std::max(std::max(tmp[0], tmp[1]), std::max(tmp[2], tmp[3]));
+	}
+#elif defined(HWM_SIMD_SSE2)
+	if(num_samples >= 4) {
+		__m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 vmax = _mm_setzero_ps();
+		for( ; i + 4 <= num_samples; i += 4) {
+			vmax = _mm_max_ps(vmax, _mm_and_ps(_mm_loadu_ps(samples + i), abs_mask));
+		}
+		float tmp[4];
+		_mm_storeu_ps(tmp, vmax);
+		result = std::max(std::max(tmp[0], tmp[1]), std::max(tmp[2], tmp[3]));
+	}
+#elif defined(HWM_SIMD_NEON)
+	if(num_samples >= 4) {
+		float32x4_t vmax = vdupq_n_f32(0);
+		for( ; i + 4 <= num_samples; i += 4) {
+			vmax = vmaxq_f32(vmax, vabsq_f32(vld1q_f32(samples + i)));
+		}
+		result = vmaxvq_f32(vmax);
+	}
+#endif
+
+	for( ; i < num_samples; ++i) {
+		result = std::max(result, std::fabs(samples[i]));
+	}
+	return result;
+}
+
+//! ピークをnum_samples分だけ下降させて、ホールドの残りとリリースの速度を更新する。
+/*!
+	PeakMeterでは、ホールドが終わった後のリリースの速度は、
+	1サンプルごとに (1 + 4 / sampling_rate) 倍に加速して release_level_per_sample_ で頭打ちになる。
+	その等比数列の和を閉じた式で計算する。
+	@return 更新後のピークの値
+*/
+PeakMeterBank::dB_t PeakMeterBank::DecayPeak(ChannelState &state, size_t num_samples) const
+{
+	size_t const num_held = std::min(state.holding_, num_samples);
+	state.holding_ -= num_held;
+	size_t const num_decays = num_samples - num_held;
+
+	if(num_decays == 0 || state.peak_ <= minimum_dB_) {
+		return state.peak_;
+	}
+
+	dB_t const r = release_level_per_sample_;
+	dB_t const pr = state.peak_release_level_per_sample_;
+	dB_t amount = 0;
+
+	if(pr >= r || pr <= 0) {
+		//! 加速しない
+		amount = pr * num_decays;
+	} else {
+		double const a = 1 + (1.0 / sampling_rate_) * 4;
+		//! リリースの速度が頭打ちになるまでのサンプル数
+		double const steps_to_cap = std::ceil(std::log(r / pr) / std::log(a));
+		if(num_decays <= steps_to_cap) {
+			double const growth = std::pow(a, static_cast<double>(num_decays));
+			amount = pr * (growth - 1) / (a - 1);
+			state.peak_release_level_per_sample_ = std::min(pr * growth, r);
+		} else {
+			double const growth = std::pow(a, steps_to_cap);
+			amount = pr * (growth - 1) / (a - 1) + (num_decays - steps_to_cap) * r;
+			state.peak_release_level_per_sample_ = r;
+		}
+	}
+
+	state.peak_ = std::max(state.peak_ - amount, minimum_dB_);
+	return state.peak_;
+}
+
+//! 最大値がmax_dBでnum_samplesの長さの区間を処理する。最大値は区間の最後にあるものとして扱う。
+void PeakMeterBank::ProcessSegment(ChannelState &state, dB_t max_dB, size_t num_samples)
+{
+	DecayPeak(state, num_samples);
+
+	state.level_ = std::max(state.level_ - release_level_per_sample_ * num_samples, minimum_dB_);
+
+	bool new_level = false;
+	if(state.level_ < max_dB) {
+		state.level_ = max_dB;
+		new_level = true;
+	}
+
+	if(state.peak_ < state.level_) {
+		state.peak_ = state.level_;
+		state.highest_level_ = std::max(state.highest_level_, state.peak_);
+
+		if(new_level) {
+			//! 区間の最後のサンプルでホールドが始まり、そのサンプルの分だけホールドが進む
+			state.holding_ = hold_samples_ > 0 ? hold_samples_ - 1 : 0;
+			state.peak_release_level_per_sample_ = release_level_per_sample_ / 4;
+		}
+	}
+}
+
+void PeakMeterBank::SetSamples(size_t first_channel, float const * const * channels, size_t num_channels, size_t num_samples)
+{
+	assert(first_channel + num_channels <= channels_.size());
+
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		auto &state = channels_[first_channel + ch];
+		float const *samples = channels[ch];
+
+		for(size_t pos = 0; pos < num_samples; pos += kSegmentSamples) {
+			size_t const n = std::min<size_t>(kSegmentSamples, num_samples - pos);
+			float const max_value = FindAbsMax(samples + pos, n);
+			dB_t const max_dB = (max_value > 0) ? std::max<dB_t>(20 * std::log10(max_value), minimum_dB_) : minimum_dB_;
+			ProcessSegment(state, max_dB, n);
+		}
+	}
+}
+
+void PeakMeterBank::Consume(size_t first_channel, size_t num_channels, size_t num_samples)
+{
+	assert(first_channel + num_channels <= channels_.size());
+
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		ProcessSegment(channels_[first_channel + ch], minimum_dB_, num_samples);
+	}
+}
+
+void PeakMeterBank::Publish()
+{
+	if(reset_highest_level_.exchange(false, std::memory_order_relaxed)) {
+		for(auto &state: channels_) {
+			state.highest_level_ = minimum_dB_;
+		}
+	}
+
+	auto &snapshot = snapshot_.GetWriteBuffer();
+	assert(snapshot.size() == channels_.size());
+	for(size_t ch = 0; ch < channels_.size(); ++ch) {
+		snapshot[ch].peak_ = channels_[ch].peak_;
+		snapshot[ch].level_ = channels_[ch].level_;
+		snapshot[ch].highest_level_ = channels_[ch].highest_level_;
+	}
+	snapshot_.Publish();
+}
+
+}	// ::hwm
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "./TripleBuffer.hpp"
+
+namespace hwm {
+
+//! 複数のチャンネルのピークメーターをまとめて処理するクラス
+/*!
+	PeakMeterと同じ(レベルのリリース、ピークのホールドと加速するリリースの)振る舞いを、
+	サンプルごとではなく、短い区間(kSegmentSamples)ごとにまとめて計算する。
+	区間の最大値はSIMDで求め、dBへの変換も区間ごとに一度だけ行う。
+	区間の最大値はその区間の最後のサンプルにあるものとして扱うので、
+	メーターの時間方向の誤差は高々kSegmentSamples分になる。
+
+	SetSamples()とPublish()はオーディオスレッドから呼び出し、
+	UIスレッドはUpdate()とGetSnapshot()で最新の値を読み出す。
+*/
+class PeakMeterBank
+{
+public:
+	typedef double dB_t;
+	typedef int Msec;
+
+	//! ホールドやリリースを区間ごとにまとめて計算する際の区間の長さ
+	static constexpr size_t kSegmentSamples = 64;
+
+	struct ChannelLevel
+	{
+		dB_t	peak_;
+		dB_t	level_;
+		dB_t	highest_level_;
+	};
+
+	typedef std::vector<ChannelLevel> Snapshot;
+
+	PeakMeterBank(size_t num_channels,
+				  size_t sampling_rate,
+				  dB_t release_speed = -96 / 2,
+				  dB_t minimum_dB = -640);
+
+	size_t	GetNumChannels() const { return channels_.size(); }
+	size_t	GetSamplingRate() const { return sampling_rate_; }
+
+	//! オーディオスレッドで処理を行っていない時に呼び出すこと
+	void	SetHoldTime(Msec duration);
+	void	SetReleaseSpeed(dB_t speed);
+	void	SetSamplingRate(size_t sampling_rate);
+
+	//! [first_channel, first_channel + num_channels)のメーターにサンプルを入力する。
+	//! オーディオスレッドから呼び出す。
+	void	SetSamples(size_t first_channel, float const * const * channels, size_t num_channels, size_t num_samples);
+
+	//! [first_channel, first_channel + num_channels)のメーターに、無音がnum_samples続いたものとして処理する
+	void	Consume(size_t first_channel, size_t num_channels, size_t num_samples);
+
+	//! 現在のメーターの値をUIスレッドへ公開する。オーディオスレッドから呼び出す。
+	void	Publish();
+
+	//! 公開された値を取り込む。UIスレッドから呼び出す。
+	//! @return 新しい値を取り込んだ場合はtrue
+	bool	Update() { return snapshot_.Update(); }
+
+	//! Update()で取り込んだ値。UIスレッドから呼び出す。
+	Snapshot const &
+			GetSnapshot() const { return snapshot_.GetReadBuffer(); }
+
+	//! UIスレッドから呼び出してよい。次のPublish()から反映される。
+	void	ResetHighestLevel();
+
+	//! 区間の絶対値の最大値を返す
+	static
+	float	FindAbsMax(float const *samples, size_t num_samples);
+
+private:
+	struct ChannelState
+	{
+		dB_t	peak_;
+		dB_t	level_;
+		dB_t	highest_level_;
+		dB_t	peak_release_level_per_sample_;
+		size_t	holding_;
+	};
+
+	void	ProcessSegment(ChannelState &state, dB_t max_dB, size_t num_samples);
+	dB_t	DecayPeak(ChannelState &state, size_t num_samples) const;
+
+	size_t						sampling_rate_;
+	Msec						hold_time_;
+	size_t						hold_samples_;
+	dB_t						release_speed_;
+	dB_t						release_level_per_sample_;
+	dB_t						minimum_dB_;
+	std::vector<ChannelState>	channels_;
+	TripleBuffer<Snapshot>		snapshot_;
+	std::atomic<bool>			reset_highest_level_;
+};
+
+}	// ::hwm
@@ -0,0 +1,345 @@
+#include "./PluginScanCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "./ScopeExit.hpp"
+#include "./StrCnv.hpp"
+
+#include "debugger_output.hpp"
+
+namespace hwm {
+
+namespace {
+
+	char const kMagic[4] = { 'H', 'W', 'M', 'S' };
+	std::uint32_t const kFormatVersion = 2;
+
+	//! リトルエンディアンで値を書き出す
+	template<class T>
+	void WriteValue(std::vector<char> &dest, T value)
+	{
+		for(size_t i = 0; i < sizeof(T); ++i) {
+			dest.push_back(static_cast<char>((static_cast<std::uint64_t>(value) >> (i * 8)) & 0xFF));
+		}
+	}
+
+	void WriteString(std::vector<char> &dest, String const &str)
+	{
+		std::string const utf8 = to_utf8(str);
+		WriteValue<std::uint32_t>(dest, static_cast<std::uint32_t>(utf8.size()));
+		dest.insert(dest.end(), utf8.begin(), utf8.end());
+	}
+
+	template<class T>
+	bool ReadValue(char const *&pos, char const *end, T &value)
+	{
+		if(end - pos < static_cast<std::ptrdiff_t>(sizeof(T))) {
+			return false;
+		}
+
+		std::uint64_t tmp = 0;
+		for(size_t i = 0; i < sizeof(T); ++i) {
+			tmp |= static_cast<std::uint64_t>(static_cast<unsigned char>(pos[i])) << (i * 8);
+		}
+		value = static_cast<T>(tmp);
+		pos += sizeof(T);
+		return true;
+	}
+
+	bool ReadString(char const *&pos, char const *end, String &str)
+	{
+		std::uint32_t length;
+		if(!ReadValue(pos, end, length) || end - pos < static_cast<std::ptrdiff_t>(length)) {
+			return false;
+		}
+
+		str = to_wstr(std::string(pos, pos + length));
+		pos += length;
+		return true;
+	}
+
+}	// unnamed
+
+bool PluginScanCache::GetFileStamp(String const &path, FileStamp &stamp)
+{
+	struct stat st;
+	if(::stat(to_utf8(path).c_str(), &st) != 0) {
+		return false;
+	}
+
+	stamp.mtime_ = static_cast<std::int64_t>(st.st_mtime);
+	stamp.size_ = static_cast<std::uint64_t>(st.st_size);
+	return true;
+}
+
+void PluginScanCache::SerializeEntry(Entry const &entry, std::vector<char> &dest)
+{
+	WriteString(dest, entry.module_path_);
+	WriteValue<std::int64_t>(dest, entry.stamp_.mtime_);
+	WriteValue<std::uint64_t>(dest, entry.stamp_.size_);
+	WriteValue<std::uint8_t>(dest, entry.quarantined_ ? 1 : 0);
+
+	WriteString(dest, entry.factory_info_.vendor());
+	WriteString(dest, entry.factory_info_.url());
+	WriteString(dest, entry.factory_info_.email());
+	WriteValue<std::int32_t>(dest, entry.factory_info_.flags());
+
+	WriteValue<std::uint32_t>(dest, static_cast<std::uint32_t>(entry.class_info_list_.size()));
+	for(auto const &info: entry.class_info_list_) {
+		dest.insert(dest.end(), info.cid(), info.cid() + 16);
+		WriteString(dest, info.name());
+		WriteString(dest, info.category());
+		WriteValue<std::int32_t>(dest, info.cardinality());
+		WriteValue<std::uint8_t>(dest, info.is_classinfo2_enabled() ? 1 : 0);
+		if(info.is_classinfo2_enabled()) {
+			auto const &info2 = info.classinfo2();
+			WriteString(dest, info2.sub_categories());
+			WriteString(dest, info2.vendor());
+			WriteString(dest, info2.version());
+			WriteString(dest, info2.sdk_version());
+		}
+	}
+}
+
+bool PluginScanCache::DeserializeEntry(char const *&pos, char const *end, Entry &entry)
+{
+	Entry tmp;
+	std::uint8_t quarantined;
+	if(!ReadString(pos, end, tmp.module_path_) ||
+	   !ReadValue(pos, end, tmp.stamp_.mtime_) ||
+	   !ReadValue(pos, end, tmp.stamp_.size_) ||
+	   !ReadValue(pos, end, quarantined))
+	{
+		return false;
+	}
+	tmp.quarantined_ = (quarantined != 0);
+
+	String vendor, url, email;
+	std::int32_t flags;
+	if(!ReadString(pos, end, vendor) ||
+	   !ReadString(pos, end, url) ||
+	   !ReadString(pos, end, email) ||
+	   !ReadValue(pos, end, flags))
+	{
+		return false;
+	}
+	tmp.factory_info_ = FactoryInfo(vendor, url, email, flags);
+
+	std::uint32_t num_classes;
+	if(!ReadValue(pos, end, num_classes)) {
+		return false;
+	}
+
+	for(std::uint32_t i = 0; i < num_classes; ++i) {
+		ClassInfo::cid_t cid;
+		if(end - pos < static_cast<std::ptrdiff_t>(cid.size())) {
+			return false;
+		}
+		std::memcpy(cid.data(), pos, cid.size());
+		pos += cid.size();
+
+		String name, category;
+		std::int32_t cardinality;
+		std::uint8_t has_classinfo2;
+		if(!ReadString(pos, end, name) ||
+		   !ReadString(pos, end, category) ||
+		   !ReadValue(pos, end, cardinality) ||
+		   !ReadValue(pos, end, has_classinfo2))
+		{
+			return false;
+		}
+
+		std::experimental::optional<ClassInfo2Data> classinfo2;
+		if(has_classinfo2) {
+			String sub_categories, vendor, version, sdk_version;
+			if(!ReadString(pos, end, sub_categories) ||
+			   !ReadString(pos, end, vendor) ||
+			   !ReadString(pos, end, version) ||
+			   !ReadString(pos, end, sdk_version))
+			{
+				return false;
+			}
+			classinfo2 = ClassInfo2Data(sub_categories, vendor, version, sdk_version);
+		}
+
+		tmp.class_info_list_.emplace_back(cid, name, category, cardinality, classinfo2);
+	}
+
+	entry = std::move(tmp);
+	return true;
+}
+
+bool PluginScanCache::Load(String const &cache_path)
+{
+	Clear();
+
+	std::FILE *file = std::fopen(to_utf8(cache_path).c_str(), "rb");
+	if(!file) {
+		return false;
+	}
+	HWM_SCOPE_EXIT([file] { std::fclose(file); });
+
+	std::vector<char> data;
+	char buf[64 * 1024];
+	for(size_t n; (n = std::fread(buf, 1, sizeof(buf), file)) > 0; ) {
+		data.insert(data.end(), buf, buf + n);
+	}
+
+	char const *pos = data.data();
+	char const *end = data.data() + data.size();
+
+	std::uint32_t version;
+	std::uint32_t num_entries;
+	if(end - pos < static_cast<std::ptrdiff_t>(sizeof(kMagic)) ||
+	   std::memcmp(pos, kMagic, sizeof(kMagic)) != 0)
+	{
+		return false;
+	}
+	pos += sizeof(kMagic);
+
+	if(!ReadValue(pos, end, version) || version != kFormatVersion ||
+	   !ReadValue(pos, end, num_entries))
+	{
+		return false;
+	}
+
+	for(std::uint32_t i = 0; i < num_entries; ++i) {
+		Entry entry;
+		if(!DeserializeEntry(pos, end, entry)) {
+			hwm::dout << "Plugin scan cache is broken." << std::endl;
+			Clear();
+			return false;
+		}
+		Add(std::move(entry));
+	}
+
+	return true;
+}
+
+void PluginScanCache::Save(String const &cache_path) const
+{
+	std::vector<char> data;
+	data.insert(data.end(), std::begin(kMagic), std::end(kMagic));
+	WriteValue<std::uint32_t>(data, kFormatVersion);
+	WriteValue<std::uint32_t>(data, static_cast<std::uint32_t>(entries_.size()));
+	for(auto const &entry: entries_) {
+		SerializeEntry(entry, data);
+	}
+
+	//! 書き込みの途中で失敗しても既存のキャッシュが壊れないように、
+	//! 一時ファイルに書き出してから置き換える
+	std::string const path = to_utf8(cache_path);
+	std::string const tmp_path = path + ".tmp";
+
+	std::FILE *file = std::fopen(tmp_path.c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("cannot open the plugin scan cache");
+	}
+
+	bool const written = (std::fwrite(data.data(), 1, data.size(), file) == data.size());
+	bool const closed = (std::fclose(file) == 0);
+	if(!written || !closed || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+		std::remove(tmp_path.c_str());
+		throw std::runtime_error("failed to write the plugin scan cache");
+	}
+}
+
+PluginScanCache::Entry const *
+		PluginScanCache::Find(String const &module_path, FileStamp const &stamp) const
+{
+	auto found = path_to_index_.find(module_path);
+	if(found == path_to_index_.end()) {
+		return nullptr;
+	}
+
+	auto const &entry = entries_[found->second];
+	return (entry.stamp_ == stamp) ? &entry : nullptr;
+}
+
+void PluginScanCache::Add(Entry entry)
+{
+	auto found = path_to_index_.find(entry.module_path_);
+	if(found != path_to_index_.end()) {
+		entries_[found->second] = std::move(entry);
+	} else {
+		path_to_index_[entry.module_path_] = entries_.size();
+		entries_.push_back(std::move(entry));
+	}
+}
+
+void PluginScanCache::Remove(String const &module_path)
+{
+	auto found = path_to_index_.find(module_path);
+	if(found == path_to_index_.end()) {
+		return;
+	}
+
+	size_t const index = found->second;
+	path_to_index_.erase(found);
+
+	if(index != entries_.size() - 1) {
+		entries_[index] = std::move(entries_.back());
+		path_to_index_[entries_[index].module_path_] = index;
+	}
+	entries_.pop_back();
+}
+
+void PluginScanCache::Clear()
+{
+	entries_.clear();
+	path_to_index_.clear();
+}
+
+PluginScanCache::Entry
+		ScanModule(String const &module_path, PluginScanCache::FileStamp const &stamp)
+{
+	Vst3PluginFactory factory(module_path);
+
+	PluginScanCache::Entry entry;
+	entry.module_path_ = module_path;
+	entry.stamp_ = stamp;
+	entry.factory_info_ = factory.GetFactoryInfo();
+	for(size_t i = 0; i < factory.GetComponentCount(); ++i) {
+		entry.class_info_list_.push_back(factory.GetComponentInfo(i));
+	}
+
+	return entry;
+}
+
+std::vector<PluginScanCache::Entry>
+		ScanModules(std::vector<String> const &module_paths, PluginScanCache &cache)
+{
+	std::vector<PluginScanCache::Entry> result;
+
+	for(auto const &path: module_paths) {
+		PluginScanCache::FileStamp stamp;
+		if(!PluginScanCache::GetFileStamp(path, stamp)) {
+			cache.Remove(path);
+			continue;
+		}
+
+		if(auto const *cached = cache.Find(path, stamp)) {
+			if(!cached->quarantined_) {
+				result.push_back(*cached);
+			}
+			continue;
+		}
+
+		try {
+			auto entry = ScanModule(path, stamp);
+			cache.Add(entry);
+			result.push_back(std::move(entry));
+		} catch(std::exception &e) {
+			hwm::dout << "Failed to scan a module : " << to_utf8(path) << " (" << e.what() << ")" << std::endl;
+		}
+	}
+
+	return result;
+}
+
+}	// ::hwm
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "./Vst3PluginFactory.hpp"
+
+namespace hwm {
+
+//! プラグインモジュールのスキャン結果を保持して、ファイルに保存するためのキャッシュ
+/*!
+	モジュールのパス、更新時刻、ファイルサイズをキーとして、
+	Vst3PluginFactoryで取得できるFactoryInfoとClassInfoのリストをコンパクトなバイナリ形式で保存する。
+	次回の起動時には、モジュールファイルの更新時刻とサイズが一致する限り、
+	モジュールをロードせずにキャッシュからプラグインの情報を取得できる。
+*/
+struct PluginScanCache
+{
+	struct FileStamp
+	{
+		std::int64_t	mtime_;
+		std::uint64_t	size_;
+
+		bool operator==(FileStamp const &rhs) const { return mtime_ == rhs.mtime_ && size_ == rhs.size_; }
+		bool operator!=(FileStamp const &rhs) const { return !(*this == rhs); }
+	};
+
+	struct Entry
+	{
+		String					module_path_;
+		FileStamp				stamp_;
+		//! スキャン中にクラッシュ、またはタイムアウトしたモジュール。
+		//! モジュールファイルが更新されるまで再スキャンしない。
+		bool					quarantined_ = false;
+		FactoryInfo				factory_info_;
+		std::vector<ClassInfo>	class_info_list_;
+	};
+
+	//! キャッシュファイルを読み込む。
+	//! ファイルが存在しない場合や、形式が正しくない場合はfalseを返して、キャッシュは空になる。
+	bool	Load(String const &cache_path);
+
+	//! キャッシュファイルに書き出す。
+	//! @throw std::runtime_error 書き込みに失敗した場合
+	void	Save(String const &cache_path) const;
+
+	//! module_pathのエントリが存在して、そのFileStampがstampと一致していればそのエントリを返す。
+	//! そうでなければnullptrを返す。
+	Entry const *
+			Find(String const &module_path, FileStamp const &stamp) const;
+
+	//! エントリを追加する。同じモジュールパスのエントリが存在する場合は置き換える。
+	void	Add(Entry entry);
+
+	void	Remove(String const &module_path);
+
+	void	Clear();
+
+	std::vector<Entry> const &
+			GetEntries() const { return entries_; }
+
+	//! ファイルの更新時刻とサイズを取得する。ファイルが存在しない場合はfalseを返す。
+	static
+	bool	GetFileStamp(String const &path, FileStamp &stamp);
+
+	//! エントリをバイト列に変換する。
+	static
+	void	SerializeEntry(Entry const &entry, std::vector<char> &dest);
+
+	//! [pos, end)からエントリを1つ読み込んで、posを読み込んだ分だけ進める。
+	//! データが不正な場合はfalseを返す。
+	static
+	bool	DeserializeEntry(char const *&pos, char const *end, Entry &entry);
+
+private:
+	std::vector<Entry>					entries_;
+	std::unordered_map<String, size_t>	path_to_index_;
+};
+
+//! module_pathのモジュールをVst3PluginFactoryでロードして、エントリを作成する。
+//! @throw std::runtime_error モジュールをロードできなかった場合
+PluginScanCache::Entry
+		ScanModule(String const &module_path, PluginScanCache::FileStamp const &stamp);
+
+//! module_pathsのモジュールの情報を取得する。
+/*!
+	cacheに有効なエントリがあるモジュールはロードせずにそのエントリを使用する。
+	隔離されたモジュールは結果に含まれない。
+	そうでないモジュールはVst3PluginFactoryでロードして情報を取得し、cacheに追加する。
+	ロードできなかったモジュールは結果に含まれない。
+*/
+std::vector<PluginScanCache::Entry>
+		ScanModules(std::vector<String> const &module_paths, PluginScanCache &cache);
+
+}	// ::hwm
@@ -0,0 +1,348 @@
+#include "./PluginScanner.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if !defined(_MSC_VER)
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+#endif
+
+#include "./StrCnv.hpp"
+
+#include "debugger_output.hpp"
+
+namespace hwm {
+
+constexpr char PluginScanner::kWorkerOption[];
+constexpr int PluginScanner::kWorkerOutputFd;
+
+PluginScanner::PluginScanner()
+	:	max_workers_(0)
+	,	timeout_(std::chrono::seconds(30))
+{}
+
+bool PluginScanner::IsWorkerCommandLine(int argc, char **argv)
+{
+	return argc >= 2 && std::strcmp(argv[1], kWorkerOption) == 0;
+}
+
+#if defined(_MSC_VER)
+
+std::vector<PluginScanCache::Entry>
+		PluginScanner::Scan(std::vector<String> const &module_paths, PluginScanCache &cache)
+{
+	return ScanModules(module_paths, cache);
+}
+
+int PluginScanner::WorkerMain(int /*argc*/, char ** /*argv*/)
+{
+	return 1;
+}
+
+#else
+
+namespace {
+
+	//! ワーカープロセスの終了コード
+	enum WorkerExitCode {
+		kScanSucceeded = 0,
+		kLoadFailed = 1,	//!< モジュールをロードできなかった。（隔離はしない）
+		kExecFailed = 127,	//!< ワーカーの実行ファイルを起動できなかった。（隔離はしない）
+	};
+
+	//! 子プロセスに引き継がれないように、close-on-execのパイプを作成する
+	bool CreatePipe(int (&fds)[2])
+	{
+#if defined(__linux__)
+		return ::pipe2(fds, O_CLOEXEC) == 0;
+#else
+		//! pipe2がない環境では、作成してからフラグを設定する
+		if(::pipe(fds) != 0) {
+			return false;
+		}
+		for(int fd: fds) {
+			::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+		}
+		return true;
+#endif
+	}
+
+	String GetCurrentExecutablePath()
+	{
+#if defined(__APPLE__)
+		std::uint32_t size = 0;
+		::_NSGetExecutablePath(nullptr, &size);
+		std::string path(size, '\0');
+		if(::_NSGetExecutablePath(&path[0], &size) != 0) {
+			throw std::runtime_error("failed to get the path of the executable");
+		}
+		path.resize(std::strlen(path.c_str()));
+		return to_wstr(path);
+#else
+		char buf[PATH_MAX];
+		auto const n = ::readlink("/proc/self/exe", buf, sizeof(buf));
+		if(n <= 0 || static_cast<size_t>(n) >= sizeof(buf)) {
+			throw std::runtime_error("failed to get the path of the executable");
+		}
+		return to_wstr(std::string(buf, n));
+#endif
+	}
+
+	bool WriteAll(int fd, char const *data, size_t size)
+	{
+		while(size > 0) {
+			auto const n = ::write(fd, data, size);
+			if(n < 0) {
+				if(errno == EINTR) { continue; }
+				return false;
+			}
+			data += n;
+			size -= static_cast<size_t>(n);
+		}
+		return true;
+	}
+
+
+	struct Worker
+	{
+		pid_t					pid_;
+		int						fd_;
+		size_t					path_index_;
+		PluginScanCache::FileStamp
+								stamp_;
+		std::vector<char>		data_;
+		std::chrono::steady_clock::time_point
+								deadline_;
+	};
+
+	PluginScanCache::Entry MakeQuarantinedEntry(String const &module_path, PluginScanCache::FileStamp const &stamp)
+	{
+		PluginScanCache::Entry entry;
+		entry.module_path_ = module_path;
+		entry.stamp_ = stamp;
+		entry.quarantined_ = true;
+		return entry;
+	}
+
+}	// unnamed
+
+int PluginScanner::WorkerMain(int argc, char **argv)
+{
+	if(argc != 5) {
+		return kLoadFailed;
+	}
+
+	int exit_code = kLoadFailed;
+	try {
+		PluginScanCache::FileStamp stamp;
+		stamp.mtime_ = std::stoll(argv[3]);
+		stamp.size_ = std::stoull(argv[4]);
+
+		std::vector<char> data;
+		PluginScanCache::SerializeEntry(ScanModule(to_wstr(argv[2]), stamp), data);
+		if(WriteAll(kWorkerOutputFd, data.data(), data.size())) {
+			exit_code = kScanSucceeded;
+		}
+	} catch(...) {
+	}
+
+	::close(kWorkerOutputFd);
+	//! モジュールの終了処理でクラッシュしても結果には影響しないように、_exitで終了する
+	::_exit(exit_code);
+}
+
+std::vector<PluginScanCache::Entry>
+		PluginScanner::Scan(std::vector<String> const &module_paths, PluginScanCache &cache)
+{
+	//! 結果の並びをmodule_pathsの並びと一致させるため、一旦インデックスごとに保持する
+	std::vector<std::experimental::optional<PluginScanCache::Entry>> results(module_paths.size());
+
+	struct Pending { size_t path_index_; PluginScanCache::FileStamp stamp_; };
+	std::vector<Pending> pendings;
+
+	for(size_t i = 0; i < module_paths.size(); ++i) {
+		auto const &path = module_paths[i];
+
+		PluginScanCache::FileStamp stamp;
+		if(!PluginScanCache::GetFileStamp(path, stamp)) {
+			cache.Remove(path);
+			continue;
+		}
+
+		if(auto const *cached = cache.Find(path, stamp)) {
+			if(!cached->quarantined_) {
+				results[i] = *cached;
+			}
+			continue;
+		}
+
+		pendings.push_back({ i, stamp });
+	}
+
+	std::string const executable = to_utf8(worker_executable_.empty() ? GetCurrentExecutablePath() : worker_executable_);
+
+	size_t const max_workers =
+		(max_workers_ != 0) ? max_workers_ : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+	std::vector<Worker> workers;
+	std::vector<pollfd> poll_fds;
+	size_t next_pending = 0;
+
+	auto finish_worker = [&](Worker &worker, bool timed_out) {
+		auto const &path = module_paths[worker.path_index_];
+
+		if(timed_out) {
+			::kill(worker.pid_, SIGKILL);
+		}
+		::close(worker.fd_);
+
+		int status = 0;
+		while(::waitpid(worker.pid_, &status, 0) < 0 && errno == EINTR) {}
+
+		if(timed_out) {
+			hwm::dout << "Scanning timed out. quarantined : " << to_utf8(path) << std::endl;
+			cache.Add(MakeQuarantinedEntry(path, worker.stamp_));
+			return;
+		}
+
+		if(WIFEXITED(status) && WEXITSTATUS(status) == kLoadFailed) {
+			hwm::dout << "Failed to scan a module : " << to_utf8(path) << std::endl;
+			return;
+		}
+
+		if(WIFEXITED(status) && WEXITSTATUS(status) == kExecFailed) {
+			hwm::dout << "Failed to start a plugin scanner process : " << executable << std::endl;
+			return;
+		}
+
+		PluginScanCache::Entry entry;
+		char const *pos = worker.data_.data();
+		char const *end = worker.data_.data() + worker.data_.size();
+		if(!WIFEXITED(status) || WEXITSTATUS(status) != kScanSucceeded ||
+		   !PluginScanCache::DeserializeEntry(pos, end, entry))
+		{
+			hwm::dout << "Scanning crashed. quarantined : " << to_utf8(path) << std::endl;
+			cache.Add(MakeQuarantinedEntry(path, worker.stamp_));
+			return;
+		}
+
+		cache.Add(entry);
+		results[worker.path_index_] = std::move(entry);
+	};
+
+	while(next_pending < pendings.size() || !workers.empty()) {
+		while(workers.size() < max_workers && next_pending < pendings.size()) {
+			auto const &pending = pendings[next_pending++];
+
+			//! forkした後の子プロセスではメモリ確保ができないので、execの引数は先に用意しておく
+			std::string const module_path = to_utf8(module_paths[pending.path_index_]);
+			std::string const mtime = std::to_string(pending.stamp_.mtime_);
+			std::string const size = std::to_string(pending.stamp_.size_);
+			char const *args[] = {
+				executable.c_str(), kWorkerOption, module_path.c_str(), mtime.c_str(), size.c_str(), nullptr
+			};
+
+			int fds[2];
+			if(!CreatePipe(fds)) {
+				throw std::runtime_error("failed to create a pipe for the plugin scanner");
+			}
+
+			pid_t const pid = ::fork();
+			if(pid < 0) {
+				::close(fds[0]);
+				::close(fds[1]);
+				throw std::runtime_error("failed to fork a plugin scanner process");
+			}
+
+			if(pid == 0) {
+				//! ここでは非同期シグナル安全な関数だけを呼び出す。
+				//! 書き込み側のパイプをkWorkerOutputFdに複製する。dup2で複製したfdはexec後も引き継がれる。
+				//! 他のパイプはすべてclose-on-execなので、execで閉じられる。
+				if(fds[1] == kWorkerOutputFd) {
+					::fcntl(fds[1], F_SETFD, 0);
+				} else if(::dup2(fds[1], kWorkerOutputFd) < 0) {
+					::_exit(kExecFailed);
+				}
+				::execv(args[0], const_cast<char * const *>(args));
+				::_exit(kExecFailed);
+			}
+
+			::close(fds[1]);
+
+			Worker worker;
+			worker.pid_ = pid;
+			worker.fd_ = fds[0];
+			worker.path_index_ = pending.path_index_;
+			worker.stamp_ = pending.stamp_;
+			worker.deadline_ = std::chrono::steady_clock::now() + timeout_;
+			workers.push_back(std::move(worker));
+		}
+
+		auto const now = std::chrono::steady_clock::now();
+		auto nearest_deadline = workers.front().deadline_;
+		poll_fds.clear();
+		for(auto const &worker: workers) {
+			poll_fds.push_back({ worker.fd_, POLLIN, 0 });
+			nearest_deadline = std::min(nearest_deadline, worker.deadline_);
+		}
+
+		auto const wait_ms = std::max<long long>(
+			std::chrono::duration_cast<std::chrono::milliseconds>(nearest_deadline - now).count(), 0);
+
+		int const num_ready = ::poll(poll_fds.data(), poll_fds.size(), static_cast<int>(std::min<long long>(wait_ms, 1000)));
+		if(num_ready < 0 && errno != EINTR) {
+			throw std::runtime_error("failed to wait for plugin scanner processes");
+		}
+
+		//! 終了したワーカーを取り除きながら走査するので、後ろから処理する
+		for(size_t i = workers.size(); i-- > 0; ) {
+			auto &worker = workers[i];
+			bool finished = false;
+
+			if(num_ready > 0 && (poll_fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+				char buf[4096];
+				auto const n = ::read(worker.fd_, buf, sizeof(buf));
+				if(n > 0) {
+					worker.data_.insert(worker.data_.end(), buf, buf + n);
+				} else if(n == 0 || errno != EINTR) {
+					finish_worker(worker, false);
+					finished = true;
+				}
+			}
+
+			if(!finished && std::chrono::steady_clock::now() >= worker.deadline_) {
+				finish_worker(worker, true);
+				finished = true;
+			}
+
+			if(finished) {
+				workers.erase(workers.begin() + i);
+			}
+		}
+	}
+
+	std::vector<PluginScanCache::Entry> entries;
+	for(auto &result: results) {
+		if(result) { entries.push_back(std::move(*result)); }
+	}
+	return entries;
+}
+
+#endif
+
+}	// ::hwm
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "./PluginScanCache.hpp"
+
+namespace hwm {
+
+//! プラグインモジュールを子プロセスでスキャンするクラス
+/*!
+	モジュールごとにワーカープロセスを起動してモジュールをロードし、
+	取得したFactoryInfoとClassInfoをパイプ経由で受け取る。
+	マルチスレッドのプロセスからforkした子プロセスでは非同期シグナル安全な関数しか呼び出せないので、
+	ワーカープロセスはforkの直後にexecして、ワーカー用の実行ファイルを起動し直す。
+	実行ファイルは、mainの先頭でIsWorkerCommandLineを確認してWorkerMainを呼び出すこと。
+	複数のワーカープロセスを同時に実行するので、スキャンはCPUのコア数に応じて並列化される。
+
+	ワーカープロセスがクラッシュした場合やタイムアウトした場合は、
+	ホストプロセスには影響を与えずに、そのモジュールを隔離済みとしてキャッシュに記録する。
+	隔離されたモジュールは、モジュールファイルが更新されるまで再スキャンされない。
+
+	子プロセスを起動できないプラットフォームでは、ScanModules()と同じくプロセス内でスキャンする。
+*/
+struct PluginScanner
+{
+	PluginScanner();
+
+	//! 同時に実行するワーカープロセスの最大数。0の場合はCPUのコア数を使用する。
+	void	SetMaxWorkers(size_t max_workers) { max_workers_ = max_workers; }
+	size_t	GetMaxWorkers() const { return max_workers_; }
+
+	//! ワーカープロセスとして起動する実行ファイル。
+	//! 空の場合は、現在のプロセスの実行ファイルを使用する。
+	void	SetWorkerExecutable(String path) { worker_executable_ = std::move(path); }
+	String const &
+			GetWorkerExecutable() const { return worker_executable_; }
+
+	//! ワーカープロセスがこの時間内に結果を返さない場合は、プロセスを終了してモジュールを隔離する。
+	void	SetTimeout(std::chrono::milliseconds timeout) { timeout_ = timeout; }
+	std::chrono::milliseconds
+			GetTimeout() const { return timeout_; }
+
+	//! module_pathsのモジュールの情報を取得する。
+	/*!
+		cacheに有効なエントリがあるモジュールはスキャンせずにそのエントリを使用する。
+		スキャンしたモジュールの情報と隔離したモジュールはcacheに追加される。
+		ロードできなかったモジュールと隔離されたモジュールは結果に含まれない。
+	*/
+	std::vector<PluginScanCache::Entry>
+			Scan(std::vector<String> const &module_paths, PluginScanCache &cache);
+
+	//! ワーカープロセスとして起動されたことを示すコマンドラインオプション
+	static constexpr char kWorkerOption[] = "--scan-worker";
+
+	//! コマンドライン引数が、ワーカープロセスとしての起動を表しているかどうか
+	static
+	bool	IsWorkerCommandLine(int argc, char **argv);
+
+	//! ワーカープロセスの処理を行って、プロセスの終了コードを返す
+	/*!
+		"実行ファイル --scan-worker <モジュールのパス> <更新時刻> <サイズ>"として起動され、
+		スキャン結果をkWorkerOutputFdに書き出す。
+	*/
+	static
+	int		WorkerMain(int argc, char **argv);
+
+	//! ワーカープロセスがスキャン結果を書き出すファイルディスクリプタ
+	static constexpr int kWorkerOutputFd = 3;
+
+private:
+	String						worker_executable_;
+	size_t						max_workers_;
+	std::chrono::milliseconds	timeout_;
+};
+
+}	// ::hwm
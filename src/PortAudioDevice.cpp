@@ -0,0 +1,242 @@
+#include "./PortAudioDevice.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+#include "./AllocationGuard.hpp"
+#include "./SampleConvert.hpp"
+
+#include "debugger_output.hpp"
+
+namespace hwm {
+
+namespace {
+
+	void ThrowIfError(PaError err, char const *what)
+	{
+		if(err != paNoError) {
+			throw std::runtime_error(std::string(what) + " : " + Pa_GetErrorText(err));
+		}
+	}
+
+}	// unnamed
+
+PortAudioDevice::PortAudioDevice()
+	:	stream_(nullptr)
+	,	is_pa_initialized_(false)
+	,	is_started_(false)
+	,	is_non_interleaved_(false)
+{}
+
+PortAudioDevice::~PortAudioDevice()
+{
+	Close();
+}
+
+void PortAudioDevice::Open(Config const &config, callback_t callback)
+{
+	Close();
+
+	ThrowIfError(Pa_Initialize(), "failed to initialize PortAudio");
+	is_pa_initialized_ = true;
+
+	config_ = config;
+	callback_ = std::move(callback);
+	ResetXruns();
+
+	//! コールバックの中でメモリ確保を行わないように、ブロックサイズ分のバッファを確保しておく
+	input_buffer_.resize(config_.num_inputs_, config_.block_size_);
+	output_buffer_.resize(config_.num_outputs_, config_.block_size_);
+	input_heads_.resize(config_.num_inputs_);
+	output_heads_.resize(config_.num_outputs_);
+
+	PaError err = OpenStream(paFloat32 | paNonInterleaved);
+	if(err == paNoError) {
+		is_non_interleaved_ = true;
+	} else {
+		hwm::dout << "paNonInterleaved is not supported (" << Pa_GetErrorText(err) << "). "
+				  << "Falling back to an interleaved stream." << std::endl;
+		err = OpenStream(paFloat32);
+		is_non_interleaved_ = false;
+	}
+
+	if(err != paNoError) {
+		Close();
+		ThrowIfError(err, "failed to open the audio stream");
+	}
+}
+
+PaError PortAudioDevice::OpenStream(PaSampleFormat sample_format)
+{
+	PaStreamParameters input_params = {};
+	PaStreamParameters output_params = {};
+	PaStreamParameters *input = nullptr;
+	PaStreamParameters *output = nullptr;
+
+	if(config_.num_inputs_ > 0) {
+		input_params.device = Pa_GetDefaultInputDevice();
+		if(input_params.device == paNoDevice) {
+			throw std::runtime_error("no default input device");
+		}
+		input_params.channelCount = static_cast<int>(config_.num_inputs_);
+		input_params.sampleFormat = sample_format;
+		input_params.suggestedLatency = Pa_GetDeviceInfo(input_params.device)->defaultLowInputLatency;
+		input_params.hostApiSpecificStreamInfo = nullptr;
+		input = &input_params;
+	}
+
+	if(config_.num_outputs_ > 0) {
+		output_params.device = Pa_GetDefaultOutputDevice();
+		if(output_params.device == paNoDevice) {
+			throw std::runtime_error("no default output device");
+		}
+		output_params.channelCount = static_cast<int>(config_.num_outputs_);
+		output_params.sampleFormat = sample_format;
+		output_params.suggestedLatency = Pa_GetDeviceInfo(output_params.device)->defaultLowOutputLatency;
+		output_params.hostApiSpecificStreamInfo = nullptr;
+		output = &output_params;
+	}
+
+	PaError err = Pa_IsFormatSupported(input, output, config_.sampling_rate_);
+	if(err != paFormatIsSupported) {
+		return err;
+	}
+
+	return Pa_OpenStream(&stream_,
+						 input,
+						 output,
+						 config_.sampling_rate_,
+						 config_.block_size_,
+						 paClipOff,
+						 &PortAudioDevice::StreamCallback,
+						 this);
+}
+
+void PortAudioDevice::Close()
+{
+	if(stream_) {
+		Stop();
+		Pa_CloseStream(stream_);
+		stream_ = nullptr;
+	}
+
+	if(is_pa_initialized_) {
+		Pa_Terminate();
+		is_pa_initialized_ = false;
+	}
+}
+
+void PortAudioDevice::Start()
+{
+	assert(IsOpened());
+	if(is_started_) {
+		return;
+	}
+
+	ThrowIfError(Pa_StartStream(stream_), "failed to start the audio stream");
+	is_started_ = true;
+}
+
+void PortAudioDevice::Stop()
+{
+	if(!is_started_) {
+		return;
+	}
+
+	Pa_StopStream(stream_);
+	is_started_ = false;
+}
+
+int PortAudioDevice::StreamCallback(void const *input, void *output,
+									unsigned long num_frames,
+									PaStreamCallbackTimeInfo const *time_info,
+									PaStreamCallbackFlags status_flags,
+									void *user_data)
+{
+	(void)time_info;
+
+	auto *self = static_cast<PortAudioDevice *>(user_data);
+
+	if(status_flags & (paOutputUnderflow | paOutputOverflow | paInputUnderflow | paInputOverflow)) {
+		self->AddXrun();
+	}
+
+	if(self->is_non_interleaved_) {
+		self->ProcessNonInterleaved(input, output, num_frames);
+	} else {
+		self->ProcessInterleaved(input, output, num_frames);
+	}
+
+	return paContinue;
+}
+
+void PortAudioDevice::ProcessNonInterleaved(void const *input, void *output, size_t num_frames)
+{
+	HWM_ASSERT_NO_ALLOCATION();
+
+	//! paNonInterleavedでは、inputとoutputはチャンネルごとのバッファへのポインタの配列になる
+	float const * const * inputs = static_cast<float const * const *>(input);
+	float ** outputs = static_cast<float **>(output);
+
+	//! 入力のストリームが無い場合は、無音のバッファを渡す
+	if(!inputs && config_.num_inputs_ > 0) {
+		input_buffer_.clear();
+		inputs = input_buffer_.data();
+	}
+
+	//! 通常はブロックサイズ単位で呼び出されるが、それを超える場合はチャンネルのポインタをずらして分割する
+	if(num_frames <= config_.block_size_) {
+		callback_(inputs, config_.num_inputs_, outputs, config_.num_outputs_, num_frames);
+		return;
+	}
+
+	size_t const chunk_frames = std::max<size_t>(config_.block_size_, 1);
+	for(size_t pos = 0; pos < num_frames; pos += chunk_frames) {
+		size_t const n = std::min(chunk_frames, num_frames - pos);
+		for(size_t ch = 0; ch < config_.num_inputs_; ++ch) {
+			//! 無音のバッファはブロックサイズ分しか無いので、ずらさずに使う
+			input_heads_[ch] = const_cast<float *>(inputs[ch]) + (input == nullptr ? 0 : pos);
+		}
+		for(size_t ch = 0; ch < config_.num_outputs_; ++ch) {
+			output_heads_[ch] = outputs[ch] + pos;
+		}
+		callback_(input_heads_.data(), config_.num_inputs_, output_heads_.data(), config_.num_outputs_, n);
+	}
+}
+
+void PortAudioDevice::ProcessInterleaved(void const *input, void *output, size_t num_frames)
+{
+	HWM_ASSERT_NO_ALLOCATION();
+
+	float const *in = static_cast<float const *>(input);
+	float *out = static_cast<float *>(output);
+
+	//! 内部のバッファはブロックサイズ分しか無いので、それを超える場合は分割して処理する
+	size_t const chunk_frames = std::max<size_t>(config_.block_size_, 1);
+	for(size_t pos = 0; pos < num_frames; pos += chunk_frames) {
+		size_t const n = std::min(chunk_frames, num_frames - pos);
+
+		for(size_t ch = 0; ch < config_.num_inputs_; ++ch) {
+			input_heads_[ch] = input_buffer_.data()[ch];
+		}
+		for(size_t ch = 0; ch < config_.num_outputs_; ++ch) {
+			output_heads_[ch] = output_buffer_.data()[ch];
+		}
+
+		if(in) {
+			Deinterleave(in + pos * config_.num_inputs_, config_.num_inputs_, input_heads_.data(), n);
+		} else {
+			input_buffer_.clear();
+		}
+
+		callback_(input_heads_.data(), config_.num_inputs_, output_heads_.data(), config_.num_outputs_, n);
+
+		if(out) {
+			Interleave(output_heads_.data(), config_.num_outputs_, out + pos * config_.num_outputs_, n);
+		}
+	}
+}
+
+}	// ::hwm
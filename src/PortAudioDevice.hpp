@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+
+#include <portaudio.h>
+
+#include "./AudioDevice.hpp"
+#include "./Buffer.hpp"
+
+namespace hwm {
+
+//! PortAudioのストリームをチャンネルごとのバッファで扱うためのクラス
+/*!
+	バックエンドが対応していれば paNonInterleaved でストリームを開き、
+	PortAudioのチャンネルごとのバッファをそのままコールバックに渡す。
+	これにより、コールバックの中でプラグインの出力をデバイスのバッファへ直接書き込める。
+
+	バックエンドがpaNonInterleavedに対応していない場合だけ、インターリーブされたストリームを開き、
+	内部のバッファとデバイスのバッファの間でインターリーブ/デインターリーブを行う。
+*/
+class PortAudioDevice
+	:	public AudioDevice
+{
+public:
+	PortAudioDevice();
+	~PortAudioDevice();
+
+	//! デフォルトの入出力デバイスでストリームを開く
+	void	Open(Config const &config, callback_t callback) override;
+	void	Close() override;
+	bool	IsOpened() const override { return stream_ != nullptr; }
+
+	void	Start() override;
+	void	Stop() override;
+
+	char const *
+			GetDriverName() const override { return "portaudio"; }
+
+	Config const &
+			GetConfig() const override { return config_; }
+
+	//! paNonInterleavedでストリームを開けたかどうか
+	bool	IsNonInterleaved() const { return is_non_interleaved_; }
+
+private:
+	static int	StreamCallback(void const *input, void *output,
+							   unsigned long num_frames,
+							   PaStreamCallbackTimeInfo const *time_info,
+							   PaStreamCallbackFlags status_flags,
+							   void *user_data);
+
+	void	ProcessNonInterleaved(void const *input, void *output, size_t num_frames);
+	void	ProcessInterleaved(void const *input, void *output, size_t num_frames);
+
+	PaError	OpenStream(PaSampleFormat sample_format);
+
+	Config			config_;
+	callback_t		callback_;
+	PaStream *		stream_;
+	bool			is_pa_initialized_;
+	bool			is_started_;
+	bool			is_non_interleaved_;
+
+	//! 入力が無い場合にコールバックへ渡す無音のバッファ、
+	//! およびインターリーブのストリームを開いた場合の変換用のバッファ
+	Buffer<float>	input_buffer_;
+	Buffer<float>	output_buffer_;
+	std::vector<float *>	input_heads_;
+	std::vector<float *>	output_heads_;
+};
+
+}	// ::hwm
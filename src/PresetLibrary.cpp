@@ -0,0 +1,307 @@
+#include "./PresetLibrary.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#include "./StrCnv.hpp"
+
+namespace hwm {
+
+namespace {
+
+	String const kPresetExtension = L".vstpreset";
+
+#if defined(_MSC_VER)
+	String const kPathSeparators = L"/\\";
+#else
+	String const kPathSeparators = L"/";
+#endif
+
+	//! 英数字以外の文字で区切って、小文字にした単語をfに渡す
+	template<class F>
+	void ForEachToken(String const &text, F f)
+	{
+		String token;
+		for(auto c: text) {
+			if(std::iswalnum(c)) {
+				token.push_back(std::towlower(c));
+			} else if(!token.empty()) {
+				f(token);
+				token.clear();
+			}
+		}
+		if(!token.empty()) {
+			f(token);
+		}
+	}
+
+	bool EndsWith(String const &str, String const &suffix)
+	{
+		return str.size() >= suffix.size() &&
+			   std::equal(suffix.rbegin(), suffix.rend(), str.rbegin(),
+						  [](wchar_t a, wchar_t b) { return std::towlower(a) == std::towlower(b); });
+	}
+
+	String GetFileName(String const &path)
+	{
+		auto const pos = path.find_last_of(kPathSeparators);
+		return (pos == String::npos) ? path : path.substr(pos + 1);
+	}
+
+	String GetParentName(String const &path)
+	{
+		auto const pos = path.find_last_of(kPathSeparators);
+		if(pos == String::npos || pos == 0) {
+			return String();
+		}
+		return GetFileName(path.substr(0, pos));
+	}
+
+#if defined(_MSC_VER)
+
+	void ScanDirectory(String const &dir, std::vector<String> &found)
+	{
+		WIN32_FIND_DATAW data;
+		HANDLE h = ::FindFirstFileW((dir + L"\\*").c_str(), &data);
+		if(h == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		do {
+			if(std::wcscmp(data.cFileName, L".") == 0 || std::wcscmp(data.cFileName, L"..") == 0) {
+				continue;
+			}
+			//! シンボリックリンクやジャンクションは辿らない。ディレクトリの循環を避けるため。
+			if(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) {
+				continue;
+			}
+
+			String const path = dir + L"\\" + data.cFileName;
+			if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				ScanDirectory(path, found);
+			} else {
+				found.push_back(path);
+			}
+		} while(::FindNextFileW(h, &data));
+
+		::FindClose(h);
+	}
+
+#else
+
+	void ScanDirectoryUtf8(std::string const &dir, std::vector<String> &found)
+	{
+		DIR *d = ::opendir(dir.c_str());
+		if(!d) {
+			return;
+		}
+
+		while(auto *ent = ::readdir(d)) {
+			if(std::strcmp(ent->d_name, ".") == 0 || std::strcmp(ent->d_name, "..") == 0) {
+				continue;
+			}
+
+			std::string const path = dir + "/" + ent->d_name;
+			//! シンボリックリンクは辿らない。ディレクトリの循環を避けるため。
+			struct stat st;
+			if(::lstat(path.c_str(), &st) != 0) {
+				continue;
+			}
+
+			if(S_ISDIR(st.st_mode)) {
+				ScanDirectoryUtf8(path, found);
+			} else if(S_ISREG(st.st_mode)) {
+				found.push_back(to_wstr(path));
+			}
+		}
+
+		::closedir(d);
+	}
+
+	void ScanDirectory(String const &dir, std::vector<String> &found)
+	{
+		ScanDirectoryUtf8(to_utf8(dir), found);
+	}
+
+#endif
+
+}	// unnamed
+
+PresetLibrary::PresetLibrary()
+	:	num_unsorted_tokens_(0)
+{}
+
+size_t PresetLibrary::Scan(String const &root)
+{
+	String dir = root;
+	while(dir.size() > 1 && kPathSeparators.find(dir.back()) != String::npos) {
+		dir.pop_back();
+	}
+
+	std::vector<String> found;
+	ScanDirectory(dir, found);
+	//! 走査の順序はファイルシステムに依存するので、パスの順に並べておく
+	std::sort(found.begin(), found.end());
+
+	size_t num_added = 0;
+	for(auto const &path: found) {
+		if(EndsWith(path, kPresetExtension)) {
+			Add(path);
+			++num_added;
+		}
+	}
+	return num_added;
+}
+
+void PresetLibrary::Add(String const &path)
+{
+	Entry entry;
+	entry.path_ = path;
+	entry.name_ = GetFileName(path);
+	if(EndsWith(entry.name_, kPresetExtension)) {
+		entry.name_.resize(entry.name_.size() - kPresetExtension.size());
+	}
+	entry.category_ = GetParentName(path);
+
+	size_t const index = entries_.size();
+	entries_.push_back(std::move(entry));
+	class_id_states_.push_back(ClassIDState::kNotLoaded);
+	class_ids_.emplace_back();
+
+	AddTokens(entries_[index].name_, index);
+	AddTokens(entries_[index].category_, index);
+}
+
+void PresetLibrary::Clear()
+{
+	entries_.clear();
+	index_.clear();
+	num_unsorted_tokens_ = 0;
+	class_id_states_.clear();
+	class_ids_.clear();
+}
+
+std::vector<size_t>
+		PresetLibrary::Search(String const &query) const
+{
+	std::vector<size_t> result;
+	bool first_token = true;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	SortIndex();
+
+	ForEachToken(query, [&](String const &token) {
+		if(!first_token && result.empty()) {
+			return;
+		}
+
+		std::vector<size_t> matched;
+		auto it = std::lower_bound(index_.begin(), index_.end(), token,
+								   [](auto const &entry, String const &key) { return entry.first < key; });
+		for( ; it != index_.end() && it->first.compare(0, token.size(), token) == 0; ++it) {
+			matched.push_back(it->second);
+		}
+		std::sort(matched.begin(), matched.end());
+		matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+
+		if(first_token) {
+			result = std::move(matched);
+			first_token = false;
+		} else {
+			std::vector<size_t> intersection;
+			std::set_intersection(result.begin(), result.end(),
+								  matched.begin(), matched.end(),
+								  std::back_inserter(intersection));
+			result = std::move(intersection);
+		}
+	});
+
+	if(first_token) {
+		result.resize(entries_.size());
+		for(size_t i = 0; i < result.size(); ++i) {
+			result[i] = i;
+		}
+	}
+
+	return result;
+}
+
+bool PresetLibrary::GetClassID(size_t index, cid_t &class_id) const
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto const state = class_id_states_[index];
+		if(state == ClassIDState::kFailed) {
+			return false;
+		}
+		if(state == ClassIDState::kLoaded) {
+			class_id = class_ids_[index];
+			return true;
+		}
+	}
+
+	//! ファイルの読み込みはロックの外で行う。同時に読み込まれても結果は同じになる。
+	cid_t loaded;
+	bool const read = VstPresetFile::ReadClassID(entries_[index].path_, loaded);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if(!read) {
+		class_id_states_[index] = ClassIDState::kFailed;
+		return false;
+	}
+	class_id_states_[index] = ClassIDState::kLoaded;
+	class_ids_[index] = loaded;
+	class_id = loaded;
+	return true;
+}
+
+void PresetLibrary::Apply(size_t index, Vst3Plugin &plugin) const
+{
+	VstPresetFile const file(entries_[index].path_);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		class_ids_[index] = file.GetClassID();
+		class_id_states_[index] = ClassIDState::kLoaded;
+	}
+
+	if(file.GetClassID() != plugin.GetClassID()) {
+		throw std::runtime_error("the preset is not for this plugin");
+	}
+
+	plugin.SetState(file.GetState());
+}
+
+void PresetLibrary::AddTokens(String const &text, size_t index)
+{
+	ForEachToken(text, [&](String const &token) {
+		index_.emplace_back(token, index);
+		++num_unsorted_tokens_;
+	});
+}
+
+void PresetLibrary::SortIndex() const
+{
+	if(num_unsorted_tokens_ == 0) {
+		return;
+	}
+
+	//! 追加された単語だけをソートして、ソート済みの部分とマージする
+	auto const middle = index_.end() - num_unsorted_tokens_;
+	std::sort(middle, index_.end());
+	std::inplace_merge(index_.begin(), middle, index_.end());
+	num_unsorted_tokens_ = 0;
+}
+
+}	// ::hwm
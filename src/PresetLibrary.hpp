@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "./Vst3Plugin.hpp"
+#include "./VstPresetFile.hpp"
+
+namespace hwm {
+
+//! .vstpresetファイルの一覧を保持して、名前で検索するためのクラス
+/*!
+	Scanではディレクトリを走査してファイルのパスを集めるだけで、ファイルの内容は読み込まない。
+	クラスIDはGetClassIDで初めて要求されたときにヘッダだけを読み込み、
+	チャンクのデータはApplyでプラグインに適用するときに初めてマップする。
+
+	検索には、プリセット名と親ディレクトリ名を単語に分割して小文字にしたものを
+	ソート済みの配列に格納したインデックスを使用する。
+	クエリの各単語を前方一致で探して、すべての単語に一致したプリセットを返す。
+
+	constのメンバー関数（Search、GetClassID、Applyなど）は、内部のキャッシュをmutex_で保護しているので
+	複数のスレッドから同時に呼び出してもよい。
+	Scan、Add、Clearは、他のメンバー関数と同時に呼び出してはならない。
+*/
+class PresetLibrary
+{
+public:
+	typedef VstPresetFile::cid_t cid_t;
+
+	struct Entry
+	{
+		String	path_;
+		//! 拡張子を除いたファイル名
+		String	name_;
+		//! 親ディレクトリの名前
+		String	category_;
+	};
+
+	PresetLibrary();
+
+	//! rootディレクトリ以下の.vstpresetファイルを再帰的に探して追加する。
+	//! @return 追加したプリセットの数
+	size_t	Scan(String const &root);
+
+	//! .vstpresetファイルを1つ追加する
+	void	Add(String const &path);
+
+	void	Clear();
+
+	size_t	size() const { return entries_.size(); }
+
+	Entry const &	GetEntry(size_t index) const { return entries_[index]; }
+
+	//! queryのすべての単語に前方一致するプリセットのインデックスを、昇順で返す。
+	//! queryが空の場合はすべてのプリセットを返す。
+	std::vector<size_t>
+			Search(String const &query) const;
+
+	//! プリセットのクラスIDを取得する。初回はファイルのヘッダだけを読み込む。
+	//! @return ファイルを読み込めない場合はfalse
+	bool	GetClassID(size_t index, cid_t &class_id) const;
+
+	//! プリセットをプラグインに適用する
+	/*!
+		@throw std::runtime_error ファイルが読み込めない場合や、
+		プリセットのクラスIDがプラグインと一致しない場合、状態の設定に失敗した場合
+	*/
+	void	Apply(size_t index, Vst3Plugin &plugin) const;
+
+private:
+	enum class ClassIDState : char { kNotLoaded, kLoaded, kFailed };
+
+	std::vector<Entry>						entries_;
+	//! 以下のmutableなキャッシュを保護する
+	mutable std::mutex						mutex_;
+	//! 単語とプリセットのインデックスの組。単語の順にソートされている。
+	mutable std::vector<std::pair<String, size_t>>
+											index_;
+	//! index_に未登録の単語の数。Searchの前にまとめてソートする。
+	mutable size_t							num_unsorted_tokens_;
+
+	mutable std::vector<ClassIDState>		class_id_states_;
+	mutable std::vector<cid_t>				class_ids_;
+
+	void	AddTokens(String const &text, size_t index);
+	//! mutex_をロックした状態で呼び出す
+	void	SortIndex() const;
+};
+
+}	// ::hwm
@@ -0,0 +1,270 @@
+#include "./ProcessGraph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <thread>
+
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+
+namespace hwm {
+
+struct ProcessGraph::Node
+{
+	explicit
+	Node(Vst3Plugin &plugin)
+		:	plugin_(&plugin)
+		,	num_predecessors_(0)
+		,	remaining_(0)
+		,	start_ns_(0)
+		,	end_ns_(0)
+	{}
+
+	Vst3Plugin *			plugin_;
+	std::vector<node_id_t>	predecessors_;
+	std::vector<node_id_t>	successors_;
+	size_t					num_predecessors_;
+	//! このブロックで、まだ処理が終わっていない先行ノードの数
+	std::atomic<size_t>		remaining_;
+	//! ワーカースレッドが書き込み、GetNodeTimingで別のスレッドから読み出す
+	std::atomic<std::int64_t>	start_ns_;
+	std::atomic<std::int64_t>	end_ns_;
+};
+
+ProcessGraph::ProcessGraph(ThreadPool &pool)
+	:	pool_(&pool)
+	,	is_prepared_(false)
+	,	num_finished_(0)
+	,	frame_pos_(0)
+	,	num_samples_(0)
+{}
+
+ProcessGraph::~ProcessGraph()
+{
+	//! 接続したバッファがプラグインに残らないように解除しておく
+	for(auto const &edge: edges_) {
+		nodes_[edge.dest_]->plugin_->ConnectInputBus(edge.dest_bus_, nullptr);
+	}
+}
+
+ProcessGraph::node_id_t
+		ProcessGraph::AddNode(Vst3Plugin &plugin)
+{
+	nodes_.push_back(std::make_unique<Node>(plugin));
+	is_prepared_ = false;
+	return nodes_.size() - 1;
+}
+
+size_t ProcessGraph::GetNumNodes() const
+{
+	return nodes_.size();
+}
+
+Vst3Plugin & ProcessGraph::GetPlugin(node_id_t node)
+{
+	assert(node < nodes_.size());
+	return *nodes_[node]->plugin_;
+}
+
+void ProcessGraph::Connect(node_id_t src, size_t src_bus, node_id_t dest, size_t dest_bus)
+{
+	assert(src < nodes_.size());
+	assert(dest < nodes_.size());
+
+	auto &src_plugin = *nodes_[src]->plugin_;
+	auto &dest_plugin = *nodes_[dest]->plugin_;
+
+	if(src_bus >= src_plugin.GetNumOutputBuses() || dest_bus >= dest_plugin.GetNumInputBuses()) {
+		throw std::runtime_error("invalid bus index");
+	}
+
+	if(src_plugin.GetOutputBusChannels(src_bus) != dest_plugin.GetInputBusChannels(dest_bus)) {
+		throw std::runtime_error("channel count mismatch");
+	}
+
+	for(auto const &edge: edges_) {
+		if(edge.dest_ == dest && edge.dest_bus_ == dest_bus) {
+			throw std::runtime_error("the input bus is already connected");
+		}
+	}
+
+	edges_.push_back(Edge { src, src_bus, dest, dest_bus });
+	is_prepared_ = false;
+}
+
+void ProcessGraph::Prepare()
+{
+	for(auto &node: nodes_) {
+		node->predecessors_.clear();
+		node->successors_.clear();
+	}
+
+	for(auto const &edge: edges_) {
+		auto &succ = nodes_[edge.src_]->successors_;
+		if(std::find(succ.begin(), succ.end(), edge.dest_) == succ.end()) {
+			succ.push_back(edge.dest_);
+			nodes_[edge.dest_]->predecessors_.push_back(edge.src_);
+		}
+	}
+
+	//! Kahnのアルゴリズムでトポロジカルソートする
+	std::vector<size_t> in_degree(nodes_.size());
+	std::vector<node_id_t> sorted;
+	std::vector<node_id_t> roots;
+	for(node_id_t i = 0; i < nodes_.size(); ++i) {
+		nodes_[i]->num_predecessors_ = nodes_[i]->predecessors_.size();
+		in_degree[i] = nodes_[i]->num_predecessors_;
+		if(in_degree[i] == 0) {
+			roots.push_back(i);
+			sorted.push_back(i);
+		}
+	}
+
+	for(size_t i = 0; i < sorted.size(); ++i) {
+		for(auto succ: nodes_[sorted[i]]->successors_) {
+			if(--in_degree[succ] == 0) {
+				sorted.push_back(succ);
+			}
+		}
+	}
+
+	if(sorted.size() != nodes_.size()) {
+		throw std::runtime_error("the process graph has a cycle");
+	}
+
+	for(auto const &edge: edges_) {
+		auto &src_plugin = *nodes_[edge.src_]->plugin_;
+		auto &dest_plugin = *nodes_[edge.dest_]->plugin_;
+		if(src_plugin.GetSymbolicSampleSize() != dest_plugin.GetSymbolicSampleSize()) {
+			throw std::runtime_error("sample size mismatch");
+		}
+
+		if(src_plugin.GetSymbolicSampleSize() == Steinberg::Vst::SymbolicSampleSizes::kSample64) {
+			dest_plugin.ConnectInputBus64(edge.dest_bus_, src_plugin.GetOutputBusBuffers64(edge.src_bus_));
+		} else {
+			dest_plugin.ConnectInputBus(edge.dest_bus_, src_plugin.GetOutputBusBuffers(edge.src_bus_));
+		}
+	}
+
+	sorted_.swap(sorted);
+	roots_.swap(roots);
+	is_prepared_ = true;
+}
+
+void ProcessGraph::Process(size_t frame_pos, size_t num_samples)
+{
+	assert(is_prepared_);
+
+	if(nodes_.empty()) {
+		return;
+	}
+
+	frame_pos_ = frame_pos;
+	num_samples_ = num_samples;
+	block_start_ = std::chrono::steady_clock::now();
+
+	for(auto &node: nodes_) {
+		node->remaining_.store(node->num_predecessors_, std::memory_order_relaxed);
+	}
+	num_finished_.store(0, std::memory_order_release);
+
+	pool_->BeginBusySection();
+
+	for(auto root: roots_) {
+		pool_->Submit(ThreadPool::Task { &ProcessGraph::ProcessNodeTask, this, root });
+	}
+
+	while(num_finished_.load(std::memory_order_acquire) < nodes_.size()) {
+		if(!pool_->RunOne()) {
+			std::this_thread::yield();
+		}
+	}
+
+	pool_->EndBusySection();
+}
+
+void ProcessGraph::ProcessNodeTask(void *context, size_t node)
+{
+	static_cast<ProcessGraph *>(context)->ProcessNode(node);
+}
+
+void ProcessGraph::ProcessNode(node_id_t id)
+{
+	auto &node = *nodes_[id];
+
+	node.start_ns_.store(GetElapsedNanoseconds(), std::memory_order_relaxed);
+	if(node.plugin_->GetSymbolicSampleSize() == Steinberg::Vst::SymbolicSampleSizes::kSample64) {
+		node.plugin_->ProcessAudio64(frame_pos_, num_samples_);
+	} else {
+		node.plugin_->ProcessAudio(frame_pos_, num_samples_);
+	}
+	node.end_ns_.store(GetElapsedNanoseconds(), std::memory_order_relaxed);
+
+	for(auto succ: node.successors_) {
+		if(nodes_[succ]->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			pool_->Submit(ThreadPool::Task { &ProcessGraph::ProcessNodeTask, this, succ });
+		}
+	}
+
+	num_finished_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::int64_t ProcessGraph::GetElapsedNanoseconds() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - block_start_
+		).count();
+}
+
+ProcessGraph::NodeTiming
+		ProcessGraph::GetNodeTiming(node_id_t id) const
+{
+	assert(id < nodes_.size());
+	auto const &node = *nodes_[id];
+
+	NodeTiming timing;
+	timing.start_ = node.start_ns_.load(std::memory_order_relaxed) / 1e9;
+	timing.end_ = node.end_ns_.load(std::memory_order_relaxed) / 1e9;
+	return timing;
+}
+
+double ProcessGraph::GetCriticalPath(std::vector<node_id_t> &path) const
+{
+	path.clear();
+	if(sorted_.empty()) {
+		return 0;
+	}
+
+	//! トポロジカル順に、各ノードで終わる経路の処理時間の最大値を求める
+	size_t const npos = static_cast<size_t>(-1);
+	std::vector<double> longest(nodes_.size(), 0);
+	std::vector<size_t> prev(nodes_.size(), npos);
+
+	for(auto id: sorted_) {
+		auto const &node = *nodes_[id];
+		double max_pred = 0;
+		for(auto pred: node.predecessors_) {
+			if(prev[id] == npos || longest[pred] > max_pred) {
+				max_pred = longest[pred];
+				prev[id] = pred;
+			}
+		}
+		longest[id] = max_pred + GetNodeTiming(id).duration();
+	}
+
+	node_id_t last = sorted_[0];
+	for(auto id: sorted_) {
+		if(longest[id] > longest[last]) {
+			last = id;
+		}
+	}
+
+	for(size_t id = last; id != npos; id = prev[id]) {
+		path.push_back(id);
+	}
+	std::reverse(path.begin(), path.end());
+
+	return longest[last];
+}
+
+}	// ::hwm
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "./ThreadPool.hpp"
+#include "./Vst3Plugin.hpp"
+
+namespace hwm {
+
+//! 複数のVst3Pluginを接続して、1つのオーディオブロックを並列に処理するグラフ
+/*!
+	ノード(プラグイン)の出力バスを別のノードの入力バスに接続すると、
+	出力バスのバッファがコピーされずにそのまま接続先の入力バスに渡される。
+	接続するノード同士は、同じSymbolicSampleSizeで処理するように設定されていなければならない。
+	Processでは、依存関係のないノード同士がThreadPoolのワーカーで並列に処理される。
+	ノードの処理時間は毎ブロック記録され、GetCriticalPathでブロック処理時間を決めている経路を取得できる。
+
+	ノードの追加と接続はPrepareの前に行う。
+	プラグインのSetBlockSizeなどでバッファが作り直された場合は、再度Prepareを呼び出す必要がある。
+*/
+struct ProcessGraph
+{
+	typedef size_t node_id_t;
+
+	struct NodeTiming
+	{
+		//! ブロック処理の開始からノードの処理開始までの時間(秒)
+		double	start_;
+		//! ブロック処理の開始からノードの処理終了までの時間(秒)
+		double	end_;
+
+		double	duration() const { return end_ - start_; }
+	};
+
+	explicit
+	ProcessGraph(ThreadPool &pool);
+	~ProcessGraph();
+
+	ProcessGraph(ProcessGraph const &) = delete;
+	ProcessGraph & operator=(ProcessGraph const &) = delete;
+
+	node_id_t	AddNode(Vst3Plugin &plugin);
+	size_t		GetNumNodes() const;
+	Vst3Plugin &
+				GetPlugin(node_id_t node);
+
+	//! srcの出力バスsrc_busを、destの入力バスdest_busに接続する。
+	//! @throw std::runtime_error チャンネル数が一致しない場合や、dest_busが既に接続されている場合
+	void	Connect(node_id_t src, size_t src_bus, node_id_t dest, size_t dest_bus);
+
+	//! ノードをトポロジカルソートして、入力バスにバッファを接続する。
+	//! @throw std::runtime_error 接続が循環している場合や、接続したノードのSymbolicSampleSizeが異なる場合
+	void	Prepare();
+
+	//! すべてのノードのProcessAudioを呼び出して、1ブロック分を処理する。
+	//! 呼び出したスレッドも、処理が終わるまでノードの処理に参加する。
+	void	Process(size_t frame_pos, size_t num_samples);
+
+	//! 直前のProcessでのノードの処理時間
+	NodeTiming
+			GetNodeTiming(node_id_t node) const;
+
+	//! 直前のProcessで、処理時間の合計が最も長くなる依存関係の経路を取得する。
+	//! @return 経路上のノードの処理時間の合計(秒)
+	double	GetCriticalPath(std::vector<node_id_t> &path) const;
+
+private:
+	struct Node;
+
+	struct Edge
+	{
+		node_id_t	src_;
+		size_t		src_bus_;
+		node_id_t	dest_;
+		size_t		dest_bus_;
+	};
+
+	static void ProcessNodeTask(void *context, size_t node);
+	void	ProcessNode(node_id_t node);
+	std::int64_t
+			GetElapsedNanoseconds() const;
+
+	ThreadPool *						pool_;
+	std::vector<std::unique_ptr<Node>>	nodes_;
+	std::vector<Edge>					edges_;
+	std::vector<node_id_t>				sorted_;
+	std::vector<node_id_t>				roots_;
+	bool								is_prepared_;
+
+	std::atomic<size_t>					num_finished_;
+	size_t								frame_pos_;
+	size_t								num_samples_;
+	std::chrono::steady_clock::time_point	block_start_;
+};
+
+}	// ::hwm
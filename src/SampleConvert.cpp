@@ -0,0 +1,583 @@
+#include "./SampleConvert.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "./Simd.hpp"
+
+namespace hwm {
+
+namespace {
+
+	//! 整数フォーマットへの変換で使用するスケールと、クリップする範囲
+	//! 2^31-1はfloatで表現できないので、kInt32の上限はfloatで表現できる2^31未満の最大値にする
+	float const kInt16Scale = 32768.0f;
+	float const kInt16Max = 32767.0f;
+	float const kInt24Scale = 8388608.0f;
+	float const kInt24Max = 8388607.0f;
+	float const kInt32Scale = 2147483648.0f;
+	float const kInt32Max = 2147483520.0f;
+
+	//! WriteInterleaved/ReadInterleavedで一度に変換するサンプル数
+	size_t const kChunkSamples = 2048;
+	//! チャンネルごとの先頭位置をスタック上に保持して変換するチャンネル数の上限。
+	//! これより多い場合は1フレームずつ変換する。
+	size_t const kMaxChunkChannels = 64;
+
+	std::int32_t QuantizeScalar(float value, float scale, float max_value, TpdfDither *dither)
+	{
+		float v = value * scale;
+		if(dither) { v += dither->Next(); }
+		v = std::min(std::max(v, -scale), max_value);
+		//! SIMDのパスの変換命令と同じく、現在の丸めモード（既定では最近接偶数丸め）で丸める
+		return static_cast<std::int32_t>(std::nearbyint(v));
+	}
+
+	//! src[i] * scaleを[-scale, max_value]にクリップして、最も近い整数に丸める
+	void QuantizeToInt32(float const *src, std::int32_t *dest, size_t num_samples,
+						 float scale, float max_value, TpdfDither *dither)
+	{
+		size_t i = 0;
+
+		if(dither) {
+			for( ; i < num_samples; ++i) {
+				dest[i] = QuantizeScalar(src[i], scale, max_value, dither);
+			}
+			return;
+		}
+
+#if defined(HWM_SIMD_AVX)
+		__m256 const vscale8 = _mm256_set1_ps(scale);
+		__m256 const vmin8 = _mm256_set1_ps(-scale);
+		__m256 const vmax8 = _mm256_set1_ps(max_value);
+		for( ; i + 8 <= num_samples; i += 8) {
+			__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), vscale8);
+			v = _mm256_min_ps(_mm256_max_ps(v, vmin8), vmax8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dest + i), _mm256_cvtps_epi32(v));
+		}
+#endif
+
+#if defined(HWM_SIMD_SSE2)
+		__m128 const vscale = _mm_set1_ps(scale);
+		__m128 const vmin = _mm_set1_ps(-scale);
+		__m128 const vmax = _mm_set1_ps(max_value);
+		for( ; i + 4 <= num_samples; i += 4) {
+			__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), vscale);
+			v = _mm_min_ps(_mm_max_ps(v, vmin), vmax);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_cvtps_epi32(v));
+		}
+#elif defined(HWM_SIMD_NEON)
+		float32x4_t const vscale = vdupq_n_f32(scale);
+		float32x4_t const vmin = vdupq_n_f32(-scale);
+		float32x4_t const vmax = vdupq_n_f32(max_value);
+		for( ; i + 4 <= num_samples; i += 4) {
+			float32x4_t v = vmulq_f32(vld1q_f32(src + i), vscale);
+			v = vminq_f32(vmaxq_f32(v, vmin), vmax);
+			vst1q_s32(dest + i, vcvtq_s32_f32(vrndnq_f32(v)));
+		}
+#endif
+
+		for( ; i < num_samples; ++i) {
+			dest[i] = QuantizeScalar(src[i], scale, max_value, nullptr);
+		}
+	}
+
+	void ScaleToFloat(std::int32_t const *src, float *dest, size_t num_samples, float scale)
+	{
+		size_t i = 0;
+#if defined(HWM_SIMD_SSE2)
+		__m128 const vscale = _mm_set1_ps(scale);
+		for( ; i + 4 <= num_samples; i += 4) {
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(v), vscale));
+		}
+#elif defined(HWM_SIMD_NEON)
+		float32x4_t const vscale = vdupq_n_f32(scale);
+		for( ; i + 4 <= num_samples; i += 4) {
+			vst1q_f32(dest + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src + i)), vscale));
+		}
+#endif
+		for( ; i < num_samples; ++i) {
+			dest[i] = src[i] * scale;
+		}
+	}
+
+	void InterleaveGeneric(float const * const * src, size_t num_channels, float *dest, size_t begin, size_t num_frames)
+	{
+		for(size_t i = begin; i < num_frames; ++i) {
+			float *frame = dest + i * num_channels;
+			for(size_t ch = 0; ch < num_channels; ++ch) {
+				frame[ch] = src[ch][i];
+			}
+		}
+	}
+
+	void DeinterleaveGeneric(float const *src, size_t num_channels, float * const * dest, size_t begin, size_t num_frames)
+	{
+		for(size_t i = begin; i < num_frames; ++i) {
+			float const *frame = src + i * num_channels;
+			for(size_t ch = 0; ch < num_channels; ++ch) {
+				dest[ch][i] = frame[ch];
+			}
+		}
+	}
+
+	void Interleave2(float const * const * src, float *dest, size_t num_frames)
+	{
+		float const *left = src[0];
+		float const *right = src[1];
+		size_t i = 0;
+
+#if defined(HWM_SIMD_AVX)
+		for( ; i + 8 <= num_frames; i += 8) {
+			__m256 const l = _mm256_loadu_ps(left + i);
+			__m256 const r = _mm256_loadu_ps(right + i);
+			__m256 const lo = _mm256_unpacklo_ps(l, r);	// L0 R0 L1 R1 | L4 R4 L5 R5
+			__m256 const hi = _mm256_unpackhi_ps(l, r);	// L2 R2 L3 R3 | L6 R6 L7 R7
+			_mm256_storeu_ps(dest + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(dest + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+#endif
+
+#if defined(HWM_SIMD_SSE2)
+		for( ; i + 4 <= num_frames; i += 4) {
+			__m128 const l = _mm_loadu_ps(left + i);
+			__m128 const r = _mm_loadu_ps(right + i);
+			_mm_storeu_ps(dest + i * 2, _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(dest + i * 2 + 4, _mm_unpackhi_ps(l, r));
+		}
+#elif defined(HWM_SIMD_NEON)
+		for( ; i + 4 <= num_frames; i += 4) {
+			float32x4x2_t v;
+			v.val[0] = vld1q_f32(left + i);
+			v.val[1] = vld1q_f32(right + i);
+			vst2q_f32(dest + i * 2, v);
+		}
+#endif
+
+		InterleaveGeneric(src, 2, dest, i, num_frames);
+	}
+
+	void Deinterleave2(float const *src, float * const * dest, size_t num_frames)
+	{
+		float *left = dest[0];
+		float *right = dest[1];
+		size_t i = 0;
+
+#if defined(HWM_SIMD_AVX)
+		for( ; i + 8 <= num_frames; i += 8) {
+			__m256 const a = _mm256_loadu_ps(src + i * 2);		// L0 R0 L1 R1 L2 R2 L3 R3
+			__m256 const b = _mm256_loadu_ps(src + i * 2 + 8);	// L4 R4 L5 R5 L6 R6 L7 R7
+			__m256 const t0 = _mm256_permute2f128_ps(a, b, 0x20);	// L0 R0 L1 R1 | L4 R4 L5 R5
+			__m256 const t1 = _mm256_permute2f128_ps(a, b, 0x31);	// L2 R2 L3 R3 | L6 R6 L7 R7
+			_mm256_storeu_ps(left + i, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm256_storeu_ps(right + i, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+#endif
+
+#if defined(HWM_SIMD_SSE2)
+		for( ; i + 4 <= num_frames; i += 4) {
+			__m128 const a = _mm_loadu_ps(src + i * 2);
+			__m128 const b = _mm_loadu_ps(src + i * 2 + 4);
+			_mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+#elif defined(HWM_SIMD_NEON)
+		for( ; i + 4 <= num_frames; i += 4) {
+			float32x4x2_t const v = vld2q_f32(src + i * 2);
+			vst1q_f32(left + i, v.val[0]);
+			vst1q_f32(right + i, v.val[1]);
+		}
+#endif
+
+		DeinterleaveGeneric(src, 2, dest, i, num_frames);
+	}
+
+	void Interleave4(float const * const * src, float *dest, size_t num_frames)
+	{
+		size_t i = 0;
+
+#if defined(HWM_SIMD_SSE2)
+		for( ; i + 4 <= num_frames; i += 4) {
+			__m128 c0 = _mm_loadu_ps(src[0] + i);
+			__m128 c1 = _mm_loadu_ps(src[1] + i);
+			__m128 c2 = _mm_loadu_ps(src[2] + i);
+			__m128 c3 = _mm_loadu_ps(src[3] + i);
+			_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+			_mm_storeu_ps(dest + i * 4, c0);
+			_mm_storeu_ps(dest + i * 4 + 4, c1);
+			_mm_storeu_ps(dest + i * 4 + 8, c2);
+			_mm_storeu_ps(dest + i * 4 + 12, c3);
+		}
+#elif defined(HWM_SIMD_NEON)
+		for( ; i + 4 <= num_frames; i += 4) {
+			float32x4x4_t v;
+			v.val[0] = vld1q_f32(src[0] + i);
+			v.val[1] = vld1q_f32(src[1] + i);
+			v.val[2] = vld1q_f32(src[2] + i);
+			v.val[3] = vld1q_f32(src[3] + i);
+			vst4q_f32(dest + i * 4, v);
+		}
+#endif
+
+		InterleaveGeneric(src, 4, dest, i, num_frames);
+	}
+
+	void Deinterleave4(float const *src, float * const * dest, size_t num_frames)
+	{
+		size_t i = 0;
+
+#if defined(HWM_SIMD_SSE2)
+		for( ; i + 4 <= num_frames; i += 4) {
+			__m128 f0 = _mm_loadu_ps(src + i * 4);
+			__m128 f1 = _mm_loadu_ps(src + i * 4 + 4);
+			__m128 f2 = _mm_loadu_ps(src + i * 4 + 8);
+			__m128 f3 = _mm_loadu_ps(src + i * 4 + 12);
+			_MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+			_mm_storeu_ps(dest[0] + i, f0);
+			_mm_storeu_ps(dest[1] + i, f1);
+			_mm_storeu_ps(dest[2] + i, f2);
+			_mm_storeu_ps(dest[3] + i, f3);
+		}
+#elif defined(HWM_SIMD_NEON)
+		for( ; i + 4 <= num_frames; i += 4) {
+			float32x4x4_t const v = vld4q_f32(src + i * 4);
+			vst1q_f32(dest[0] + i, v.val[0]);
+			vst1q_f32(dest[1] + i, v.val[1]);
+			vst1q_f32(dest[2] + i, v.val[2]);
+			vst1q_f32(dest[3] + i, v.val[3]);
+		}
+#endif
+
+		DeinterleaveGeneric(src, 4, dest, i, num_frames);
+	}
+
+}	// unnamed
+
+size_t GetBytesPerSample(SampleFormat format)
+{
+	switch(format) {
+		case SampleFormat::kFloat32:	return 4;
+		case SampleFormat::kInt16:		return 2;
+		case SampleFormat::kInt24:		return 3;
+		case SampleFormat::kInt32:		return 4;
+	}
+	assert(false);
+	return 0;
+}
+
+char const * GetSampleConvertArchName()
+{
+#if defined(HWM_SIMD_AVX)
+	return "AVX";
+#elif defined(HWM_SIMD_SSE2)
+	return "SSE2";
+#elif defined(HWM_SIMD_NEON)
+	return "NEON";
+#else
+	return "Scalar";
+#endif
+}
+
+void Interleave(float const * const * src, size_t num_channels, float *dest, size_t num_frames)
+{
+	switch(num_channels) {
+		case 0:
+			break;
+		case 1:
+			std::memcpy(dest, src[0], num_frames * sizeof(float));
+			break;
+		case 2:
+			Interleave2(src, dest, num_frames);
+			break;
+		case 4:
+			Interleave4(src, dest, num_frames);
+			break;
+		default:
+			InterleaveGeneric(src, num_channels, dest, 0, num_frames);
+			break;
+	}
+}
+
+void Deinterleave(float const *src, size_t num_channels, float * const * dest, size_t num_frames)
+{
+	switch(num_channels) {
+		case 0:
+			break;
+		case 1:
+			std::memcpy(dest[0], src, num_frames * sizeof(float));
+			break;
+		case 2:
+			Deinterleave2(src, dest, num_frames);
+			break;
+		case 4:
+			Deinterleave4(src, dest, num_frames);
+			break;
+		default:
+			DeinterleaveGeneric(src, num_channels, dest, 0, num_frames);
+			break;
+	}
+}
+
+void ConvertFloatToInt16(float const *src, std::int16_t *dest, size_t num_samples, TpdfDither *dither)
+{
+	size_t i = 0;
+
+	if(!dither) {
+#if defined(HWM_SIMD_SSE2)
+		__m128 const vscale = _mm_set1_ps(kInt16Scale);
+		//! _mm_packs_epi32で16bitに飽和させるが、_mm_cvtps_epi32がオーバーフローしないように大まかにクリップしておく
+		__m128 const vmin = _mm_set1_ps(-65536.0f);
+		__m128 const vmax = _mm_set1_ps(65536.0f);
+		for( ; i + 8 <= num_samples; i += 8) {
+			__m128 const a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), vscale), vmin), vmax);
+			__m128 const b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), vscale), vmin), vmax);
+			__m128i const lo = _mm_cvtps_epi32(a);
+			__m128i const hi = _mm_cvtps_epi32(b);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dest + i), _mm_packs_epi32(lo, hi));
+		}
+#elif defined(HWM_SIMD_NEON)
+		float32x4_t const vscale = vdupq_n_f32(kInt16Scale);
+		for( ; i + 8 <= num_samples; i += 8) {
+			int32x4_t const lo = vcvtq_s32_f32(vrndnq_f32(vmulq_f32(vld1q_f32(src + i), vscale)));
+			int32x4_t const hi = vcvtq_s32_f32(vrndnq_f32(vmulq_f32(vld1q_f32(src + i + 4), vscale)));
+			vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+		}
+#endif
+	}
+
+	for( ; i < num_samples; ++i) {
+		dest[i] = static_cast<std::int16_t>(QuantizeScalar(src[i], kInt16Scale, kInt16Max, dither));
+	}
+}
+
+void ConvertFloatToInt24(float const *src, std::uint8_t *dest, size_t num_samples, TpdfDither *dither)
+{
+	std::int32_t tmp[256];
+
+	for(size_t i = 0; i < num_samples; i += 256) {
+		size_t const n = std::min<size_t>(256, num_samples - i);
+		QuantizeToInt32(src + i, tmp, n, kInt24Scale, kInt24Max, dither);
+
+		std::uint8_t *out = dest + i * 3;
+		for(size_t j = 0; j < n; ++j) {
+			std::uint32_t const v = static_cast<std::uint32_t>(tmp[j]);
+			out[j * 3 + 0] = static_cast<std::uint8_t>(v);
+			out[j * 3 + 1] = static_cast<std::uint8_t>(v >> 8);
+			out[j * 3 + 2] = static_cast<std::uint8_t>(v >> 16);
+		}
+	}
+}
+
+void ConvertFloatToInt32(float const *src, std::int32_t *dest, size_t num_samples, TpdfDither *dither)
+{
+	QuantizeToInt32(src, dest, num_samples, kInt32Scale, kInt32Max, dither);
+}
+
+void ConvertInt16ToFloat(std::int16_t const *src, float *dest, size_t num_samples)
+{
+	size_t i = 0;
+	float const scale = 1.0f / kInt16Scale;
+
+#if defined(HWM_SIMD_SSE2)
+	__m128 const vscale = _mm_set1_ps(scale);
+	for( ; i + 8 <= num_samples; i += 8) {
+		__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+		//! 上位16bitに入れてから算術シフトすることで符号拡張する
+		__m128i const lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i const hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+		_mm_storeu_ps(dest + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+	}
+#elif defined(HWM_SIMD_NEON)
+	float32x4_t const vscale = vdupq_n_f32(scale);
+	for( ; i + 8 <= num_samples; i += 8) {
+		int16x8_t const v = vld1q_s16(src + i);
+		vst1q_f32(dest + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), vscale));
+		vst1q_f32(dest + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), vscale));
+	}
+#endif
+
+	for( ; i < num_samples; ++i) {
+		dest[i] = src[i] * scale;
+	}
+}
+
+void ConvertInt24ToFloat(std::uint8_t const *src, float *dest, size_t num_samples)
+{
+	std::int32_t tmp[256];
+
+	for(size_t i = 0; i < num_samples; i += 256) {
+		size_t const n = std::min<size_t>(256, num_samples - i);
+
+		std::uint8_t const *in = src + i * 3;
+		for(size_t j = 0; j < n; ++j) {
+			std::uint32_t const v =
+				(static_cast<std::uint32_t>(in[j * 3 + 0]) << 8) |
+				(static_cast<std::uint32_t>(in[j * 3 + 1]) << 16) |
+				(static_cast<std::uint32_t>(in[j * 3 + 2]) << 24);
+			//! 上位24bitに詰めてから算術シフトすることで符号拡張する
+			tmp[j] = static_cast<std::int32_t>(v) >> 8;
+		}
+
+		ScaleToFloat(tmp, dest + i, n, 1.0f / kInt24Scale);
+	}
+}
+
+void ConvertInt32ToFloat(std::int32_t const *src, float *dest, size_t num_samples)
+{
+	ScaleToFloat(src, dest, num_samples, 1.0f / kInt32Scale);
+}
+
+namespace {
+
+	void ConvertChunkFromFloat(float const *src, void *dest, SampleFormat format, size_t num_samples,
+							   TpdfDither *dither)
+	{
+		switch(format) {
+			case SampleFormat::kInt16:
+				ConvertFloatToInt16(src, static_cast<std::int16_t *>(dest), num_samples, dither);
+				break;
+			case SampleFormat::kInt24:
+				ConvertFloatToInt24(src, static_cast<std::uint8_t *>(dest), num_samples, dither);
+				break;
+			case SampleFormat::kInt32:
+				ConvertFloatToInt32(src, static_cast<std::int32_t *>(dest), num_samples, dither);
+				break;
+			default:
+				assert(false);
+				break;
+		}
+	}
+
+	void ConvertChunkToFloat(void const *src, SampleFormat format, float *dest, size_t num_samples)
+	{
+		switch(format) {
+			case SampleFormat::kInt16:
+				ConvertInt16ToFloat(static_cast<std::int16_t const *>(src), dest, num_samples);
+				break;
+			case SampleFormat::kInt24:
+				ConvertInt24ToFloat(static_cast<std::uint8_t const *>(src), dest, num_samples);
+				break;
+			case SampleFormat::kInt32:
+				ConvertInt32ToFloat(static_cast<std::int32_t const *>(src), dest, num_samples);
+				break;
+			default:
+				assert(false);
+				break;
+		}
+	}
+
+	//! kMaxChunkChannelsより多いチャンネルを、1フレームずつkChunkSamplesチャンネルごとに変換する
+	void WriteInterleavedPerFrame(float const * const * src, size_t num_channels,
+								  void *dest, SampleFormat format, size_t num_frames,
+								  TpdfDither *dither)
+	{
+		float interleaved[kChunkSamples];
+		std::uint8_t *out = static_cast<std::uint8_t *>(dest);
+		size_t const bytes_per_sample = GetBytesPerSample(format);
+
+		for(size_t i = 0; i < num_frames; ++i) {
+			for(size_t ch = 0; ch < num_channels; ch += kChunkSamples) {
+				size_t const n = std::min(kChunkSamples, num_channels - ch);
+				for(size_t k = 0; k < n; ++k) {
+					interleaved[k] = src[ch + k][i];
+				}
+				ConvertChunkFromFloat(interleaved, out + (i * num_channels + ch) * bytes_per_sample,
+									  format, n, dither);
+			}
+		}
+	}
+
+	void ReadInterleavedPerFrame(void const *src, SampleFormat format, size_t num_channels,
+								 float * const * dest, size_t num_frames)
+	{
+		float interleaved[kChunkSamples];
+		std::uint8_t const *in = static_cast<std::uint8_t const *>(src);
+		size_t const bytes_per_sample = GetBytesPerSample(format);
+
+		for(size_t i = 0; i < num_frames; ++i) {
+			for(size_t ch = 0; ch < num_channels; ch += kChunkSamples) {
+				size_t const n = std::min(kChunkSamples, num_channels - ch);
+				ConvertChunkToFloat(in + (i * num_channels + ch) * bytes_per_sample, format, interleaved, n);
+				for(size_t k = 0; k < n; ++k) {
+					dest[ch + k][i] = interleaved[k];
+				}
+			}
+		}
+	}
+
+}	// unnamed
+
+void WriteInterleaved(float const * const * src, size_t num_channels,
+					  void *dest, SampleFormat format, size_t num_frames,
+					  TpdfDither *dither)
+{
+	if(num_channels == 0) {
+		return;
+	}
+
+	if(format == SampleFormat::kFloat32) {
+		Interleave(src, num_channels, static_cast<float *>(dest), num_frames);
+		return;
+	}
+
+	if(num_channels > kMaxChunkChannels) {
+		WriteInterleavedPerFrame(src, num_channels, dest, format, num_frames, dither);
+		return;
+	}
+
+	float interleaved[kChunkSamples];
+	float const *heads[kMaxChunkChannels];
+
+	size_t const chunk_frames = kChunkSamples / num_channels;
+	std::uint8_t *out = static_cast<std::uint8_t *>(dest);
+	size_t const bytes_per_frame = GetBytesPerSample(format) * num_channels;
+
+	for(size_t i = 0; i < num_frames; i += chunk_frames) {
+		size_t const n = std::min(chunk_frames, num_frames - i);
+		for(size_t ch = 0; ch < num_channels; ++ch) {
+			heads[ch] = src[ch] + i;
+		}
+		Interleave(heads, num_channels, interleaved, n);
+		ConvertChunkFromFloat(interleaved, out + i * bytes_per_frame, format, n * num_channels, dither);
+	}
+}
+
+void ReadInterleaved(void const *src, SampleFormat format, size_t num_channels,
+					 float * const * dest, size_t num_frames)
+{
+	if(num_channels == 0) {
+		return;
+	}
+
+	if(format == SampleFormat::kFloat32) {
+		Deinterleave(static_cast<float const *>(src), num_channels, dest, num_frames);
+		return;
+	}
+
+	if(num_channels > kMaxChunkChannels) {
+		ReadInterleavedPerFrame(src, format, num_channels, dest, num_frames);
+		return;
+	}
+
+	float interleaved[kChunkSamples];
+	float *heads[kMaxChunkChannels];
+
+	size_t const chunk_frames = kChunkSamples / num_channels;
+	std::uint8_t const *in = static_cast<std::uint8_t const *>(src);
+	size_t const bytes_per_frame = GetBytesPerSample(format) * num_channels;
+
+	for(size_t i = 0; i < num_frames; i += chunk_frames) {
+		size_t const n = std::min(chunk_frames, num_frames - i);
+		ConvertChunkToFloat(in + i * bytes_per_frame, format, interleaved, n * num_channels);
+		for(size_t ch = 0; ch < num_channels; ++ch) {
+			heads[ch] = dest[ch] + i;
+		}
+		Deinterleave(interleaved, num_channels, heads, n);
+	}
+}
+
+}	// ::hwm
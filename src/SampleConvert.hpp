@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hwm {
+
+//! オーディオデバイスやファイルとの入出力で使用するサンプルフォーマット
+/*!
+	整数フォーマットはリトルエンディアンで、kInt24は1サンプルあたり3バイトに詰めて格納する。
+*/
+enum class SampleFormat {
+	kFloat32,
+	kInt16,
+	kInt24,
+	kInt32,
+};
+
+size_t	GetBytesPerSample(SampleFormat format);
+
+//! 浮動小数点数から整数に変換する際に加えるTPDF(三角分布)ディザー
+/*!
+	オーディオスレッドから使用できるように、メモリ確保を行わない軽量な乱数生成器を使用する。
+*/
+struct TpdfDither
+{
+	explicit
+	TpdfDither(std::uint32_t seed = 0x12345678)
+		:	state_(seed ? seed : 1)
+	{}
+
+	//! 振幅が[-1, 1]LSBの三角分布のノイズを返す
+	float	Next()
+	{
+		return (NextUniform() - NextUniform());
+	}
+
+private:
+	//! [0, 1)の一様乱数(xorshift32)
+	float	NextUniform()
+	{
+		state_ ^= state_ << 13;
+		state_ ^= state_ >> 17;
+		state_ ^= state_ << 5;
+		return (state_ >> 8) * (1.0f / 16777216.0f);
+	}
+
+	std::uint32_t state_;
+};
+
+//! ビルド時に選択されたカーネルの実装名("AVX", "SSE2", "NEON", "Scalar")
+char const *
+		GetSampleConvertArchName();
+
+//! チャンネルごとのバッファ(src[ch][i])をインターリーブされたバッファ(dest[i * num_channels + ch])に変換する
+void	Interleave(float const * const * src, size_t num_channels, float *dest, size_t num_frames);
+
+//! インターリーブされたバッファをチャンネルごとのバッファに変換する
+void	Deinterleave(float const *src, size_t num_channels, float * const * dest, size_t num_frames);
+
+//! [-1, 1]の浮動小数点数を整数フォーマットに変換する。範囲外の値はクリップする。
+//! ditherがnullptrでなければ、量子化の前にTPDFディザーを加える。
+void	ConvertFloatToInt16(float const *src, std::int16_t *dest, size_t num_samples, TpdfDither *dither = nullptr);
+void	ConvertFloatToInt24(float const *src, std::uint8_t *dest, size_t num_samples, TpdfDither *dither = nullptr);
+void	ConvertFloatToInt32(float const *src, std::int32_t *dest, size_t num_samples, TpdfDither *dither = nullptr);
+
+//! 整数フォーマットを[-1, 1]の浮動小数点数に変換する
+void	ConvertInt16ToFloat(std::int16_t const *src, float *dest, size_t num_samples);
+void	ConvertInt24ToFloat(std::uint8_t const *src, float *dest, size_t num_samples);
+void	ConvertInt32ToFloat(std::int32_t const *src, float *dest, size_t num_samples);
+
+//! チャンネルごとのバッファを、formatのインターリーブされたバッファに変換する
+/*!
+	内部ではキャッシュに収まる大きさのブロックごとにインターリーブとフォーマット変換を行う。
+	メモリ確保は行わないので、オーディオスレッドから呼び出してもよい。
+*/
+void	WriteInterleaved(float const * const * src, size_t num_channels,
+						 void *dest, SampleFormat format, size_t num_frames,
+						 TpdfDither *dither = nullptr);
+
+//! formatのインターリーブされたバッファを、チャンネルごとのバッファに変換する
+void	ReadInterleaved(void const *src, SampleFormat format, size_t num_channels,
+						float * const * dest, size_t num_frames);
+
+//! 各カーネルのスループットを計測して、チャンネル数ごとのGB/sを標準出力に書き出す
+void	RunSampleConvertBenchmark();
+
+}	// ::hwm
@@ -0,0 +1,92 @@
+#include "./SampleConvert.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "./Buffer.hpp"
+
+namespace hwm {
+
+namespace {
+
+	//! fを繰り返し実行して、1秒あたりに処理したバイト数(GB/s)を返す。
+	//! bytes_per_callはfの1回の呼び出しで読み書きするバイト数。
+	double MeasureThroughput(std::function<void()> const &f, size_t bytes_per_call)
+	{
+		typedef std::chrono::steady_clock clock_type;
+		double const min_seconds = 0.2;
+
+		//! ウォームアップ
+		for(int i = 0; i < 16; ++i) { f(); }
+
+		size_t num_calls = 0;
+		auto const begin = clock_type::now();
+		double elapsed = 0;
+		do {
+			for(int i = 0; i < 64; ++i) { f(); }
+			num_calls += 64;
+			elapsed = std::chrono::duration<double>(clock_type::now() - begin).count();
+		} while(elapsed < min_seconds);
+
+		return (static_cast<double>(bytes_per_call) * num_calls) / elapsed / 1e9;
+	}
+
+}	// unnamed
+
+void RunSampleConvertBenchmark()
+{
+	size_t const num_frames = 4096;
+	size_t const channel_counts[] = { 1, 2, 4, 8 };
+
+	std::printf("SampleConvert benchmark (%s), %d frames per call\n",
+				GetSampleConvertArchName(), static_cast<int>(num_frames));
+	std::printf("%-28s %8s %10s\n", "kernel", "channels", "GB/s");
+
+	for(size_t const num_channels: channel_counts) {
+		Buffer<float> planar(num_channels, num_frames);
+		for(size_t ch = 0; ch < num_channels; ++ch) {
+			for(size_t i = 0; i < num_frames; ++i) {
+				planar.data()[ch][i] = static_cast<float>((i % 200) / 100.0 - 1.0);
+			}
+		}
+
+		size_t const num_samples = num_channels * num_frames;
+		std::vector<float> interleaved(num_samples);
+		std::vector<std::int16_t> int16(num_samples);
+		std::vector<std::uint8_t> int24(num_samples * 3);
+		std::vector<std::int32_t> int32(num_samples);
+		TpdfDither dither;
+
+		float const * const *src = planar.data();
+		float * const *dest = planar.data();
+
+		struct Kernel {
+			char const *name_;
+			std::function<void()> f_;
+			size_t bytes_;
+		};
+
+		Kernel const kernels[] = {
+			{ "Interleave", [&] { Interleave(src, num_channels, interleaved.data(), num_frames); }, num_samples * 8 },
+			{ "Deinterleave", [&] { Deinterleave(interleaved.data(), num_channels, dest, num_frames); }, num_samples * 8 },
+			{ "FloatToInt16", [&] { ConvertFloatToInt16(interleaved.data(), int16.data(), num_samples); }, num_samples * 6 },
+			{ "FloatToInt16 (dither)", [&] { ConvertFloatToInt16(interleaved.data(), int16.data(), num_samples, &dither); }, num_samples * 6 },
+			{ "FloatToInt24", [&] { ConvertFloatToInt24(interleaved.data(), int24.data(), num_samples); }, num_samples * 7 },
+			{ "FloatToInt32", [&] { ConvertFloatToInt32(interleaved.data(), int32.data(), num_samples); }, num_samples * 8 },
+			{ "Int16ToFloat", [&] { ConvertInt16ToFloat(int16.data(), interleaved.data(), num_samples); }, num_samples * 6 },
+			{ "Int24ToFloat", [&] { ConvertInt24ToFloat(int24.data(), interleaved.data(), num_samples); }, num_samples * 7 },
+			{ "Int32ToFloat", [&] { ConvertInt32ToFloat(int32.data(), interleaved.data(), num_samples); }, num_samples * 8 },
+			{ "WriteInterleaved (int16)", [&] { WriteInterleaved(src, num_channels, int16.data(), SampleFormat::kInt16, num_frames); }, num_samples * 6 },
+			{ "ReadInterleaved (int16)", [&] { ReadInterleaved(int16.data(), SampleFormat::kInt16, num_channels, dest, num_frames); }, num_samples * 6 },
+		};
+
+		for(auto const &kernel: kernels) {
+			double const gbps = MeasureThroughput(kernel.f_, kernel.bytes_);
+			std::printf("%-28s %8d %10.2f\n", kernel.name_, static_cast<int>(num_channels), gbps);
+		}
+	}
+}
+
+}	// ::hwm
@@ -0,0 +1,20 @@
+#pragma once
+
+//! ビルドの対象のCPUで使用できるSIMD命令セットを判定して、対応するヘッダーをインクルードする。
+//! 実行時のCPUの判定は行わないので、AVXのパスを使用するにはAVXを有効にして（CMakeのHWM_ENABLE_AVX）ビルドする必要がある。
+
+#if defined(__AVX__)
+#define HWM_SIMD_AVX 1
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HWM_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//! 丸め命令(vrndnq_f32)などを使用するため、NEONのパスはAArch64でのみ有効にする
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define HWM_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace hwm {
+
+//! 固定長の、シングルプロデューサー・シングルコンシューマー用ロックフリーキュー
+/*!
+	pushは1つのスレッドから、popは別の1つのスレッドからのみ呼び出せる。
+	どちらの操作もwait-freeで、メモリ確保を行わないため、リアルタイムスレッドから呼び出せる。
+	キューが一杯の時、pushは要素を追加せずにfalseを返す。
+*/
+template<class T>
+struct SpscQueue
+{
+	typedef T value_type;
+
+	//! @param capacity キューに保持できる要素数。内部では2のべき乗に切り上げられる。
+	explicit
+	SpscQueue(size_t capacity)
+		:	head_(0)
+		,	tail_(0)
+	{
+		assert(capacity > 0);
+		size_t n = 1;
+		while(n < capacity) { n <<= 1; }
+		buffer_.resize(n);
+		mask_ = n - 1;
+	}
+
+	SpscQueue(SpscQueue const &) = delete;
+	SpscQueue & operator=(SpscQueue const &) = delete;
+
+	size_t capacity() const { return buffer_.size(); }
+
+	//! プロデューサースレッドから呼び出す
+	bool push(value_type const &value)
+	{
+		size_t const tail = tail_.load(std::memory_order_relaxed);
+		if(tail - head_.load(std::memory_order_acquire) == buffer_.size()) {
+			return false;
+		}
+
+		buffer_[tail & mask_] = value;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! プロデューサースレッドから呼び出す。
+	//! キューが一杯で追加できなかった場合、valueはムーブされずにそのまま残る。
+	bool push(value_type &&value)
+	{
+		size_t const tail = tail_.load(std::memory_order_relaxed);
+		if(tail - head_.load(std::memory_order_acquire) == buffer_.size()) {
+			return false;
+		}
+
+		buffer_[tail & mask_] = std::move(value);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! プロデューサースレッドから呼び出す。
+	//! pushで要素を追加できる状態かどうか。
+	bool full() const
+	{
+		return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_acquire) == buffer_.size();
+	}
+
+	//! コンシューマースレッドから呼び出す
+	bool pop(value_type &value)
+	{
+		size_t const head = head_.load(std::memory_order_relaxed);
+		if(head == tail_.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		value = std::move(buffer_[head & mask_]);
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//! コンシューマースレッドから呼び出す。
+	//! 先頭の要素を取り出さずに参照する。キューが空の場合はnullptrを返す。
+	value_type const * front() const
+	{
+		size_t const head = head_.load(std::memory_order_relaxed);
+		if(head == tail_.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		return &buffer_[head & mask_];
+	}
+
+	//! 現在キューに入っている要素数のおおよその値
+	size_t size() const
+	{
+		return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+	}
+
+	bool empty() const { return size() == 0; }
+
+private:
+	std::vector<value_type> buffer_;
+	size_t mask_;
+	alignas(64) std::atomic<size_t> head_;
+	alignas(64) std::atomic<size_t> tail_;
+};
+
+}	// ::hwm
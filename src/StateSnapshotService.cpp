@@ -0,0 +1,321 @@
+#include "./StateSnapshotService.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "./LzCodec.hpp"
+
+namespace hwm {
+
+namespace {
+
+	std::uint64_t Rotl(std::uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	std::uint64_t Avalanche(std::uint64_t x)
+	{
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDULL;
+		x ^= x >> 33;
+		x *= 0xC4CEB9FE1A85EC53ULL;
+		x ^= x >> 33;
+		return x;
+	}
+
+	//! 8バイトずつ処理する128bitのハッシュ。状態データの同一性の判定に使用する。
+	void HashBytes(char const *data, size_t size, std::uint64_t (&hash)[2])
+	{
+		constexpr std::uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+		constexpr std::uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+		std::uint64_t h1 = 0x243F6A8885A308D3ULL ^ size;
+		std::uint64_t h2 = 0x13198A2E03707344ULL ^ (size * kPrime1);
+
+		auto mix = [&](std::uint64_t word) {
+			h1 = Rotl(h1 ^ (word * kPrime2), 31) * kPrime1;
+			h2 = Rotl(h2 + (word * kPrime1), 29) * kPrime2;
+		};
+
+		size_t i = 0;
+		for( ; i + 8 <= size; i += 8) {
+			std::uint64_t word;
+			std::memcpy(&word, data + i, sizeof(word));
+			mix(word);
+		}
+		if(i < size) {
+			std::uint64_t word = 0;
+			std::memcpy(&word, data + i, size - i);
+			mix(word);
+		}
+
+		hash[0] = Avalanche(h1 ^ Rotl(h2, 17));
+		hash[1] = Avalanche(h2 + hash[0]);
+	}
+
+	//! タスクをnum_tasks個投入して、すべて終わるまで呼び出したスレッドも処理に参加する
+	void RunParallel(ThreadPool &pool,
+					 ThreadPool::task_function_t function,
+					 void *context,
+					 size_t num_tasks,
+					 std::atomic<size_t> &num_finished)
+	{
+		num_finished.store(0, std::memory_order_release);
+		for(size_t i = 0; i < num_tasks; ++i) {
+			pool.Submit(ThreadPool::Task { function, context, i });
+		}
+
+		while(num_finished.load(std::memory_order_acquire) < num_tasks) {
+			if(!pool.RunOne()) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	//! blobs_の要素数がこれより少ない間は、期限切れのBlobを取り除かない
+	constexpr size_t kMinPruneSize = 64;
+
+}	// unnamed
+
+struct StateSnapshotService::RestoreBatch
+{
+	RestoreBatch()
+		:	num_finished_(0)
+		,	num_failed_(0)
+	{}
+
+	void RecordError(char const *message)
+	{
+		std::lock_guard<std::mutex> lock(error_mutex_);
+		if(num_failed_++ == 0) {
+			first_error_ = message;
+		}
+	}
+
+	//! Blobの組が同じスナップショットは、1つにまとめて展開する
+	std::vector<Snapshot const *>		snapshots_;
+	std::vector<Vst3Plugin::StateData>	states_;
+
+	std::vector<Vst3Plugin *>			plugins_;
+	//! プラグインごとの、states_のインデックス
+	std::vector<size_t>					state_indices_;
+
+	std::atomic<size_t>					num_finished_;
+	std::mutex							error_mutex_;
+	size_t								num_failed_;
+	std::string							first_error_;
+};
+
+StateSnapshotService::StateSnapshotService(size_t num_workers)
+	:	pool_(num_workers)
+	,	stop_(false)
+	,	next_prune_size_(kMinPruneSize)
+{
+	thread_ = std::thread([this] { ThreadProc(); });
+}
+
+StateSnapshotService::~StateSnapshotService()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+	thread_.join();
+}
+
+std::future<StateSnapshotService::Snapshot>
+		StateSnapshotService::Capture(Vst3Plugin &plugin)
+{
+	CaptureRequest request;
+	request.plugin_ = &plugin;
+	auto future = request.promise_.get_future();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		requests_.push_back(std::move(request));
+	}
+	cond_.notify_one();
+
+	return future;
+}
+
+void StateSnapshotService::Restore(std::vector<RestoreRequest> const &requests)
+{
+	RestoreBatch batch;
+	batch.plugins_.reserve(requests.size());
+	batch.state_indices_.reserve(requests.size());
+
+	std::map<std::pair<Blob const *, Blob const *>, size_t> unique_indices;
+	for(auto const &request: requests) {
+		auto const key = std::make_pair(request.snapshot_.component_.get(), request.snapshot_.controller_.get());
+		auto inserted = unique_indices.insert(std::make_pair(key, batch.snapshots_.size()));
+		if(inserted.second) {
+			batch.snapshots_.push_back(&request.snapshot_);
+		}
+
+		batch.plugins_.push_back(request.plugin_);
+		batch.state_indices_.push_back(inserted.first->second);
+	}
+	batch.states_.resize(batch.snapshots_.size());
+
+	RunParallel(pool_, &StateSnapshotService::DecompressTask, &batch, batch.snapshots_.size(), batch.num_finished_);
+	RunParallel(pool_, &StateSnapshotService::RestoreTask, &batch, batch.plugins_.size(), batch.num_finished_);
+
+	if(batch.num_failed_ > 0) {
+		throw std::runtime_error("failed to restore " + std::to_string(batch.num_failed_) +
+								 " plugin state(s) : " + batch.first_error_);
+	}
+}
+
+void StateSnapshotService::DecompressTask(void *context, size_t index)
+{
+	auto &batch = *static_cast<RestoreBatch *>(context);
+	try {
+		batch.states_[index] = Decompress(*batch.snapshots_[index]);
+	} catch(std::exception &e) {
+		batch.RecordError(e.what());
+	}
+	batch.num_finished_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+void StateSnapshotService::RestoreTask(void *context, size_t index)
+{
+	auto &batch = *static_cast<RestoreBatch *>(context);
+	auto const &state = batch.states_[batch.state_indices_[index]];
+	try {
+		//! 展開に失敗したスナップショットは、空の状態として扱って復元しない
+		if(!state.component_.empty() || !state.controller_.empty()) {
+			batch.plugins_[index]->SetState(state);
+		}
+	} catch(std::exception &e) {
+		batch.RecordError(e.what());
+	}
+	batch.num_finished_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+Vst3Plugin::StateData
+		StateSnapshotService::Decompress(Snapshot const &snapshot)
+{
+	auto expand = [](Blob const *blob, std::vector<char> &dest) {
+		if(!blob) {
+			return;
+		}
+		if(!LzCodec::Decompress(blob->compressed_.data(), blob->compressed_.size(), blob->original_size_, dest)) {
+			throw std::runtime_error("state snapshot is corrupted");
+		}
+	};
+
+	Vst3Plugin::StateData state;
+	expand(snapshot.component_.get(), state.component_);
+	expand(snapshot.controller_.get(), state.controller_);
+	return state;
+}
+
+size_t StateSnapshotService::GetNumBlobs() const
+{
+	std::lock_guard<std::mutex> lock(blobs_mutex_);
+	return std::count_if(blobs_.begin(), blobs_.end(), [](auto const &entry) { return !entry.second.expired(); });
+}
+
+size_t StateSnapshotService::GetStoredBytes() const
+{
+	std::lock_guard<std::mutex> lock(blobs_mutex_);
+	size_t total = 0;
+	for(auto const &entry: blobs_) {
+		if(auto blob = entry.second.lock()) {
+			total += blob->compressed_.size();
+		}
+	}
+	return total;
+}
+
+void StateSnapshotService::ThreadProc()
+{
+	for( ; ; ) {
+		CaptureRequest request;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cond_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+			//! 終了時に残っている要求は破棄する。futureにはbroken_promiseが通知される。
+			if(stop_) {
+				break;
+			}
+			request = std::move(requests_.front());
+			requests_.pop_front();
+		}
+
+		try {
+			auto const state = request.plugin_->GetState();
+			Snapshot snapshot;
+			snapshot.component_ = Intern(state.component_);
+			snapshot.controller_ = Intern(state.controller_);
+			request.promise_.set_value(std::move(snapshot));
+		} catch(...) {
+			request.promise_.set_exception(std::current_exception());
+		}
+	}
+}
+
+std::shared_ptr<StateSnapshotService::Blob const>
+		StateSnapshotService::Intern(std::vector<char> const &data)
+{
+	if(data.empty()) {
+		return nullptr;
+	}
+
+	BlobKey key;
+	HashBytes(data.data(), data.size(), key.hash_);
+	key.size_ = data.size();
+
+	//! ハッシュ値が衝突していても別のBlobとして扱えるように、一致したBlobは展開して内容を比較する。
+	//! Internはサービスのスレッドからしか呼ばれないので、比較の間にBlobが登録されることはない。
+	std::vector<std::shared_ptr<Blob const>> candidates;
+	{
+		std::lock_guard<std::mutex> lock(blobs_mutex_);
+		auto range = blobs_.equal_range(key);
+		for(auto it = range.first; it != range.second; ++it) {
+			if(auto blob = it->second.lock()) {
+				candidates.push_back(std::move(blob));
+			}
+		}
+	}
+
+	std::vector<char> expanded;
+	for(auto &candidate: candidates) {
+		if(LzCodec::Decompress(candidate->compressed_.data(), candidate->compressed_.size(),
+							   candidate->original_size_, expanded) &&
+		   expanded == data)
+		{
+			return candidate;
+		}
+	}
+
+	//! 圧縮はロックの外で行う
+	auto blob = std::make_shared<Blob>();
+	blob->hash_[0] = key.hash_[0];
+	blob->hash_[1] = key.hash_[1];
+	blob->original_size_ = data.size();
+	LzCodec::Compress(data.data(), data.size(), blob->compressed_);
+	blob->compressed_.shrink_to_fit();
+
+	std::lock_guard<std::mutex> lock(blobs_mutex_);
+	blobs_.emplace(key, blob);
+
+	if(blobs_.size() >= next_prune_size_) {
+		for(auto it = blobs_.begin(); it != blobs_.end(); ) {
+			it = it->second.expired() ? blobs_.erase(it) : std::next(it);
+		}
+		next_prune_size_ = std::max(kMinPruneSize, blobs_.size() * 2);
+	}
+
+	return blob;
+}
+
+}	// ::hwm
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "./ThreadPool.hpp"
+#include "./Vst3Plugin.hpp"
+
+namespace hwm {
+
+//! プラグインの状態のスナップショットを取得して、重複を除いて圧縮した状態で保持するサービス
+/*!
+	Captureで要求したプラグインの状態は、サービスのスレッドでGetStateによって取得され、
+	ハッシュ値を求めてからLzCodecで圧縮される。
+	内容が同じ状態データ(Blob)は、インスタンスやスナップショットをまたいで1つだけ保持され、共有される。
+	既に同じ内容のBlobがあれば、圧縮は行われない。
+	同じ内容かどうかは、ハッシュ値とサイズが一致したBlobを展開して、バイト列を比較して判定する。
+
+	Restoreでは、複数のプラグインへの復元をまとめて、ThreadPoolで並列に展開と復元を行う。
+	同じスナップショットを復元するプラグインが複数あっても、展開は一度しか行われない。
+	ThreadPoolはこのサービス専用のものを持つ。ProcessGraphと共有すると、オーディオスレッドが
+	RunOneで復元のタスクを盗んで、setStateやメモリ確保をリアルタイムスレッドで実行してしまうため。
+
+	バックグラウンドスレッドや、ThreadPoolのワーカーからプラグインの状態を取得/復元するので、
+	UIスレッド以外からのgetState/setStateに対応していないプラグインには使用できない。
+*/
+class StateSnapshotService
+{
+public:
+	//! 圧縮された状態データ。内容が同じものは共有される。
+	struct Blob
+	{
+		//! 圧縮前のデータの128bitのハッシュ値
+		std::uint64_t		hash_[2];
+		size_t				original_size_;
+		std::vector<char>	compressed_;
+	};
+
+	//! プラグインの状態のスナップショット。
+	//! 状態が空の場合は、対応するBlobはnullptrになる。
+	struct Snapshot
+	{
+		std::shared_ptr<Blob const>	component_;
+		std::shared_ptr<Blob const>	controller_;
+	};
+
+	struct RestoreRequest
+	{
+		Vst3Plugin *	plugin_;
+		Snapshot		snapshot_;
+	};
+
+	//! @param num_workers Restoreで展開と復元を並列に行うワーカースレッドの数。0の場合はハードウェアスレッド数 - 1
+	explicit
+	StateSnapshotService(size_t num_workers = 0);
+	~StateSnapshotService();
+
+	StateSnapshotService(StateSnapshotService const &) = delete;
+	StateSnapshotService & operator=(StateSnapshotService const &) = delete;
+
+	//! pluginの状態のスナップショットの取得を要求する
+	/*!
+		状態の取得、ハッシュ値の計算、圧縮はサービスのスレッドで行われる。
+		返されたfutureが完了するまで、pluginを破棄したり、SetStateを呼び出したりしてはならない。
+	*/
+	std::future<Snapshot>
+			Capture(Vst3Plugin &plugin);
+
+	//! 複数のプラグインの状態を、並列に復元する
+	/*!
+		この関数は、すべての復元が終わるまで戻らない。呼び出したスレッドも展開と復元に参加する。
+		同じプラグインを複数のrequestsに含めてはならない。
+		@throw std::runtime_error 復元に失敗したプラグインがあった場合。
+		その場合も、他のプラグインの復元は行われる。
+	*/
+	void	Restore(std::vector<RestoreRequest> const &requests);
+
+	//! スナップショットを展開して、Vst3Plugin::SetStateに渡せる形式にする
+	//! @throw std::runtime_error データが壊れている場合
+	static
+	Vst3Plugin::StateData
+			Decompress(Snapshot const &snapshot);
+
+	//! 現在いずれかのスナップショットから参照されているBlobの数
+	size_t	GetNumBlobs() const;
+
+	//! 現在いずれかのスナップショットから参照されているBlobの、圧縮後の合計サイズ
+	size_t	GetStoredBytes() const;
+
+private:
+	struct CaptureRequest
+	{
+		Vst3Plugin *			plugin_;
+		std::promise<Snapshot>	promise_;
+	};
+
+	struct BlobKey
+	{
+		std::uint64_t	hash_[2];
+		size_t			size_;
+
+		bool operator==(BlobKey const &rhs) const
+		{
+			return hash_[0] == rhs.hash_[0] && hash_[1] == rhs.hash_[1] && size_ == rhs.size_;
+		}
+	};
+
+	struct BlobKeyHash
+	{
+		size_t operator()(BlobKey const &key) const { return static_cast<size_t>(key.hash_[0]); }
+	};
+
+	struct RestoreBatch;
+
+	void	ThreadProc();
+
+	//! dataと同じ内容のBlobがあればそれを返し、なければ圧縮して登録する
+	std::shared_ptr<Blob const>
+			Intern(std::vector<char> const &data);
+
+	static void	DecompressTask(void *context, size_t index);
+	static void	RestoreTask(void *context, size_t index);
+
+	//! オーディオ処理には使用しない、このサービス専用のスレッドプール
+	ThreadPool					pool_;
+
+	std::mutex					mutex_;
+	std::condition_variable		cond_;
+	std::deque<CaptureRequest>	requests_;
+	bool						stop_;
+
+	//! 登録済みのBlob。どのスナップショットからも参照されなくなったものは、Intern時に取り除く。
+	//! ハッシュ値が衝突した内容の異なるBlobも保持できるように、multimapにする。
+	mutable std::mutex			blobs_mutex_;
+	std::unordered_multimap<BlobKey, std::weak_ptr<Blob const>, BlobKeyHash>
+								blobs_;
+	//! 次に期限切れのBlobを取り除く時の、blobs_の要素数
+	size_t						next_prune_size_;
+
+	std::thread					thread_;
+};
+
+}	// ::hwm
@@ -0,0 +1,120 @@
+#include "./TestWavetable.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace hwm {
+
+namespace {
+
+	double const kPi = 3.141592653589793;
+
+	//! 基本周波数がhead_freqからlast_freqまで直線的に変化する、num_harmonics次までの倍音を持つノコギリ波を生成する
+	/*!
+		sin(kθ)を倍音ごとに計算する代わりに、
+		sin(kθ) = 2cos(θ)sin((k-1)θ) - sin((k-2)θ) の漸化式で求めるので、
+		1サンプルあたりの三角関数の呼び出しはsinとcosの1回ずつで済む。
+	*/
+	void GenerateSawSweep(std::vector<float> &dest, size_t sampling_rate,
+						  double head_freq, double last_freq, size_t length, int num_harmonics)
+	{
+		double const amp = 2 / kPi * 0.125;
+		double const freq_angle = (last_freq - head_freq) / length;
+
+		dest.resize(length);
+
+		double current_freq = head_freq;
+		//! 位相(周期単位)
+		double pos = 0;
+		for(size_t i = 0; i < length; ++i) {
+			double const theta = 2 * kPi * pos;
+			double const two_cos = 2 * std::cos(theta);
+
+			double prev = 0;				//!< sin(0θ)
+			double current = std::sin(theta);	//!< sin(1θ)
+			double sum = current;
+			for(int k = 2; k <= num_harmonics; ++k) {
+				double const next = two_cos * current - prev;
+				prev = current;
+				current = next;
+				sum += current / k;
+			}
+			dest[i] = static_cast<float>(sum * amp);
+
+			pos += current_freq / sampling_rate;
+			pos -= std::floor(pos);
+			current_freq += freq_angle;
+		}
+	}
+
+	void GenerateSine(std::vector<float> &dest, size_t sampling_rate, double freq, double amp)
+	{
+		//! 1秒分を1周期として扱うので、周波数は整数に丸める
+		size_t const length = sampling_rate;
+		double const cycles = std::max(1.0, std::round(freq));
+
+		//! 回転行列を掛ける漸化式で生成し、誤差が貯まらないように一定間隔で位相を計算し直す
+		size_t const kResyncInterval = 1024;
+		double const delta = 2 * kPi * cycles / length;
+		double const cos_delta = std::cos(delta);
+		double const sin_delta = std::sin(delta);
+
+		dest.resize(length);
+		double c = 1;
+		double s = 0;
+		for(size_t i = 0; i < length; ++i) {
+			if(i % kResyncInterval == 0) {
+				double const theta = delta * i;
+				c = std::cos(theta);
+				s = std::sin(theta);
+			}
+			dest[i] = static_cast<float>(s * amp);
+
+			double const next_c = c * cos_delta - s * sin_delta;
+			s = s * cos_delta + c * sin_delta;
+			c = next_c;
+		}
+	}
+
+}	// unnamed
+
+std::shared_ptr<TestWavetable const> TestWavetable::Get(TestWaveform waveform, size_t sampling_rate)
+{
+	static std::mutex mutex;
+	static std::map<std::pair<TestWaveform, size_t>, std::shared_ptr<TestWavetable const>> tables;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto &table = tables[std::make_pair(waveform, sampling_rate)];
+	if(!table) {
+		table = std::make_shared<TestWavetable const>(waveform, sampling_rate);
+	}
+	return table;
+}
+
+TestWavetable::TestWavetable(TestWaveform waveform, size_t sampling_rate)
+	:	waveform_(waveform)
+	,	sampling_rate_(sampling_rate)
+{
+	assert(sampling_rate > 0);
+
+	switch(waveform) {
+	case TestWaveform::kSawSweep: {
+		double const head_freq = 440;
+		double const last_freq = 220;
+		//! 最も高い倍音がナイキスト周波数を超えないように、倍音の数を制限する
+		int const num_harmonics =
+			std::max(1, std::min(30, static_cast<int>((sampling_rate / 2.0) / head_freq)));
+		GenerateSawSweep(samples_, sampling_rate, head_freq, last_freq, sampling_rate * 2, num_harmonics);
+		break;
+	}
+	case TestWaveform::kSine:
+		GenerateSine(samples_, sampling_rate, 440, 0.125);
+		break;
+	}
+}
+
+}	// ::hwm
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace hwm {
+
+//! テスト用の信号の波形
+enum class TestWaveform {
+	//! 30次までの倍音を持つノコギリ波。2秒かけて440Hzから220Hzまで下降する
+	kSawSweep,
+	//! 440Hzのサイン波
+	kSine,
+};
+
+//! プラグインの入力バスなどに流すテスト用の信号を1周期分保持するウェーブテーブル
+/*!
+	Get()で取得したテーブルは、波形とサンプリングレートの組ごとにプロセス全体で共有される。
+	テーブルは最初に要求された時点で一度だけ生成され、以降はプロセスの終了まで保持される。
+	テーブルの内容は変更されないので、複数のスレッドから同時に読み出してよい。
+*/
+class TestWavetable
+{
+public:
+	//! waveformとsampling_rateに対応するテーブルを取得する。
+	//! まだ生成されていなければ生成するので、オーディオスレッドからは呼び出さないこと。
+	static
+	std::shared_ptr<TestWavetable const>
+			Get(TestWaveform waveform, size_t sampling_rate);
+
+	TestWavetable(TestWaveform waveform, size_t sampling_rate);
+
+	TestWaveform	GetWaveform() const { return waveform_; }
+	size_t			GetSamplingRate() const { return sampling_rate_; }
+
+	float const *	data() const { return samples_.data(); }
+	size_t			size() const { return samples_.size(); }
+
+	//! テーブルのposの位置から、num_samplesサンプルをdestに書き出す。
+	//! テーブルの末尾に達したら先頭に戻る。
+	//! @return 書き出した後のテーブルの位置
+	template<class SampleType>
+	size_t	Read(size_t pos, SampleType *dest, size_t num_samples) const
+	{
+		while(num_samples > 0) {
+			size_t const n = std::min(num_samples, samples_.size() - pos);
+			std::copy_n(samples_.data() + pos, n, dest);
+			dest += n;
+			num_samples -= n;
+			pos += n;
+			if(pos == samples_.size()) { pos = 0; }
+		}
+		return pos;
+	}
+
+private:
+	TestWaveform		waveform_;
+	size_t				sampling_rate_;
+	std::vector<float>	samples_;
+};
+
+}	// ::hwm
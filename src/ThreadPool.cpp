@@ -0,0 +1,314 @@
+#include "./ThreadPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <stdexcept>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+namespace hwm {
+
+namespace {
+	//! 現在のスレッドがこのプールのワーカーであれば、そのインデックス
+	thread_local ThreadPool const *	g_current_pool = nullptr;
+	thread_local size_t				g_current_worker_index = 0;
+}
+
+//! 固定長のリングバッファによる、ロックフリーなMPMCキュー。
+/*!
+	各要素にシーケンス番号を持たせて、pushとpopはそれぞれの位置をCASで確保する。
+	所有者のワーカーも、タスクを盗む他のスレッドも、同じpopで先頭から取り出す。
+	どちらの操作もロックを取得せず、メモリ確保も行わない。
+*/
+struct ThreadPool::WorkQueue
+{
+	explicit
+	WorkQueue(size_t capacity)
+		:	enqueue_pos_(0)
+		,	dequeue_pos_(0)
+	{
+		size_t n = 1;
+		while(n < capacity) { n <<= 1; }
+		cells_.reset(new Cell[n]);
+		for(size_t i = 0; i < n; ++i) {
+			cells_[i].sequence_.store(i, std::memory_order_relaxed);
+		}
+		mask_ = n - 1;
+	}
+
+	bool push(Task const &task)
+	{
+		size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		for( ; ; ) {
+			Cell &cell = cells_[pos & mask_];
+			size_t const sequence = cell.sequence_.load(std::memory_order_acquire);
+			auto const diff = static_cast<std::ptrdiff_t>(sequence - pos);
+			if(diff == 0) {
+				if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					cell.task_ = task;
+					cell.sequence_.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			} else if(diff < 0) {
+				return false;
+			} else {
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(Task &task)
+	{
+		size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+		for( ; ; ) {
+			Cell &cell = cells_[pos & mask_];
+			size_t const sequence = cell.sequence_.load(std::memory_order_acquire);
+			auto const diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+			if(diff == 0) {
+				if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					task = cell.task_;
+					cell.sequence_.store(pos + mask_ + 1, std::memory_order_release);
+					return true;
+				}
+			} else if(diff < 0) {
+				//! 空か、位置を確保したプロデューサーがまだ書き込みを終えていない
+				return false;
+			} else {
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t>	sequence_;
+		Task				task_;
+	};
+
+	std::unique_ptr<Cell[]>	cells_;
+	size_t					mask_;
+	alignas(64) std::atomic<size_t>	enqueue_pos_;
+	alignas(64) std::atomic<size_t>	dequeue_pos_;
+};
+
+//! スリープしているワーカーを起こすためのセマフォ。
+//! postはブロックしないので、オーディオスレッドから呼び出してもよい。
+struct ThreadPool::Semaphore
+{
+#if defined(__APPLE__)
+	Semaphore()
+		:	semaphore_(dispatch_semaphore_create(0))
+	{
+		if(!semaphore_) {
+			throw std::runtime_error("failed to create a semaphore");
+		}
+	}
+
+	~Semaphore() { dispatch_release(semaphore_); }
+
+	void Post() { dispatch_semaphore_signal(semaphore_); }
+	void Wait() { dispatch_semaphore_wait(semaphore_, DISPATCH_TIME_FOREVER); }
+
+private:
+	dispatch_semaphore_t semaphore_;
+#else
+	Semaphore()
+	{
+		if(sem_init(&semaphore_, 0, 0) != 0) {
+			throw std::runtime_error("failed to create a semaphore");
+		}
+	}
+
+	~Semaphore() { sem_destroy(&semaphore_); }
+
+	void Post() { sem_post(&semaphore_); }
+	void Wait()
+	{
+		while(sem_wait(&semaphore_) != 0 && errno == EINTR) {}
+	}
+
+private:
+	sem_t semaphore_;
+#endif
+};
+
+ThreadPool::ThreadPool(size_t num_workers, size_t queue_capacity)
+	:	next_queue_(0)
+	,	num_busy_sections_(0)
+	,	num_queued_tasks_(0)
+	,	is_terminating_(false)
+	,	num_sleepers_(0)
+	,	wake_pending_(false)
+	,	semaphore_(std::make_unique<Semaphore>())
+{
+	if(num_workers == 0) {
+		size_t const hw = std::thread::hardware_concurrency();
+		num_workers = std::max<size_t>(1, (hw > 1) ? hw - 1 : 1);
+	}
+
+	for(size_t i = 0; i < num_workers; ++i) {
+		queues_.push_back(std::make_unique<WorkQueue>(queue_capacity));
+	}
+
+	for(size_t i = 0; i < num_workers; ++i) {
+		workers_.emplace_back([this, i] { WorkerMain(i); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	is_terminating_.store(true);
+	for(size_t i = 0; i < workers_.size(); ++i) {
+		semaphore_->Post();
+	}
+
+	for(auto &worker: workers_) {
+		worker.join();
+	}
+}
+
+void ThreadPool::Submit(Task task)
+{
+	size_t index;
+	if(g_current_pool == this) {
+		index = g_current_worker_index;
+	} else {
+		index = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+	}
+
+	//! ワーカーがキューの数を見てスリープするかどうかを判断するので、積む前に増やしておく
+	num_queued_tasks_.fetch_add(1);
+	if(!queues_[index]->push(task)) {
+		num_queued_tasks_.fetch_sub(1);
+		task.function_(task.context_, task.arg_);
+		return;
+	}
+
+	Notify();
+}
+
+bool ThreadPool::RunOne()
+{
+	Task task;
+	bool found = false;
+	if(g_current_pool == this) {
+		found = TryPop(g_current_worker_index, task) || TrySteal(g_current_worker_index, task);
+	} else {
+		found = TrySteal(queues_.size(), task);
+	}
+
+	if(!found) {
+		return false;
+	}
+
+	task.function_(task.context_, task.arg_);
+	return true;
+}
+
+void ThreadPool::BeginBusySection()
+{
+	if(num_busy_sections_.fetch_add(1) == 0) {
+		//! スリープしているワーカーをすべて起こしてビジーウェイトさせる
+		int const num_sleepers = num_sleepers_.load();
+		for(int i = 0; i < num_sleepers; ++i) {
+			semaphore_->Post();
+		}
+	}
+}
+
+void ThreadPool::EndBusySection()
+{
+	num_busy_sections_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ThreadPool::Notify()
+{
+	//! ビジーウェイト中のワーカーは起こす必要がない
+	if(num_busy_sections_.load() > 0 || num_sleepers_.load() == 0) {
+		return;
+	}
+
+	//! 起こしたワーカーがまだ受け取っていなければ、重ねてpostしない。
+	//! 起きたワーカーは、タスクが残っていれば次のワーカーを起こす。
+	if(!wake_pending_.exchange(true)) {
+		semaphore_->Post();
+	}
+}
+
+void ThreadPool::Sleep()
+{
+	//! num_sleepers_を増やしてから条件を確認するので、SubmitがNotifyで
+	//! num_sleepers_を確認するのと、ここでnum_queued_tasks_を確認するのの少なくとも一方は相手の変更を観測する。
+	//! そのため、タスクがあるのにスリープし続けることはない。
+	num_sleepers_.fetch_add(1);
+	if(num_queued_tasks_.load() > 0 || num_busy_sections_.load() > 0 || is_terminating_.load()) {
+		num_sleepers_.fetch_sub(1);
+		return;
+	}
+
+	semaphore_->Wait();
+	num_sleepers_.fetch_sub(1);
+	wake_pending_.store(false);
+}
+
+bool ThreadPool::TryPop(size_t index, Task &task)
+{
+	if(queues_[index]->pop(task)) {
+		num_queued_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+		return true;
+	}
+	return false;
+}
+
+bool ThreadPool::TrySteal(size_t thief_index, Task &task)
+{
+	size_t const n = queues_.size();
+	for(size_t i = 1; i <= n; ++i) {
+		size_t const victim = (thief_index + i) % n;
+		if(victim == thief_index) {
+			continue;
+		}
+		if(queues_[victim]->pop(task)) {
+			num_queued_tasks_.fetch_sub(1, std::memory_order_acq_rel);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::WorkerMain(size_t index)
+{
+	g_current_pool = this;
+	g_current_worker_index = index;
+
+	for( ; ; ) {
+		Task task;
+		if(TryPop(index, task) || TrySteal(index, task)) {
+			//! まだタスクが残っていれば、スリープしている他のワーカーにも処理させる
+			if(num_queued_tasks_.load(std::memory_order_relaxed) > 0) {
+				Notify();
+			}
+			task.function_(task.context_, task.arg_);
+			continue;
+		}
+
+		if(is_terminating_.load() && num_queued_tasks_.load() == 0) {
+			break;
+		}
+
+		if(num_busy_sections_.load(std::memory_order_acquire) > 0) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		Sleep();
+	}
+}
+
+}	// ::hwm
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace hwm {
+
+//! ワークスティーリングを行うスレッドプール
+/*!
+	各ワーカースレッドは自分専用のタスクキューを持ち、自分のキューが空になると他のワーカーのキューからタスクを盗む。
+	タスクは関数ポインタと引数だけで表されるため、Submitでメモリ確保は発生しない。
+	そのため、オーディオスレッドからタスクを投入して、その完了を待つような用途に使用できる。
+
+	タスクキューは固定長のロックフリーなMPMCリングバッファで、Submit、RunOne、
+	BeginBusySection、EndBusySectionはロックを取得せず、ブロックしない。
+	スリープしているワーカーは、アトミックなフラグとセマフォのpostで起こす。
+
+	ワーカースレッド以外のスレッドからSubmitされたタスクは、ワーカーのキューにラウンドロビンで割り振られる。
+	ワーカースレッドからSubmitされたタスクは、そのワーカーのキューに積まれる。
+*/
+struct ThreadPool
+{
+	typedef void (*task_function_t)(void *context, size_t arg);
+
+	struct Task
+	{
+		task_function_t	function_;
+		void *			context_;
+		size_t			arg_;
+	};
+
+	//! @param num_workers ワーカースレッドの数。0の場合はハードウェアスレッド数 - 1
+	explicit
+	ThreadPool(size_t num_workers = 0, size_t queue_capacity = 1024);
+	~ThreadPool();
+
+	ThreadPool(ThreadPool const &) = delete;
+	ThreadPool & operator=(ThreadPool const &) = delete;
+
+	size_t	GetNumWorkers() const { return workers_.size(); }
+
+	//! タスクを投入する。キューが一杯の場合は、呼び出したスレッドでタスクを実行する。
+	//! どのスレッドから呼び出してもよい。
+	void	Submit(Task task);
+
+	//! 1つのタスクを取り出して、呼び出したスレッドで実行する。
+	//! 実行するタスクがなかった場合はfalseを返す。
+	//! タスクの完了を待つ間に、呼び出し側のスレッドも処理に参加させるために使用する。
+	bool	RunOne();
+
+	//! ワーカーをビジーウェイトさせる区間を開始/終了する。
+	//! この区間では、ワーカーはタスクがなくてもスリープせずに待機するので、
+	//! 短い間隔で連続してタスクが投入される場合のレイテンシが小さくなる。
+	void	BeginBusySection();
+	void	EndBusySection();
+
+private:
+	struct WorkQueue;
+	struct Semaphore;
+
+	void	WorkerMain(size_t index);
+	bool	TryPop(size_t index, Task &task);
+	bool	TrySteal(size_t thief_index, Task &task);
+	//! スリープしているワーカーを1つ起こす
+	void	Notify();
+	//! タスクもビジーウェイトの区間もなければ、通知されるまでスリープする
+	void	Sleep();
+
+	std::vector<std::unique_ptr<WorkQueue>>	queues_;
+	std::vector<std::thread>	workers_;
+	std::atomic<size_t>			next_queue_;
+	std::atomic<int>			num_busy_sections_;
+	//! キューに積まれているタスクの数。キューに積む前に増やし、取り出した後に減らす。
+	std::atomic<size_t>			num_queued_tasks_;
+	std::atomic<bool>			is_terminating_;
+	//! スリープしているか、スリープしようとしているワーカーの数
+	std::atomic<int>			num_sleepers_;
+	//! セマフォにpostしてから、起きたワーカーがまだ受け取っていない間はtrue。
+	//! 連続してSubmitされた場合に、何度もpostしないようにする。
+	std::atomic<bool>			wake_pending_;
+	std::unique_ptr<Semaphore>	semaphore_;
+};
+
+}	// ::hwm
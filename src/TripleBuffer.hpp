@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+
+namespace hwm {
+
+//! 1つのスレッドから書き込んだ値を、別の1つのスレッドからロックせずに読み出すためのトリプルバッファ
+/*!
+	書き込み側はGetWriteBuffer()で得たバッファを更新してからPublish()を呼ぶ。
+	読み込み側はUpdate()で最新の値を取り込んでから、GetReadBuffer()で読み出す。
+	どちらの操作も待機やメモリ確保を行わないので、オーディオスレッドから書き込んでもよい。
+	読み込み側が取り込む前に複数回Publish()された場合は、最後の値だけが読み出される。
+*/
+template<class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+		:	middle_(1)
+		,	back_(0)
+		,	front_(2)
+	{}
+
+	explicit
+	TripleBuffer(T const &initial_value)
+		:	TripleBuffer()
+	{
+		for(auto &buffer: buffers_) { buffer = initial_value; }
+	}
+
+	TripleBuffer(TripleBuffer const &) = delete;
+	TripleBuffer & operator=(TripleBuffer const &) = delete;
+
+	//! 書き込み側のバッファ。前回Publish()した内容が残っているとは限らない。
+	T &		GetWriteBuffer() { return buffers_[back_]; }
+
+	//! 書き込み側のバッファを公開する
+	void	Publish()
+	{
+		back_ = middle_.exchange(back_ | kDirty, std::memory_order_acq_rel) & kIndexMask;
+	}
+
+	//! 新しく公開された値があれば読み込み側のバッファに取り込んでtrueを返す
+	bool	Update()
+	{
+		if((middle_.load(std::memory_order_relaxed) & kDirty) == 0) {
+			return false;
+		}
+		front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+		return true;
+	}
+
+	T const &
+			GetReadBuffer() const { return buffers_[front_]; }
+
+private:
+	static int const kIndexMask = 0x3;
+	static int const kDirty = 0x4;
+
+	T					buffers_[3];
+	//! 書き込み側と読み込み側の間で受け渡すバッファのインデックスと、未読のフラグ
+	std::atomic<int>	middle_;
+	int					back_;
+	int					front_;
+};
+
+}	// ::hwm
@@ -81,7 +81,9 @@ protected:
 	tresult PLUGIN_API performEdit (Vst::ParamID id, Vst::ParamValue valueNormalized) override
 	{
 		hwm::dout << "Perform edit [" << id << "]\t[" << valueNormalized << "]" << std::endl;
-		parameter_change_notification_handler_(id, valueNormalized);
+		if(parameter_change_notification_handler_) {
+			parameter_change_notification_handler_(id, valueNormalized);
+		}
 		return kResultOk;
 	}
 
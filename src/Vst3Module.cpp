@@ -0,0 +1,266 @@
+#include "./Vst3Module.hpp"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include "./pluginterfaces/base/ftypes.h"
+#include "./Vst3Utils.hpp"
+#include "./ScopeExit.hpp"
+#include "./StrCnv.hpp"
+
+#include "debugger_output.hpp"
+using namespace Steinberg;
+
+namespace hwm {
+
+namespace {
+
+	typedef void (*setup_proc_t)();
+
+	//! ロード済みのモジュールのレジストリ
+	//! Vst3Moduleの寿命は各shared_ptrの所有者が管理するので、ここではweak_ptrで保持する。
+	/*!
+		モジュールのロードとアンロードには時間がかかるので、mutex_はその間保持しない。
+		代わりにパスごとの状態を持たせて、ロード中やアンロード中のモジュールに対するLoad()は
+		その処理が終わるまでcond_で待機する。
+	*/
+	struct ModuleRegistry
+	{
+		struct Entry
+		{
+			std::weak_ptr<Vst3Module> module_;
+			//! Vst3Moduleを構築中
+			bool loading_ = false;
+			//! Vst3Moduleが存在する。
+			//! module_が期限切れでもこれがtrueの場合は、Deleterによるアンロードが終わっていない。
+			bool alive_ = false;
+		};
+
+		std::mutex mutex_;
+		std::condition_variable cond_;
+		std::map<String, Entry> modules_;
+	};
+
+	ModuleRegistry & GetModuleRegistry()
+	{
+		static ModuleRegistry registry;
+		return registry;
+	}
+
+}	// unnamed
+
+String FormatCid(Steinberg::int8 const *cid_array)
+{
+	int const reg_str_len = 48; // including null-terminator
+	std::string reg_str(reg_str_len, '\0');
+    FUID fuid;
+    fuid.fromTUID(cid_array);
+    fuid.toRegistryString(&reg_str[0]);
+    return hwm::to_wstr(reg_str.c_str());
+}
+
+std::wstring
+		ClassInfoToString(ClassInfo const &info)
+{
+	std::wstringstream ss;
+	ss	<< info.name()
+		<< L", " << FormatCid(info.cid())
+		<< L", " << info.category()
+		<< L", " << info.cardinality();
+
+	if(info.is_classinfo2_enabled()) {
+		ss	<< L", " << info.classinfo2().sub_categories()
+			<< L", " << info.classinfo2().vendor()
+			<< L", " << info.classinfo2().version()
+			<< L", " << info.classinfo2().sdk_version()
+			;
+	}
+	return ss.str();
+}
+
+template<class Container>
+void OutputClassInfoList(Container const &cont)
+{
+	hwm::wdout << "--- Output Class Info ---" << std::endl;
+	int count = 0;
+	for(ClassInfo const &info: cont) {
+		hwm::wdout
+			<< L"[" << count++ << L"] " << ClassInfoToString(info) << std::endl;
+	}
+}
+
+std::wstring
+		FactoryInfoToString(FactoryInfo const &info)
+{
+	std::wstringstream ss;
+	ss	<< info.vendor()
+		<< L", " << info.url()
+		<< L", " << info.email()
+		<< std::boolalpha
+		<< L", " << L"Discardable: " << info.discardable()
+		<< L", " << L"License Check: "<< info.license_check()
+		<< L", " << L"Component Non Discardable: " << info.component_non_discardable()
+		<< L", " << L"Unicode: " << info.unicode();
+	return ss.str();
+}
+
+void OutputFactoryInfo(FactoryInfo const &info)
+{
+	hwm::wdout << "--- Output Factory Info ---" << std::endl;
+	hwm::wdout << FactoryInfoToString(info) << std::endl;
+}
+
+//! 最後のshared_ptrが破棄された時にモジュールをアンロードして、待機中のLoad()に通知する。
+//! アンロードが終わるまでエントリのalive_をtrueのままにしておくことで、
+//! 同じモジュールの再ロード（InitDll）とアンロード（ExitDll）が並行して実行されないようにする。
+struct Vst3Module::Deleter
+{
+	void operator()(Vst3Module *module) const
+	{
+		String const path = module->GetPath();
+		delete module;
+
+		auto &registry = GetModuleRegistry();
+		{
+			std::lock_guard<std::mutex> lock(registry.mutex_);
+			auto found = registry.modules_.find(path);
+			if(found != registry.modules_.end()) {
+				found->second.alive_ = false;
+				if(!found->second.loading_) {
+					registry.modules_.erase(found);
+				}
+			}
+		}
+		registry.cond_.notify_all();
+	}
+};
+
+std::shared_ptr<Vst3Module>
+		Vst3Module::Load(String const &module_path)
+{
+	auto &registry = GetModuleRegistry();
+	std::unique_lock<std::mutex> lock(registry.mutex_);
+
+	for( ; ; ) {
+		auto &entry = registry.modules_[module_path];
+		if(auto loaded = entry.module_.lock()) {
+			return loaded;
+		}
+		if(!entry.loading_ && !entry.alive_) {
+			entry.loading_ = true;
+			break;
+		}
+		//! 他のスレッドがロード中か、以前のモジュールのアンロードが終わっていない
+		registry.cond_.wait(lock);
+	}
+
+	lock.unlock();
+
+	std::shared_ptr<Vst3Module> module;
+	try {
+		module = std::shared_ptr<Vst3Module>(new Vst3Module(module_path), Deleter());
+	} catch(...) {
+		lock.lock();
+		registry.modules_.erase(module_path);
+		lock.unlock();
+		registry.cond_.notify_all();
+		throw;
+	}
+
+	lock.lock();
+	//! loading_がtrueの間はエントリが削除されないので、ここでは必ず見つかる
+	auto &entry = registry.modules_[module_path];
+	entry.module_ = module;
+	entry.loading_ = false;
+	entry.alive_ = true;
+	lock.unlock();
+	registry.cond_.notify_all();
+	return module;
+}
+
+Vst3Module::Vst3Module(String const &module_path)
+	:	module_path_(module_path)
+{
+    Module mod(module_path.c_str());
+	if(!mod) {
+		throw std::runtime_error("cannot load library");
+	}
+
+    auto init_dll = reinterpret_cast<setup_proc_t>(mod.get_proc_address("InitDll"));
+	if(init_dll) {
+		init_dll();
+	}
+
+	//! 構築に失敗した場合は、デストラクタが呼ばれないのでここでExitDllを呼び出す
+	bool constructed = false;
+	HWM_SCOPE_EXIT([&mod, &constructed] {
+		if(constructed || !mod) { return; }
+		auto exit_dll = (setup_proc_t)mod.get_proc_address("ExitDll");
+		if(exit_dll) {
+			exit_dll();
+		}
+	});
+
+	//! GetPluginFactoryという名前でエクスポートされている、
+	//! Factory取得用の関数を探す。
+	GetFactoryProc get_factory = (GetFactoryProc)mod.get_proc_address("GetPluginFactory");
+	if(!get_factory) {
+		throw std::runtime_error("not a vst3 module");
+	}
+
+	auto factory = to_unique(get_factory());
+	if(!factory) {
+		throw std::runtime_error("Failed to get factory function");
+	}
+	
+	PFactoryInfo loaded_factory_info;
+	factory->getFactoryInfo(&loaded_factory_info);
+
+	std::vector<ClassInfo> class_info_list;
+
+	for(int i = 0; i < factory->countClasses(); ++i) {
+		auto maybe_factory3 = queryInterface<IPluginFactory3>(factory);
+		if(maybe_factory3.is_right()) {
+			PClassInfoW info;
+			maybe_factory3.right()->getClassInfoUnicode(i, &info);
+			class_info_list.emplace_back(info);
+		} else {
+			auto maybe_factory2 = queryInterface<IPluginFactory2>(factory);
+			if(maybe_factory2.is_right()) {
+				PClassInfo2 info;
+				maybe_factory2.right()->getClassInfo2(i, &info);
+				class_info_list.emplace_back(info);
+			} else {
+				PClassInfo info;
+				factory->getClassInfo(i, &info);
+				class_info_list.emplace_back(info);
+			}
+		}
+	}
+
+	module_ = std::move(mod);
+	factory_ = std::move(factory);
+	factory_info_ = FactoryInfo(loaded_factory_info);
+	class_info_list_ = std::move(class_info_list);
+	constructed = true;
+
+	OutputFactoryInfo(factory_info_);
+	OutputClassInfoList(class_info_list_);
+}
+
+Vst3Module::~Vst3Module()
+{
+	factory_.reset();
+
+	if(module_) {
+		auto exit_dll = (setup_proc_t)module_.get_proc_address("ExitDll");
+		if(exit_dll) {
+			exit_dll();
+		}
+	}
+}
+
+}	// ::hwm
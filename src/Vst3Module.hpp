@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <pluginterfaces/base/ipluginbase.h>
+
+#include "./Module.hpp"
+#include "./Vst3PluginFactory.hpp"
+
+namespace hwm {
+
+//! ロードされたVST3モジュール（.vst3ファイル）を表すクラス
+/*!
+	Moduleと、そこから取得したIPluginFactory、FactoryInfo、ClassInfoのリストを保持する。
+
+	Load()で作成したVst3Moduleはモジュールのパスごとにレジストリで共有されるので、
+	同じモジュールを何度Load()しても、モジュールのロードやGetPluginFactoryの呼び出し、
+	クラス情報の列挙は最初の一度しか行われない。
+	Vst3PluginFactoryとVst3Pluginはそれぞれshared_ptrでVst3Moduleを保持し、
+	最後のshared_ptrが破棄された時点でモジュールがアンロードされる。
+*/
+class Vst3Module
+{
+public:
+	//! module_pathのモジュールを取得する。
+	//! まだロードされていない場合はロードする。
+	//! @throw std::runtime_error モジュールをロードできなかった場合
+	static
+	std::shared_ptr<Vst3Module>
+			Load(String const &module_path);
+
+	~Vst3Module();
+
+	Vst3Module(Vst3Module const &) = delete;
+	Vst3Module & operator=(Vst3Module const &) = delete;
+
+	String const &	GetPath() const { return module_path_; }
+
+	Steinberg::IPluginFactory *
+					GetFactory() const { return factory_.get(); }
+
+	FactoryInfo const &
+					GetFactoryInfo() const { return factory_info_; }
+
+	std::vector<ClassInfo> const &
+					GetClassInfoList() const { return class_info_list_; }
+
+private:
+	explicit
+	Vst3Module(String const &module_path);
+
+	struct Deleter;
+
+	typedef std::unique_ptr<Steinberg::IPluginFactory, SelfReleaser> factory_ptr;
+
+	String					module_path_;
+	Module					module_;
+	factory_ptr				factory_;
+	FactoryInfo				factory_info_;
+	std::vector<ClassInfo>	class_info_list_;
+};
+
+}	// ::hwm
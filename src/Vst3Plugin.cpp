@@ -22,39 +22,67 @@ size_t Vst3Plugin::ParameterAccessor::size() const
 Vst3Plugin::ParameterAccessor::value_t
 		Vst3Plugin::ParameterAccessor::get_by_index(size_t index) const
 {
-	auto controller = owner_->pimpl_->GetEditController();
-	return
-		controller->getParamNormalized(owner_->pimpl_->parameters_.GetInfoByIndex(index).id);
+	return owner_->pimpl_->parameters_.GetValue(index);
 }
 
 void	Vst3Plugin::ParameterAccessor::set_by_index(size_t index, value_t value)
 {
+	auto &parameters = owner_->pimpl_->parameters_;
 	auto controller = owner_->pimpl_->GetEditController();
-	controller->setParamNormalized(owner_->pimpl_->parameters_.GetInfoByIndex(index).id, value);
+	controller->setParamNormalized(parameters.GetSummary(index).id_, value);
+	parameters.SetValue(index, value);
 }
 
 Vst3Plugin::ParameterAccessor::value_t
 		Vst3Plugin::ParameterAccessor::get_by_id(Vst::ParamID id) const
 {
-	auto controller = owner_->pimpl_->GetEditController();
-	return
-		controller->getParamNormalized(id);
+	auto const &parameters = owner_->pimpl_->parameters_;
+	auto const index = parameters.FindIndex(id);
+	if(index == ParameterModel::npos) {
+		//! パラメータ情報にないIDは値がキャッシュされていないので、コントローラから取得する
+		return owner_->pimpl_->GetEditController()->getParamNormalized(id);
+	}
+	return parameters.GetValue(index);
 }
 
 void	Vst3Plugin::ParameterAccessor::set_by_id(Vst::ParamID id, value_t value)
 {
 	auto controller = owner_->pimpl_->GetEditController();
 	controller->setParamNormalized(id, value);
+	owner_->pimpl_->parameters_.SetValueByID(id, value);
 }
 
-Vst::ParameterInfo
+size_t	Vst3Plugin::ParameterAccessor::find_index(Vst::ParamID id) const
+{
+	return owner_->pimpl_->parameters_.FindIndex(id);
+}
+
+Vst::ParameterInfo const &
 		Vst3Plugin::ParameterAccessor::info(size_t index) const
 {
-	auto controller = owner_->pimpl_->GetEditController();
+	return owner_->pimpl_->parameters_.GetInfoByIndex(index);
+}
+
+Vst3Plugin::ParameterAccessor::snapshot_t
+		Vst3Plugin::ParameterAccessor::take_snapshot() const
+{
+	auto const &parameters = owner_->pimpl_->parameters_;
+	snapshot_t snapshot(parameters.size());
+	for(size_t i = 0; i < parameters.size(); ++i) {
+		snapshot[i].first = parameters.GetSummary(i).id_;
+		snapshot[i].second = parameters.GetValue(i);
+	}
+	return snapshot;
+}
+
+void	Vst3Plugin::ParameterAccessor::apply(snapshot_t const &changes)
+{
+	owner_->pimpl_->ApplyParameters(changes);
+}
 
-	Vst::ParameterInfo info = {};
-	controller->getParameterInfo(index, info);
-	return info;
+void	Vst3Plugin::ParameterAccessor::morph(snapshot_t const &from, snapshot_t const &to, size_t num_blocks)
+{
+	owner_->pimpl_->MorphParameters(from, to, num_blocks);
 }
 
 Vst3Plugin::Vst3Plugin(std::unique_ptr<Impl> pimpl)
@@ -98,11 +126,56 @@ String Vst3Plugin::GetEffectName() const
 	return pimpl_->GetEffectName();
 }
 
+std::array<Steinberg::int8, 16> Vst3Plugin::GetClassID() const
+{
+	return pimpl_->GetClassID();
+}
+
 size_t Vst3Plugin::GetNumOutputs() const
 {
 	return pimpl_->GetNumOutputs();
 }
 
+size_t Vst3Plugin::GetNumInputBuses() const
+{
+	return pimpl_->GetNumInputBuses();
+}
+
+size_t Vst3Plugin::GetNumOutputBuses() const
+{
+	return pimpl_->GetNumOutputBuses();
+}
+
+size_t Vst3Plugin::GetInputBusChannels(size_t bus_index) const
+{
+	return pimpl_->GetInputBusChannels(bus_index);
+}
+
+size_t Vst3Plugin::GetOutputBusChannels(size_t bus_index) const
+{
+	return pimpl_->GetOutputBusChannels(bus_index);
+}
+
+float ** Vst3Plugin::GetOutputBusBuffers(size_t bus_index)
+{
+	return pimpl_->GetOutputBusBuffers(bus_index);
+}
+
+double ** Vst3Plugin::GetOutputBusBuffers64(size_t bus_index)
+{
+	return pimpl_->GetOutputBusBuffers64(bus_index);
+}
+
+void Vst3Plugin::ConnectInputBus(size_t bus_index, float ** channels)
+{
+	pimpl_->ConnectInputBus(bus_index, channels);
+}
+
+void Vst3Plugin::ConnectInputBus64(size_t bus_index, double ** channels)
+{
+	pimpl_->ConnectInputBus64(bus_index, channels);
+}
+
 void Vst3Plugin::Resume()
 {
 	pimpl_->Resume();
@@ -130,6 +203,33 @@ void Vst3Plugin::SetSamplingRate(int sampling_rate)
 	pimpl_->SetSamplingRate(sampling_rate);
 }
 
+void Vst3Plugin::SetProcessMode(int32 process_mode)
+{
+	assert(!IsResumed());
+	pimpl_->SetProcessMode(process_mode);
+}
+
+int32 Vst3Plugin::GetProcessMode() const
+{
+	return pimpl_->GetProcessMode();
+}
+
+bool Vst3Plugin::CanProcessDouble() const
+{
+	return pimpl_->CanProcessDouble();
+}
+
+void Vst3Plugin::SetSymbolicSampleSize(int32 sample_size)
+{
+	assert(!IsResumed());
+	pimpl_->SetSymbolicSampleSize(sample_size);
+}
+
+int32 Vst3Plugin::GetSymbolicSampleSize() const
+{
+	return pimpl_->GetSymbolicSampleSize();
+}
+
 bool Vst3Plugin::HasEditor() const
 {
 	return pimpl_->HasEditor();
@@ -155,14 +255,24 @@ ViewRect Vst3Plugin::GetPreferredRect() const
 	return pimpl_->GetPreferredRect();
 }
 
-void Vst3Plugin::AddNoteOn(int note_number)
+bool Vst3Plugin::AddEvent(Vst::Event const &event)
 {
-	pimpl_->AddNoteOn(note_number);
+	return pimpl_->AddEvent(event);
 }
 
-void Vst3Plugin::AddNoteOff(int note_number)
+bool Vst3Plugin::AddNoteOn(int note_number, int32 sample_offset, float velocity, int16 channel, int32 note_id)
 {
-	pimpl_->AddNoteOff(note_number);
+	return pimpl_->AddNoteOn(note_number, sample_offset, velocity, channel, note_id);
+}
+
+bool Vst3Plugin::AddNoteOff(int note_number, int32 sample_offset, float velocity, int16 channel, int32 note_id)
+{
+	return pimpl_->AddNoteOff(note_number, sample_offset, velocity, channel, note_id);
+}
+
+size_t Vst3Plugin::GetNumDroppedEvents() const
+{
+	return pimpl_->GetNumDroppedEvents();
 }
 
 size_t			Vst3Plugin::GetProgramCount() const
@@ -185,9 +295,19 @@ void			Vst3Plugin::SetProgramIndex(size_t index)
 	pimpl_->SetProgramIndex(index);
 }
 
-void Vst3Plugin::EnqueueParameterChange(Vst::ParamID id, Vst::ParamValue value)
+bool			Vst3Plugin::AddProgramChange(size_t index, Steinberg::int32 sample_offset)
+{
+	return pimpl_->AddProgramChange(index, sample_offset);
+}
+
+void Vst3Plugin::EnqueueParameterChange(Vst::ParamID id, Vst::ParamValue value, int32 sample_offset)
 {
-	pimpl_->EnqueueParameterChange(id, value);
+	pimpl_->EnqueueParameterChange(id, value, sample_offset);
+}
+
+void Vst3Plugin::PerformEdit(Vst::ParamID id, Vst::ParamValue value)
+{
+	pimpl_->PerformEdit(id, value);
 }
 
 void Vst3Plugin::RestartComponent(Steinberg::int32 flags)
@@ -195,15 +315,71 @@ void Vst3Plugin::RestartComponent(Steinberg::int32 flags)
 	pimpl_->RestartComponent(flags);
 }
 
+Vst3Plugin::StateData
+		Vst3Plugin::GetState() const
+{
+	return pimpl_->GetState();
+}
+
+void	Vst3Plugin::SetState(StateData const &state)
+{
+	pimpl_->SetState(state);
+}
+
 float ** Vst3Plugin::ProcessAudio(size_t frame_pos, size_t duration)
 {
 	return pimpl_->ProcessAudio(frame_pos, duration);
 }
 
+double ** Vst3Plugin::ProcessAudio64(size_t frame_pos, size_t duration)
+{
+	return pimpl_->ProcessAudio64(frame_pos, duration);
+}
+
+void Vst3Plugin::ProcessAudioInto(size_t frame_pos, size_t duration, float ** outputs)
+{
+	pimpl_->ProcessAudioInto(frame_pos, duration, outputs);
+}
+
+PeakMeterBank * Vst3Plugin::GetOutputMeter()
+{
+	return pimpl_->GetOutputMeter();
+}
+
+void Vst3Plugin::SetInputSource(size_t bus_index, std::shared_ptr<InputSource> source)
+{
+	pimpl_->SetInputSource(bus_index, std::move(source));
+}
+
+void Vst3Plugin::SetOutputTap(std::shared_ptr<AudioTap> tap)
+{
+	pimpl_->SetOutputTap(std::move(tap));
+}
+
+void Vst3Plugin::OnIdle()
+{
+	pimpl_->OnIdle();
+}
+
+void Vst3Plugin::SetOutputParameterChangeHandler(output_parameter_change_handler_t handler)
+{
+	pimpl_->SetOutputParameterChangeHandler(std::move(handler));
+}
+
+void Vst3Plugin::SetAutomation(std::unique_ptr<AutomationSet> automation)
+{
+	pimpl_->SetAutomation(std::move(automation));
+}
+
+void Vst3Plugin::ResetHostState()
+{
+	pimpl_->ResetHostState();
+}
+
 std::unique_ptr<Vst3Plugin>
-	CreatePlugin(IPluginFactory *factory, ClassInfo const &info, Vst3PluginFactory::host_context_type host_context)
+	CreatePlugin(std::shared_ptr<Vst3Module> module, ClassInfo const &info, Vst3PluginFactory::host_context_type host_context)
 {
-	auto impl = std::make_unique<Vst3Plugin::Impl>(factory, info, std::move(host_context));
+	auto impl = std::make_unique<Vst3Plugin::Impl>(std::move(module), info, std::move(host_context));
 	return std::make_unique<Vst3Plugin>(std::move(impl));
 }
 
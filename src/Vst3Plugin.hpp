@@ -2,6 +2,8 @@
 
 #include <array>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include <functional>
 
@@ -9,28 +11,48 @@
 #include "pluginterfaces/base/ipluginbase.h"
 #include "pluginterfaces/vst/ivstcomponent.h"
 #include "pluginterfaces/vst/ivsteditcontroller.h"
+#include "pluginterfaces/vst/ivstevents.h"
 #include "./Vst3Utils.hpp"
 
 namespace hwm {
 
+class AudioTap;
+class AutomationSet;
+class InputSource;
+class PeakMeterBank;
+
 //! VST3のプラグインを表すクラス
 /*!
 	Vst3PluginFactoryから作成可能
-	Vst3PluginFactoryによってロードされたモジュール（.vst3ファイル）がアンロードされてしまうため、
-	作成したVst3Pluginが破棄されるまで、Vst3PluginFactoryを破棄してはならない。
-	=> モジュールをshared_ptrで管理してそれぞれのVst3Pluginに持たせてもいいかもしれない
+	それぞれのVst3Pluginはモジュール（.vst3ファイル）をshared_ptrで保持するので、
+	Vst3PluginFactoryを先に破棄しても構わない。
+	モジュールは、それを使用するVst3PluginFactoryとVst3Pluginがすべて破棄された時点でアンロードされる。
 */
 class Vst3Plugin
 {
 public:
 	struct Impl;
 
+	//! パラメータへのアクセスを提供するクラス
+	/*!
+		パラメータ情報と値はホスト側にキャッシュされていて、
+		get_by_index/get_by_id/infoはプラグインのメソッドを呼び出さない。
+		ただし、パラメータ情報にないIDをget_by_idに指定した場合は、コントローラから値を取得する。
+		キャッシュされた値は、set_by_index/set_by_id、PerformEdit、
+		プロセッサの出力パラメータ、RestartComponent(kParamValuesChanged)で更新される。
+	*/
 	struct ParameterAccessor
 	{
 		ParameterAccessor(Vst3Plugin *owner);
 
 		typedef Steinberg::Vst::ParamValue value_t;
 
+		//! パラメータのIDと値の組の配列
+		typedef std::vector<std::pair<Steinberg::Vst::ParamID, value_t>> snapshot_t;
+
+		//! find_indexでidが見つからなかった場合の値
+		static constexpr size_t npos = static_cast<size_t>(-1);
+
 		size_t	size() const;
 
 		value_t get_by_index(size_t index) const;
@@ -39,9 +61,42 @@ public:
 		value_t get_by_id	(Steinberg::Vst::ParamID id) const;
 		void	set_by_id	(Steinberg::Vst::ParamID id, value_t value);
 
-		Steinberg::Vst::ParameterInfo
+		//! idに対応するインデックスを返す。見つからない場合はnposを返す。
+		size_t	find_index	(Steinberg::Vst::ParamID id) const;
+
+		//! パラメータ情報を返す。
+		/*!
+			タイトルや単位はkParamTitlesChangedによってRestartComponentの中で書き換えられるので、
+			UIスレッドからのみ呼び出して、返された参照をスレッド間で共有しないこと。
+		*/
+		Steinberg::Vst::ParameterInfo const &
 				info(size_t index) const;
 
+		//! すべてのパラメータの、キャッシュされた現在の値を取得する
+		snapshot_t
+				take_snapshot() const;
+
+		//! 複数のパラメータの値をまとめて変更する
+		/*!
+			コントローラにはこの呼び出しの中で設定し、プロセッサにはすべての変更を1回でオーディオスレッドに渡して、
+			次回の再生フレームの先頭で同時に適用させる。
+			1つずつset_by_idとEnqueueParameterChangeを呼び出すのと違って、変更が複数のブロックに分かれることはない。
+		*/
+		void	apply(snapshot_t const &changes);
+
+		//! fromの値からtoの値へ、num_blocksブロックかけてパラメータを補間する
+		/*!
+			プロセッサには、ブロックごとに補間した値がサンプル単位の位置を持つ点として送られる。
+			toに含まれてfromに含まれないパラメータは、現在の値から補間する。
+			キャッシュされた値はブロックごとに、コントローラは補間の終了後にVst3Plugin::OnIdleで更新される。
+			補間中に新しくmorphを呼び出すと、実行中のものを途中の値で止めて置き換える。
+			補間中にapplyで変更したパラメータのうち、補間の対象のものは次のブロックで補間の値に戻る。
+			num_blocksはProcessAudioの呼び出し回数で数える。各ブロックの中では実際に処理するサンプル数で補間するので、
+			ホストが短いブロックを渡しても補間はnum_blocks回のProcessAudioで終わる。
+			補間にかかるサンプル数がnum_blocks×ブロックサイズになるのは、ホストが常にブロックサイズ分のサンプルを処理する場合。
+		*/
+		void	morph(snapshot_t const &from, snapshot_t const &to, size_t num_blocks);
+
 	private:
 		Vst3Plugin *owner_;
 	};
@@ -57,13 +112,72 @@ public:
 	ParameterAccessor const &	GetParams() const;
 
 	String GetEffectName() const;
+	//! プラグインのクラスID
+	std::array<Steinberg::int8, 16>
+			GetClassID() const;
 	size_t	GetNumOutputs() const;
+
+	size_t	GetNumInputBuses() const;
+	size_t	GetNumOutputBuses() const;
+	size_t	GetInputBusChannels(size_t bus_index) const;
+	size_t	GetOutputBusChannels(size_t bus_index) const;
+
+	//! 出力バスのバッファを返す。ProcessAudioの後に、そのバスの出力が書き込まれている。
+	float **
+			GetOutputBusBuffers(size_t bus_index);
+
+	double **
+			GetOutputBusBuffers64(size_t bus_index);
+
+	//! 入力バスに外部のバッファを接続する。
+	/*!
+		接続されたバスには、ProcessAudioでchannelsがコピーされずにそのまま渡される。
+		channelsはGetInputBusChannels(bus_index)個のチャンネルを持ち、
+		ブロックサイズ以上の長さがなければならない。
+		nullptrを指定すると、接続を解除してプラグイン内部のバッファを使用する。
+		ProcessAudioと同時に呼び出してはならない。
+	*/
+	void	ConnectInputBus(size_t bus_index, float ** channels);
+	//! 64bitで処理している場合のConnectInputBus
+	void	ConnectInputBus64(size_t bus_index, double ** channels);
+
+	//! 入力バスにオーディオを供給するソースを設定する
+	/*!
+		ConnectInputBus/ConnectInputBus64で外部のバッファが接続されていないバスでは、
+		ProcessAudioのたびにsourceから入力を読み出す。
+		nullptrを指定すると、テスト用の信号を使用する。
+		sourceはオーディオスレッドが次のブロックで受け取って差し替え、差し替えられたソースは
+		次回のSetInputSourceの呼び出しで解放されるので、ソースのデストラクタはオーディオスレッドでは実行されない。
+		ProcessAudioと同時に呼び出してもよいが、複数のスレッドから同時に呼び出してはならない。
+		@throw std::runtime_error 受け渡し待ちの変更が多すぎる場合
+	*/
+	void	SetInputSource(size_t bus_index, std::shared_ptr<InputSource> source);
 	void	Resume();
 	void	Suspend();
 	bool	IsResumed() const;
 	void	SetBlockSize(int block_size);
 	void	SetSamplingRate(int sampling_rate);
 
+	//! Steinberg::Vst::ProcessModesの値を指定する。デフォルトはkRealtime。
+	//! オフラインレンダリングを行う場合はkOfflineを指定する。
+	void	SetProcessMode(Steinberg::int32 process_mode);
+	Steinberg::int32
+			GetProcessMode() const;
+
+	//! プラグインが64bit浮動小数点数での処理(kSample64)に対応しているかどうか
+	bool	CanProcessDouble() const;
+
+	//! Steinberg::Vst::SymbolicSampleSizesの値を指定する。デフォルトはkSample32。
+	/*!
+		kSample64を指定すると、プラグインの入出力バッファはdoubleで確保され、
+		ProcessAudioの代わりにProcessAudio64を使用する。
+		ConnectInputBus/ConnectInputBus64による接続は解除される。
+		@throw std::runtime_error プラグインがkSample64に対応していない場合
+	*/
+	void	SetSymbolicSampleSize(Steinberg::int32 sample_size);
+	Steinberg::int32
+			GetSymbolicSampleSize() const;
+
 	bool	HasEditor		() const;
 	//bool	OpenEditor		(HWND wnd, Steinberg::IPlugFrame *frame);
 	void	CloseEditor		();
@@ -71,24 +185,167 @@ public:
 	Steinberg::ViewRect
 			GetPreferredRect() const;
 
-	void	AddNoteOn(int note_number);
-	void	AddNoteOff(int note_number);
+	//! イベントを次回の再生フレームでAudioProcessorに送信するためにキューに貯める。
+	/*!
+		キューはロックフリーなシングルプロデューサー・シングルコンシューマーキューなので、
+		イベントの追加は1つのスレッドからのみ行うこと。
+		Event::sampleOffsetは次回の再生フレームの先頭からのオフセットとして扱われる。
+		@return キューが一杯でイベントを追加できなかった場合はfalse
+	*/
+	bool	AddEvent(Steinberg::Vst::Event const &event);
+	bool	AddNoteOn(int note_number,
+					  Steinberg::int32 sample_offset = 0,
+					  float velocity = 100 / 127.0f,
+					  Steinberg::int16 channel = 0,
+					  Steinberg::int32 note_id = -1);
+	bool	AddNoteOff(int note_number,
+					   Steinberg::int32 sample_offset = 0,
+					   float velocity = 100 / 127.0f,
+					   Steinberg::int16 channel = 0,
+					   Steinberg::int32 note_id = -1);
+
+	//! キューが一杯で破棄されたイベントの数
+	size_t	GetNumDroppedEvents() const;
 
 	size_t	GetProgramCount() const;
+	//! プログラム名を返す。名前は初回の呼び出しでプラグインから取得してキャッシュする。
+	//! どのスレッドから呼び出してもよい。
 	String  GetProgramName(size_t index) const;
 
 	size_t	GetProgramIndex() const;
 
+	//! プログラムを変更する。
+	/*!
+		プロセッサには次回の再生フレームの先頭で通知され、コントローラへの反映はOnIdleで行われる。
+	*/
 	void	SetProgramIndex(size_t index);
 
+	//! MIDIのプログラムチェンジなどによるプログラム変更を、次回の再生フレームでAudioProcessorに送信する
+	/*!
+		プログラムのインデックスから正規化された値への変換はロード時に求めた表を使うので、
+		この呼び出しではIEditControllerを呼び出さない。コントローラへの反映はOnIdleで行われる。
+		MIDIのスレッドやUIスレッドなど、どのスレッドから呼び出してもよい。
+		sample_offsetは次回の再生フレームの先頭からのオフセットとして扱われる。
+		EnqueueParameterChangeと違って変更はまとめられず、1ブロック内の複数の変更もそれぞれの位置で送信される。
+		@return indexがGetProgramCount()以上の場合や、送信待ちの変更が多すぎる場合はfalse
+	*/
+	bool	AddProgramChange(size_t index, Steinberg::int32 sample_offset = 0);
+
 	//! パラメータの変更を次回の再生フレームでAudioProcessorに送信して適用するために、
 	//! 変更する情報をキューに貯める
-	void	EnqueueParameterChange(Steinberg::Vst::ParamID id, Steinberg::Vst::ParamValue value);
+	/*!
+		変更はパラメータごとのスロットにロックフリーに書き込まれ、
+		次回の再生フレームまでに同じパラメータへ複数回変更された場合は最後の値だけが送信される。
+		sample_offsetは次回の再生フレームの先頭からのオフセットとして扱われる。
+		複数のスレッドから同時に呼び出してもよい。
+		パラメータ情報にないIDへの変更はキューに貯められ、キューが一杯の場合は破棄される。
+	*/
+	void	EnqueueParameterChange(Steinberg::Vst::ParamID id,
+								   Steinberg::Vst::ParamValue value,
+								   Steinberg::int32 sample_offset = 0);
 
 	void	RestartComponent(Steinberg::int32 flag);
 
+	//! コントローラがIComponentHandler::performEditで通知したパラメータの変更を反映する
+	/*!
+		キャッシュされた値を更新して、変更を次回の再生フレームでプロセッサに送信する。
+		Vst3HostCallback::SetParameterChangeNotificationHandlerに設定したハンドラから呼び出す。
+	*/
+	void	PerformEdit(Steinberg::Vst::ParamID id, Steinberg::Vst::ParamValue value);
+
+	//! プラグインの状態を表すデータ
+	struct StateData
+	{
+		//! IComponent::getStateで取得したデータ
+		std::vector<char>	component_;
+		//! IEditController::getStateで取得したデータ
+		std::vector<char>	controller_;
+	};
+
+	//! プラグインの状態を取得する。
+	StateData
+			GetState() const;
+
+	//! GetStateで取得した状態をプラグインに復元する。
+	//! ProcessAudioと同時に呼び出してはならない。
+	void	SetState(StateData const &state);
+
+	//! kSample32で処理している場合に使用する
 	float ** ProcessAudio(size_t frame_pos, size_t num_samples);
 
+	//! kSample64で処理している場合に使用する
+	double ** ProcessAudio64(size_t frame_pos, size_t num_samples);
+
+	//! プラグインの出力を、内部のバッファではなくoutputsに直接書き込ませる
+	/*!
+		outputsはGetNumOutputs()個のチャンネルの先頭ポインタの配列で、
+		すべての出力バスのチャンネルをバスの順に並べたもの。
+		オーディオデバイスのバッファなどに直接出力させることで、出力のコピーを省くことができる。
+		kSample32で処理している場合に使用する
+	*/
+	void	ProcessAudioInto(size_t frame_pos, size_t num_samples, float ** outputs);
+
+	//! すべての出力バスのチャンネルをバスの順に並べたピークメーター
+	/*!
+		ProcessAudio/ProcessAudio64/ProcessAudioIntoのたびに更新される。
+		kSample64で処理している場合は、出力をfloatに変換した値で更新される。
+		UIスレッドからはPeakMeterBank::Update()とGetSnapshot()で値を読み出す。
+		Resumeでバスの構成に合わせて作り直されるので、Resume/Suspendと同時に使用してはならない。
+		@return Resumeする前はnullptr
+	*/
+	PeakMeterBank *
+			GetOutputMeter();
+
+	//! ProcessAudio/ProcessAudio64/ProcessAudioIntoの出力を書き込むタップを設定する
+	/*!
+		tapはGetNumOutputs()個のチャンネルを持つこと。
+		すべての出力バスのチャンネルがバスの順に書き込まれる。
+		kSample64で処理している場合は、出力をfloatに変換したものが書き込まれる。
+		LoudnessAnalyzerなどで、オーディオスレッドとは別のスレッドから出力を解析するために使用する。
+		nullptrを指定すると、タップへの書き込みを止める。
+		SetInputSourceと同じく、tapはオーディオスレッドが次のブロックで受け取って差し替え、
+		差し替えられたタップは次回のSetOutputTapの呼び出しで解放される。
+		ProcessAudioと同時に呼び出してもよいが、複数のスレッドから同時に呼び出してはならない。
+		@throw std::runtime_error 受け渡し待ちの変更が多すぎる場合
+	*/
+	void	SetOutputTap(std::shared_ptr<AudioTap> tap);
+
+	typedef std::function<void(Steinberg::Vst::ParamID id, Steinberg::Vst::ParamValue value)>
+			output_parameter_change_handler_t;
+
+	//! UIスレッドから定期的に呼び出す
+	/*!
+		プロセッサが出力したパラメータの変更(ゲインリダクションのメーターなど)を、
+		IDごとに最新の値にまとめてsetParamNormalizedでコントローラに反映し、
+		SetOutputParameterChangeHandlerで設定したハンドラに通知する。
+		ハンドラは、呼び出される頻度が高くても最大で約30Hzで呼び出される。
+	*/
+	void	OnIdle();
+
+	//! OnIdleで、プロセッサが出力したパラメータの変更を通知するハンドラを設定する
+	void	SetOutputParameterChangeHandler(output_parameter_change_handler_t handler);
+
+	//! パラメータのオートメーションを設定する
+	/*!
+		ProcessAudioのたびに、再生位置のブロックの区間の曲線が、
+		ブロック内のサンプルオフセットを持つ点の列としてプロセッサに送信される。
+		そのため、ブロックサイズを大きくしてもオートメーションの時間分解能は落ちない。
+		渡したautomationは、オーディオスレッドが次のブロックで受け取って差し替える。
+		nullptrを指定すると、オートメーションを止める。
+		ProcessAudioと同時に呼び出してもよいが、複数のスレッドから同時に呼び出してはならない。
+	*/
+	void	SetAutomation(std::unique_ptr<AutomationSet> automation);
+
+	//! ホストがこのインスタンスに設定したものを、作成直後の状態に戻す
+	/*!
+		送信待ちのイベント、パラメータの変更、プログラム変更、一括変更とモーフィング、オートメーション、
+		入力ソース、接続された入力バス、出力のタップ、出力パラメータのハンドラを破棄する。
+		プラグインの状態とサンプリングレートなどの処理の設定は変更しないので、
+		必要に応じてSetStateやSetSamplingRateなどで設定し直すこと。
+		ProcessAudioやOnIdleと同時に呼び出してはならない。
+	*/
+	void	ResetHostState();
+
 private:
 
 	//! deleted
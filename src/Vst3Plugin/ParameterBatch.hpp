@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "pluginterfaces/vst/vsttypes.h"
+
+namespace hwm {
+
+//! 複数のパラメータの変更を、1回の受け渡しでオーディオスレッドに渡すためのデータ
+/*!
+	num_blocks_が0の場合は、受け取ったブロックの先頭で、すべてのパラメータをto_の値に変更する。
+	それ以外の場合は、num_blocks_ブロックかけてfrom_からto_へ直線で補間する(モーフィング)。
+	ブロックはProcessAudioの呼び出し1回で数えて、各ブロックの中ではホストが実際に処理するサンプル数で補間するので、
+	ホストがブロックサイズより短いブロックで処理しても、補間はnum_blocks_ブロックで終わる。
+
+	UIスレッドで作成して、SpscQueueでオーディオスレッドに渡す。
+	オーディオスレッドは処理し終わったものをUIスレッドに返却し、UIスレッドで破棄する。
+	オーディオスレッドが変更するのはposition_だけ。
+*/
+struct ParameterBatch
+{
+	typedef Steinberg::Vst::ParamID ParamID;
+	typedef Steinberg::Vst::ParamValue ParamValue;
+
+	ParameterBatch()
+		:	num_blocks_(0)
+		,	position_(0)
+	{}
+
+	size_t size() const { return ids_.size(); }
+
+	bool IsMorph() const { return num_blocks_ > 0; }
+
+	//! 補間の進み具合progress（0.0から1.0）での、i番目のパラメータの値。
+	//! 1.0以上の場合はto_の値になる。
+	ParamValue GetValueAt(size_t i, double progress) const
+	{
+		if(progress >= 1.0) {
+			return to_[i];
+		}
+		return from_[i] + (to_[i] - from_[i]) * progress;
+	}
+
+	//! 対象のパラメータ
+	std::vector<ParamID>	ids_;
+	//! ParameterModelでのインデックス。含まれないIDの場合はParameterModel::npos
+	std::vector<size_t>		indices_;
+	std::vector<ParamValue>	from_;
+	std::vector<ParamValue>	to_;
+	size_t					num_blocks_;
+	//! オーディオスレッドで処理し終わったブロック数
+	size_t					position_;
+};
+
+}	// ::hwm
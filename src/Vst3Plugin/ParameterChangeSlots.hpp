@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+
+#include "pluginterfaces/vst/vsttypes.h"
+
+namespace hwm {
+
+//! パラメータごとに最新の変更値を保持する、ロックフリーなスロットの配列
+/*!
+	パラメータのインデックス(ParameterModelのインデックス)ごとに1つのスロットを持ち、
+	Setで書き込まれたスロットはダーティビットで管理される。
+	オーディオスレッドはDrainで変更のあったスロットだけを、変更された数に比例するコストで列挙できる。
+
+	同じスロットに対して、Drainされるまでに複数回Setが呼ばれた場合は、最後の値だけが残る(coalescing)。
+
+	Set、Drainはどちらもwait-freeで、メモリ確保を行わない。
+	Setは複数のスレッドから呼び出してもよいが、Drainは1つのスレッドからのみ呼び出すこと。
+
+	Drainが値とサンプルオフセットを別々の書き込みから組み合わせて読まないように、
+	スロットには両方を1つの64bitの値にまとめて格納する。
+	値は[0, 1]にクランプして上位40bitの固定小数点数(分解能は約2e-12)に、
+	サンプルオフセットは[0, 2^24)にクランプして下位24bitに格納する。
+	Resizeはどのスレッドからもアクセスされていない状態で呼び出すこと。
+*/
+struct ParameterChangeSlots
+{
+	typedef Steinberg::Vst::ParamValue value_type;
+
+	ParameterChangeSlots()
+		:	size_(0)
+		,	num_words_(0)
+	{}
+
+	ParameterChangeSlots(ParameterChangeSlots const &) = delete;
+	ParameterChangeSlots & operator=(ParameterChangeSlots const &) = delete;
+
+	void Resize(size_t num_slots)
+	{
+		size_t const num_words = (num_slots + kBitsPerWord - 1) / kBitsPerWord;
+
+		slots_.reset(new std::atomic<std::uint64_t>[num_slots]);
+		dirty_.reset(new std::atomic<std::uint64_t>[num_words]);
+		for(size_t i = 0; i < num_slots; ++i) {
+			slots_[i].store(0, std::memory_order_relaxed);
+		}
+		for(size_t i = 0; i < num_words; ++i) {
+			dirty_[i].store(0, std::memory_order_relaxed);
+		}
+
+		size_ = num_slots;
+		num_words_ = num_words;
+	}
+
+	size_t size() const { return size_; }
+
+	void Set(size_t index, value_type value, Steinberg::int32 sample_offset)
+	{
+		assert(index < size_);
+
+		slots_[index].store(Pack(value, sample_offset), std::memory_order_relaxed);
+		dirty_[index / kBitsPerWord].fetch_or(
+			std::uint64_t(1) << (index % kBitsPerWord),
+			std::memory_order_release
+			);
+	}
+
+	//! 前回のDrain以降に変更されたスロットを列挙して、ダーティビットをクリアする。
+	/*!
+		@param f void(size_t index, value_type value, Steinberg::int32 sample_offset)というシグネチャを持つ関数オブジェクト
+	*/
+	template<class F>
+	void Drain(F f)
+	{
+		for(size_t w = 0; w < num_words_; ++w) {
+			if(dirty_[w].load(std::memory_order_relaxed) == 0) {
+				continue;
+			}
+
+			std::uint64_t bits = dirty_[w].exchange(0, std::memory_order_acquire);
+			while(bits != 0) {
+				size_t const bit = CountTrailingZeros(bits);
+				bits &= (bits - 1);
+
+				size_t const index = w * kBitsPerWord + bit;
+				std::uint64_t const packed = slots_[index].load(std::memory_order_relaxed);
+				f(index, UnpackValue(packed), UnpackSampleOffset(packed));
+			}
+		}
+	}
+
+private:
+	static size_t const kBitsPerWord = 64;
+
+	static constexpr int kSampleOffsetBits = 24;
+	static constexpr std::uint64_t kMaxSampleOffset = (std::uint64_t(1) << kSampleOffsetBits) - 1;
+	//! 1.0を2^39で表すと、上位の40bitに収まり、0.5などの2進数で割り切れる値は誤差なく格納できる
+	static constexpr std::uint64_t kValueScale = std::uint64_t(1) << (64 - kSampleOffsetBits - 1);
+
+	static std::uint64_t Pack(value_type value, Steinberg::int32 sample_offset)
+	{
+		value = (value > 0) ? std::min<value_type>(value, 1.0) : 0.0;
+		auto const quantized = static_cast<std::uint64_t>(value * kValueScale + 0.5);
+		auto const offset = static_cast<std::uint64_t>(
+			std::min<std::int64_t>(std::max<std::int64_t>(sample_offset, 0), kMaxSampleOffset));
+		return (quantized << kSampleOffsetBits) | offset;
+	}
+
+	static value_type UnpackValue(std::uint64_t packed)
+	{
+		return (packed >> kSampleOffsetBits) / static_cast<value_type>(kValueScale);
+	}
+
+	static Steinberg::int32 UnpackSampleOffset(std::uint64_t packed)
+	{
+		return static_cast<Steinberg::int32>(packed & kMaxSampleOffset);
+	}
+
+	static size_t CountTrailingZeros(std::uint64_t bits)
+	{
+		assert(bits != 0);
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctzll(bits);
+#else
+		size_t n = 0;
+		while((bits & 1) == 0) { bits >>= 1; ++n; }
+		return n;
+#endif
+	}
+
+	std::unique_ptr<std::atomic<std::uint64_t>[]>	slots_;
+	std::unique_ptr<std::atomic<std::uint64_t>[]>	dirty_;
+	size_t	size_;
+	size_t	num_words_;
+};
+
+}	// ::hwm
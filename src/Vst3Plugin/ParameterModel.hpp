@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "pluginterfaces/vst/ivsteditcontroller.h"
+
+#include "../AllocationGuard.hpp"
+
+namespace hwm {
+
+//! プラグインのパラメータ情報と現在値を、ホスト側でキャッシュしておくクラス
+/*!
+	以下の3つで構成される。
+	-	パラメータ情報のスナップショット。
+		ParameterInfoはタイトルなどの文字列を含んでいて大きいので、
+		頻繁に参照されるIDやフラグなどは、別の小さな構造体の配列(Summary)にも保持する。
+	-	パラメータの値のミラー。
+		コントローラのperformEditやプロセッサの出力パラメータから更新され、
+		どのスレッドからでもロックせずに読み書きできる。
+	-	ParamIDからインデックスへの索引。
+		IDが密に割り当てられている場合は、IDから直接引けるテーブルを使用し、
+		そうでない場合はIDでソートした配列を二分探索する。
+
+	値の読み出しはプラグインのメソッドを呼び出さない。
+	Assignはどのスレッドからもアクセスされていない状態で呼び出すこと。
+
+	パラメータ情報(ParameterInfo)のタイトルや単位は、kParamTitlesChangedでUpdateDisplayInfoによって
+	その場で書き換えられるので、GetInfoByIndex/GetInfoByIDとUpdateDisplayInfoはUIスレッド
+	（RestartComponentとOnIdleを呼び出すスレッド）からのみ呼び出すこと。
+	他のスレッドからはSummaryと値、索引だけを参照する。
+	デバッグビルドでは、AllocationGuardが有効なリアルタイムスレッドからの呼び出しをassertで検出する。
+*/
+class ParameterModel
+{
+public:
+	typedef Steinberg::Vst::ParameterInfo value_type;
+	typedef std::vector<value_type> container;
+	typedef container::const_iterator const_iterator;
+	typedef size_t size_type;
+	typedef Steinberg::Vst::ParamID ParamID;
+	typedef Steinberg::Vst::ParamValue ParamValue;
+
+	static constexpr size_type npos = static_cast<size_type>(-1);
+
+	//! ParameterInfoのうち、頻繁に参照される情報
+	struct Summary
+	{
+		ParamID				id_;
+		Steinberg::int32	flags_;
+		Steinberg::int32	step_count_;
+		Steinberg::Vst::UnitID
+							unit_id_;
+		ParamValue			default_value_;
+	};
+
+	ParameterModel()
+		:	min_id_(0)
+	{}
+
+	ParameterModel(ParameterModel const &) = delete;
+	ParameterModel & operator=(ParameterModel const &) = delete;
+
+	//! パラメータ情報と、それぞれの現在値でモデルを作り直す
+	void Assign(container infos, std::vector<ParamValue> const &values)
+	{
+		assert(infos.size() == values.size());
+
+		infos_ = std::move(infos);
+
+		summaries_.resize(infos_.size());
+		for(size_t i = 0; i < infos_.size(); ++i) {
+			summaries_[i] = MakeSummary(infos_[i]);
+		}
+
+		values_.reset(new std::atomic<ParamValue>[infos_.size()]);
+		for(size_t i = 0; i < infos_.size(); ++i) {
+			values_[i].store(values[i], std::memory_order_relaxed);
+		}
+
+		BuildIndex();
+	}
+
+	size_type size() const { return infos_.size(); }
+	bool empty() const { return infos_.empty(); }
+
+	const_iterator begin() const { return infos_.begin(); }
+	const_iterator end() const { return infos_.end(); }
+
+	//! UIスレッドからのみ呼び出すこと
+	value_type const & GetInfoByIndex(size_type index) const
+	{
+		assert(!AllocationGuard::IsActive() && "parameter info accessed from a real-time thread");
+		assert(index < infos_.size());
+		return infos_[index];
+	}
+
+	//! UIスレッドからのみ呼び出すこと
+	value_type const & GetInfoByID(ParamID id) const
+	{
+		assert(!AllocationGuard::IsActive() && "parameter info accessed from a real-time thread");
+		return infos_[IDToIndex(id)];
+	}
+
+	Summary const & GetSummary(size_type index) const
+	{
+		assert(index < summaries_.size());
+		return summaries_[index];
+	}
+
+	size_type IDToIndex(ParamID id) const
+	{
+		auto const index = FindIndex(id);
+		assert(index != npos);
+		return index;
+	}
+
+	//! idに対応するインデックスを返す。見つからない場合はnposを返す。
+	size_type FindIndex(ParamID id) const
+	{
+		if(!direct_table_.empty()) {
+			//! IDが密に割り当てられている場合
+			std::uint64_t const offset = static_cast<std::uint64_t>(id) - min_id_;
+			if(id < min_id_ || offset >= direct_table_.size()) {
+				return npos;
+			}
+			auto const index = direct_table_[offset];
+			return (index == kNoIndex) ? npos : index;
+		}
+
+		auto found = std::lower_bound(sorted_ids_.begin(), sorted_ids_.end(), id,
+									  [](IndexEntry const &entry, ParamID id) { return entry.id_ < id; });
+		return (found != sorted_ids_.end() && found->id_ == id) ? found->index_ : npos;
+	}
+
+	//! ミラーされた値を返す。どのスレッドから呼び出してもよい。
+	ParamValue GetValue(size_type index) const
+	{
+		assert(index < infos_.size());
+		return values_[index].load(std::memory_order_relaxed);
+	}
+
+	//! ミラーされた値を更新する。どのスレッドから呼び出してもよい。
+	void SetValue(size_type index, ParamValue value)
+	{
+		assert(index < infos_.size());
+		values_[index].store(value, std::memory_order_relaxed);
+	}
+
+	//! @return idが見つからなかった場合はfalse
+	bool SetValueByID(ParamID id, ParamValue value)
+	{
+		auto const index = FindIndex(id);
+		if(index == npos) {
+			return false;
+		}
+		SetValue(index, value);
+		return true;
+	}
+
+	//! タイトルや単位などの表示用の情報だけを更新する。UIスレッドからのみ呼び出すこと。
+	//! Summaryと索引は変更しないので、オーディオスレッドでIDを参照していてもよい。
+	void UpdateDisplayInfo(size_type index, value_type const &info)
+	{
+		assert(!AllocationGuard::IsActive() && "parameter info updated from a real-time thread");
+		assert(index < infos_.size());
+		assert(infos_[index].id == info.id);
+
+		auto &dest = infos_[index];
+		std::copy(std::begin(info.title), std::end(info.title), std::begin(dest.title));
+		std::copy(std::begin(info.shortTitle), std::end(info.shortTitle), std::begin(dest.shortTitle));
+		std::copy(std::begin(info.units), std::end(info.units), std::begin(dest.units));
+	}
+
+private:
+	static Summary MakeSummary(value_type const &info)
+	{
+		Summary summary;
+		summary.id_ = info.id;
+		summary.flags_ = info.flags;
+		summary.step_count_ = info.stepCount;
+		summary.unit_id_ = info.unitId;
+		summary.default_value_ = info.defaultNormalizedValue;
+		return summary;
+	}
+
+	void BuildIndex()
+	{
+		sorted_ids_.resize(infos_.size());
+		for(size_t i = 0; i < infos_.size(); ++i) {
+			sorted_ids_[i].id_ = infos_[i].id;
+			sorted_ids_[i].index_ = static_cast<std::uint32_t>(i);
+		}
+		std::sort(sorted_ids_.begin(), sorted_ids_.end(),
+				  [](IndexEntry const &lhs, IndexEntry const &rhs) { return lhs.id_ < rhs.id_; });
+
+		direct_table_.clear();
+		min_id_ = 0;
+		if(sorted_ids_.empty()) {
+			return;
+		}
+
+		//! IDの範囲がパラメータ数に比べて十分狭ければ、IDから直接引けるテーブルを作る
+		std::uint64_t const min_id = sorted_ids_.front().id_;
+		std::uint64_t const range = static_cast<std::uint64_t>(sorted_ids_.back().id_) - min_id + 1;
+		if(range <= sorted_ids_.size() * kMaxDirectTableRatio) {
+			min_id_ = static_cast<ParamID>(min_id);
+			direct_table_.assign(static_cast<size_t>(range), kNoIndex);
+			for(auto const &entry: sorted_ids_) {
+				direct_table_[entry.id_ - min_id_] = entry.index_;
+			}
+		}
+	}
+
+	struct IndexEntry
+	{
+		ParamID			id_;
+		std::uint32_t	index_;
+	};
+
+	static constexpr std::uint32_t kNoIndex = static_cast<std::uint32_t>(-1);
+	//! IDの範囲がパラメータ数のこの倍数以下であれば、直接引けるテーブルを使用する
+	static constexpr size_t kMaxDirectTableRatio = 4;
+
+	container								infos_;
+	std::vector<Summary>					summaries_;
+	std::unique_ptr<std::atomic<ParamValue>[]>	values_;
+	std::vector<IndexEntry>					sorted_ids_;
+	ParamID									min_id_;
+	std::vector<std::uint32_t>				direct_table_;
+};
+
+}	// ::hwm
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <vector>
 
+#include "../AllocationGuard.hpp"
 #include "../StrCnv.hpp"
 #include "../ScopeExit.hpp"
 #include "../Vst3Utils.hpp"
@@ -21,51 +22,64 @@ using namespace Steinberg;
 namespace hwm {
 
 std::unique_ptr<Vst3Plugin>
-CreatePlugin(IPluginFactory *factory, ClassInfo const &info, Vst3PluginFactory::host_context_type host_context);
+CreatePlugin(std::shared_ptr<Vst3Module> module, ClassInfo const &info, Vst3PluginFactory::host_context_type host_context);
 
-Vst3Plugin::Impl::Impl(IPluginFactory *factory, ClassInfo const &info, host_context_type host_context)
-	:	edit_controller_is_created_new_(false)
+Vst3Plugin::Impl::Impl(std::shared_ptr<Vst3Module> module, ClassInfo const &info, host_context_type host_context)
+	:	module_(std::move(module))
+	,	edit_controller_is_created_new_(false)
 	,	is_editor_opened_(false)
 	,	is_processing_started_(false)
 	,	is_resumed_(false)
 	,	block_size_(2048)
 	,	sampling_rate_(44100)
+	,	process_mode_(Vst::ProcessModes::kRealtime)
+	,	symbolic_sample_size_(Vst::SymbolicSampleSizes::kSample32)
+	,	can_process_double_(false)
 	,	has_editor_(false)
 	,	current_program_index_(-1)
 	,	program_change_parameter_(-1)
+	,	program_step_count_(0)
+	,	pending_program_sync_(-1)
+	,	program_changes_(kProgramChangeQueueCapacity)
+	,	last_program_value_(-1)
 	,	status_(Status::kInvalid)
+	,	event_queue_(kEventQueueCapacity)
+	,	num_dropped_events_(0)
+	,	unlisted_param_changes_(kUnlistedParameterQueueCapacity)
+	,	unlisted_output_changes_(kUnlistedParameterQueueCapacity)
+	,	param_batch_inbox_(kParameterBatchQueueCapacity)
+	,	param_batch_outbox_(kParameterBatchQueueCapacity * 2)
+	,	automation_inbox_(kAutomationQueueCapacity)
+	,	automation_outbox_(kAutomationQueueCapacity * 2)
+	,	input_event_list_(kMaxEventsPerBlock)
+	,	output_event_list_(kMaxEventsPerBlock)
+	,	process_context_()
+	,	test_wavetable_pos_(0)
+	,	input_source_inbox_(kInputSourceQueueCapacity)
+	,	input_source_outbox_(kInputSourceQueueCapacity)
+	,	output_tap_inbox_(kOutputTapQueueCapacity)
+	,	output_tap_outbox_(kOutputTapQueueCapacity)
 {
-	LoadPlugin(factory, info, std::move(host_context));
-
-	size_t const sampling_rate = 44100;
-	size_t const length = sampling_rate * 2;
-	double const rad = 2 * 3.141592653589793;
-	double const amp = 2 / 3.141592653589793 * 0.125;
-
-	wave_data_.resize(length);
-	double const head_freq = 440;
-	double const last_freq = 220;
-	double const freq_angle = (last_freq - head_freq) / length;
-
-	double current_freq = head_freq;
-	double pos = 0;
-
-	for(size_t i = 0; i < length; ++i) {
-		for(int k = 1; k <= 30; ++k) {
-			wave_data_[i] += sin(rad * k * pos) / (double)(k);
-		}
-		wave_data_[i] *= amp;
-			
-		double const progress = current_freq / sampling_rate;
-		pos += progress;
-		current_freq += freq_angle;
-	}
-	wave_data_index_ = 0;
+	LoadPlugin(module_->GetFactory(), info, std::move(host_context));
 }
 
 Vst3Plugin::Impl::~Impl()
 {
 	UnloadPlugin();
+
+	AutomationSet *automation;
+	while(automation_inbox_.pop(automation)) {
+		delete automation;
+	}
+	CollectAutomation();
+
+	ParameterBatch *batch;
+	while(param_batch_inbox_.pop(batch)) {
+		delete batch;
+	}
+	while(param_batch_outbox_.pop(batch)) {
+		delete batch;
+	}
 }
 
 bool Vst3Plugin::Impl::HasEditController	() const { return edit_controller_.get() != nullptr; }
@@ -83,11 +97,64 @@ String Vst3Plugin::Impl::GetEffectName() const
 	return plugin_info_->name();
 }
 
+ClassInfo::cid_t Vst3Plugin::Impl::GetClassID() const
+{
+	ClassInfo::cid_t cid;
+	std::copy_n(plugin_info_->cid(), cid.size(), cid.begin());
+	return cid;
+}
+
 size_t Vst3Plugin::Impl::GetNumOutputs() const
 {
 	return output_buses_.GetTotalChannels();
 }
 
+size_t Vst3Plugin::Impl::GetNumInputBuses() const
+{
+	return input_buses_.GetBusCount();
+}
+
+size_t Vst3Plugin::Impl::GetNumOutputBuses() const
+{
+	return output_buses_.GetBusCount();
+}
+
+size_t Vst3Plugin::Impl::GetInputBusChannels(size_t bus_index) const
+{
+	return input_buses_.GetBus(bus_index).channels();
+}
+
+size_t Vst3Plugin::Impl::GetOutputBusChannels(size_t bus_index) const
+{
+	return output_buses_.GetBus(bus_index).channels();
+}
+
+float ** Vst3Plugin::Impl::GetOutputBusBuffers(size_t bus_index)
+{
+	return output_buses_.GetBus(bus_index).data();
+}
+
+double ** Vst3Plugin::Impl::GetOutputBusBuffers64(size_t bus_index)
+{
+	return output_buses_.GetBus(bus_index).data64();
+}
+
+void Vst3Plugin::Impl::ConnectInputBus(size_t bus_index, float ** channels)
+{
+	assert(bus_index < connected_inputs_.size());
+	connected_inputs_[bus_index] = channels;
+	connected_inputs64_[bus_index] = nullptr;
+	PrepareProcessData();
+}
+
+void Vst3Plugin::Impl::ConnectInputBus64(size_t bus_index, double ** channels)
+{
+	assert(bus_index < connected_inputs64_.size());
+	connected_inputs_[bus_index] = nullptr;
+	connected_inputs64_[bus_index] = channels;
+	PrepareProcessData();
+}
+
 bool Vst3Plugin::Impl::HasEditor() const
 {
 	assert(component_);
@@ -150,14 +217,16 @@ void Vst3Plugin::Impl::Resume()
 		Vst::ProcessSetup setup = {};
 		setup.maxSamplesPerBlock = block_size_;
 		setup.sampleRate = sampling_rate_;
-		setup.symbolicSampleSize = Vst::SymbolicSampleSizes::kSample32;
-		setup.processMode = Vst::ProcessModes::kRealtime;
+		setup.symbolicSampleSize = symbolic_sample_size_;
+		setup.processMode = process_mode_;
 
 		res = GetAudioProcessor()->setupProcessing(setup);
 		if(res != kResultOk && res != kNotImplemented) { throw std::runtime_error("setupProcessing failed"); }
 		status_ = Status::kSetupDone;
 	}
 
+	PrepareProcessData();
+
 	res = GetComponent()->setActive(true);
 	if(res != kResultOk && res != kNotImplemented) { throw std::runtime_error("setActive failed"); }
 	status_ = Status::kActivated;
@@ -197,6 +266,7 @@ void Vst3Plugin::Impl::Suspend()
 
 	GetComponent()->setActive(false);
 	status_ = Status::kSetupDone;
+	is_resumed_ = false;
 }
 
 bool Vst3Plugin::Impl::IsResumed() const
@@ -206,34 +276,137 @@ bool Vst3Plugin::Impl::IsResumed() const
 
 void Vst3Plugin::Impl::SetBlockSize(int block_size)
 {
-	input_buses_.SetBlockSize(block_size);
-	input_buses_.UpdateBufferHeads();
-	output_buses_.SetBlockSize(block_size);
-	output_buses_.UpdateBufferHeads();
+	//! バッファの容量の範囲内のブロックサイズであれば、チャンネルの先頭のポインタは変化しないので、
+	//! バッファのポインタやProcessDataを作り直す必要はない
+	bool const input_reallocated = input_buses_.SetBlockSize(block_size);
+	bool const output_reallocated = output_buses_.SetBlockSize(block_size);
 	block_size_ = block_size;
+
+	//! 次回のResumeでsetupProcessingをやり直す
+	if(status_ == Status::kSetupDone) {
+		status_ = Status::kInitialized;
+	}
+
+	if(input_reallocated || output_reallocated) {
+		input_buses_.UpdateBufferHeads();
+		output_buses_.UpdateBufferHeads();
+		PrepareProcessData();
+	}
 }
 
 void Vst3Plugin::Impl::SetSamplingRate(int sampling_rate)
 {
 	sampling_rate_ = sampling_rate;
+
+	//! 次回のResumeでsetupProcessingをやり直す
+	if(status_ == Status::kSetupDone) {
+		status_ = Status::kInitialized;
+	}
+}
+
+void Vst3Plugin::Impl::SetProcessMode(Steinberg::int32 process_mode)
+{
+	if(process_mode_ == process_mode) {
+		return;
+	}
+
+	process_mode_ = process_mode;
+
+	//! 次回のResumeでsetupProcessingをやり直す
+	if(status_ == Status::kSetupDone) {
+		status_ = Status::kInitialized;
+	}
 }
 
-void	Vst3Plugin::Impl::AddNoteOn(int note_number)
+Steinberg::int32 Vst3Plugin::Impl::GetProcessMode() const
 {
-    auto lock = std::unique_lock(note_mutex_);
-	Note note;
-	note.note_number_ = note_number;
-	note.note_state_ = Note::State::kNoteOn;
-	notes_.push_back(note);
+	return process_mode_;
 }
 
-void	Vst3Plugin::Impl::AddNoteOff(int note_number)
+bool Vst3Plugin::Impl::CanProcessDouble() const
 {
-	auto lock = std::unique_lock(note_mutex_);
-	Note note;
-	note.note_number_ = note_number;
-	note.note_state_ = Note::State::kNoteOff;
-	notes_.push_back(note);
+	return can_process_double_.get();
+}
+
+void Vst3Plugin::Impl::SetSymbolicSampleSize(Steinberg::int32 sample_size)
+{
+	if(sample_size == Vst::SymbolicSampleSizes::kSample64 && !CanProcessDouble()) {
+		throw std::runtime_error("This plugin does not support 64bit processing");
+	}
+
+	if(symbolic_sample_size_ == sample_size) {
+		return;
+	}
+
+	symbolic_sample_size_ = sample_size;
+
+	//! 使用しない方のバッファは解放して、使用する方のバッファを確保し直す
+	input_buses_.SetSampleSize(sample_size);
+	input_buses_.UpdateBufferHeads();
+	output_buses_.SetSampleSize(sample_size);
+	output_buses_.UpdateBufferHeads();
+
+	//! 接続されていたバッファは型が合わなくなるので接続を解除する
+	std::fill(connected_inputs_.begin(), connected_inputs_.end(), nullptr);
+	std::fill(connected_inputs64_.begin(), connected_inputs64_.end(), nullptr);
+
+	//! 次回のResumeでsetupProcessingをやり直す
+	if(status_ == Status::kSetupDone) {
+		status_ = Status::kInitialized;
+	}
+
+	PrepareProcessData();
+}
+
+Steinberg::int32 Vst3Plugin::Impl::GetSymbolicSampleSize() const
+{
+	return symbolic_sample_size_;
+}
+
+bool	Vst3Plugin::Impl::AddEvent(Vst::Event const &event)
+{
+	if(event_queue_.push(event)) {
+		return true;
+	}
+
+	num_dropped_events_.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+bool	Vst3Plugin::Impl::AddNoteOn(int note_number, Steinberg::int32 sample_offset, float velocity, Steinberg::int16 channel, Steinberg::int32 note_id)
+{
+	Vst::Event e = {};
+	e.busIndex = 0;
+	e.sampleOffset = sample_offset;
+	e.flags = Vst::Event::kIsLive;
+	e.type = Vst::Event::kNoteOnEvent;
+	e.noteOn.channel = channel;
+	e.noteOn.length = 0;
+	e.noteOn.pitch = note_number;
+	e.noteOn.tuning = 0;
+	e.noteOn.noteId = note_id;
+	e.noteOn.velocity = velocity;
+	return AddEvent(e);
+}
+
+bool	Vst3Plugin::Impl::AddNoteOff(int note_number, Steinberg::int32 sample_offset, float velocity, Steinberg::int16 channel, Steinberg::int32 note_id)
+{
+	Vst::Event e = {};
+	e.busIndex = 0;
+	e.sampleOffset = sample_offset;
+	e.flags = Vst::Event::kIsLive;
+	e.type = Vst::Event::kNoteOffEvent;
+	e.noteOff.channel = channel;
+	e.noteOff.pitch = note_number;
+	e.noteOff.tuning = 0;
+	e.noteOff.noteId = note_id;
+	e.noteOff.velocity = velocity;
+	return AddEvent(e);
+}
+
+size_t	Vst3Plugin::Impl::GetNumDroppedEvents() const
+{
+	return num_dropped_events_.load(std::memory_order_relaxed);
 }
 
 size_t	Vst3Plugin::Impl::GetProgramCount() const
@@ -243,7 +416,14 @@ size_t	Vst3Plugin::Impl::GetProgramCount() const
 
 String Vst3Plugin::Impl::GetProgramName(size_t index) const
 {
-	return programs_[index].name_;
+	auto const &program = programs_[index];
+	std::lock_guard<std::mutex> lock(program_names_mutex_);
+	if(!program.name_) {
+		Steinberg::Vst::String128 name_buf = {};
+		unit_info_->getProgramName(program.list_id_, program.index_, name_buf);
+		program.name_ = hwm::to_wstr(name_buf);
+	}
+	return *program.name_;
 }
 
 /*!
@@ -256,24 +436,17 @@ String Vst3Plugin::Impl::GetProgramName(size_t index) const
 	上記の通りGetProgramCount()-1はstepCountと異なることがあり、WavesのプラグインでProgramIndexの指定がずれてしまうため、
 	ちゃんとstepCountを元に変換して、どちらのプラグインでも対応できるようにした。
 	IEditControllerのnormalizedParamToPlainを使用してもいいかもしれない。
+	変換に使用するステップ数は、PrepareProgramListでprogram_step_count_に求めておく。
 */
 Vst::ParamValue
 	Vst3Plugin::Impl::NormalizeProgramIndex(size_t index) const
 {
-	int step_count =
-		(parameter_for_program_ != -1)
-		?	parameters_.GetInfoByID(parameter_for_program_).stepCount
-		:	GetProgramCount() - 1;
-
-	return index / static_cast<Vst::ParamValue>(step_count);
+	return program_values_[index];
 }
 
 size_t Vst3Plugin::Impl::DiscretizeProgramIndex(Vst::ParamValue value) const
 {
-	int step_count =
-		(parameter_for_program_ != -1)
-		?	parameters_.GetInfoByID(parameter_for_program_).stepCount
-		:	GetProgramCount() - 1;
+	int const step_count = program_step_count_;
 
 	return static_cast<size_t>(
 		floor(std::min<Vst::ParamValue>(step_count, value * (step_count + 1)))
@@ -282,45 +455,69 @@ size_t Vst3Plugin::Impl::DiscretizeProgramIndex(Vst::ParamValue value) const
 
 size_t	Vst3Plugin::Impl::GetProgramIndex() const
 {
-	return current_program_index_;
+	return current_program_index_.load(std::memory_order_relaxed);
 }
 
 void	Vst3Plugin::Impl::SetProgramIndex(size_t index)
 {
-	if(parameter_for_program_ == -1) {
-		//nothing to do
-	} else {
-		current_program_index_ = 
-			DiscretizeProgramIndex(GetEditController()->getParamNormalized(parameter_for_program_));
-	}
-
-	if(index == current_program_index_) {
+	//! エディタなどでコントローラ側から変更されたプログラムは、
+	//! PerformEditとOnIdleでcurrent_program_index_に反映されている
+	if(index == GetProgramIndex()) {
 		return;
 	}
 
-	current_program_index_ = index;
+	param_value_changes_was_specified_ = false;
 
-	auto const &program = programs_[current_program_index_];
-	auto const normalized = NormalizeProgramIndex(current_program_index_);
+	AddProgramChange(index, 0);
+}
 
-	param_value_changes_was_specified_ = false;
+bool	Vst3Plugin::Impl::AddProgramChange(size_t index, Steinberg::int32 sample_offset)
+{
+	if(index >= program_values_.size()) {
+		return false;
+	}
 
-	//! `Controller`側、`Processor`側それぞれのコンポーネントにプログラム変更を通知
-	if(parameter_for_program_ == -1) {
-		GetEditController()->setParamNormalized(program.list_id_, normalized);
-		EnqueueParameterChange(program.list_id_, normalized);
-	} else {
-		GetEditController()->setParamNormalized(parameter_for_program_, normalized);
-		EnqueueParameterChange(parameter_for_program_, normalized);
+	//! `Processor`側にはサンプル単位の位置で通知し、`Controller`側へはOnIdleで反映する。
+	//! パラメータのスロットと違って変更をまとめないので、1ブロック内の複数の変更もそれぞれの位置で送信される。
+	ProgramChange change;
+	change.index_ = static_cast<Steinberg::int32>(index);
+	change.sample_offset_ = sample_offset;
+	if(!program_changes_.push(change)) {
+		return false;
+	}
+
+	current_program_index_.store(change.index_, std::memory_order_relaxed);
+	parameters_.SetValueByID(program_change_parameter_, program_values_[index]);
+	pending_program_sync_.store(change.index_, std::memory_order_release);
+	return true;
+}
+
+void	Vst3Plugin::Impl::UpdateProgramIndex(Vst::ParamID id, Vst::ParamValue value)
+{
+	if(id == program_change_parameter_ && !program_values_.empty()) {
+		current_program_index_.store(static_cast<Steinberg::int32>(DiscretizeProgramIndex(value)),
+									 std::memory_order_relaxed);
 	}
 }
 
 void Vst3Plugin::Impl::RestartComponent(Steinberg::int32 flags)
 {
 	//! `Controller`側のパラメータが変更された
-	if((flags & Vst::RestartFlags::kParamValuesChanged)) {
-
-		// nothing to do
+	if((flags & (Vst::RestartFlags::kParamValuesChanged | Vst::RestartFlags::kParamTitlesChanged))) {
+
+		RefreshParameterValues();
+
+		if((flags & Vst::RestartFlags::kParamTitlesChanged)) {
+			//! パラメータの数やIDは変わらないものとして、表示用の情報だけを取得し直す
+			for(size_t i = 0; i < parameters_.size(); ++i) {
+				Vst::ParameterInfo info = {};
+				if(edit_controller_->getParameterInfo(i, info) == kResultOk &&
+				   info.id == parameters_.GetSummary(i).id_)
+				{
+					parameters_.UpdateDisplayInfo(i, info);
+				}
+			}
+		}
 
 	} else if((flags & Vst::RestartFlags::kReloadComponent)) {
 
@@ -340,91 +537,491 @@ void Vst3Plugin::Impl::RestartComponent(Steinberg::int32 flags)
 	}
 }
 
+namespace {
+
+	std::vector<char> StreamToBytes(MemoryStream &stream)
+	{
+		char const *data = stream.getData();
+		return std::vector<char>(data, data + stream.getSize());
+	}
+
+}	// unnamed
+
+Vst3Plugin::StateData
+		Vst3Plugin::Impl::GetState() const
+{
+	StateData state;
+
+	MemoryStream component_stream;
+	if(component_->getState(&component_stream) == kResultOk) {
+		state.component_ = StreamToBytes(component_stream);
+	}
+
+	if(edit_controller_) {
+		MemoryStream controller_stream;
+		if(edit_controller_->getState(&controller_stream) == kResultOk) {
+			state.controller_ = StreamToBytes(controller_stream);
+		}
+	}
+
+	return state;
+}
+
+void Vst3Plugin::Impl::SetState(StateData const &state)
+{
+	if(!state.component_.empty()) {
+		MemoryStream stream(const_cast<char *>(state.component_.data()), state.component_.size());
+		if(component_->setState(&stream) != kResultOk) {
+			throw std::runtime_error("failed to restore the component state");
+		}
+
+		//! Controller側にもComponentの状態を反映する
+		if(edit_controller_) {
+			stream.seek(0, IBStream::kIBSeekSet, 0);
+			edit_controller_->setComponentState(&stream);
+		}
+	}
+
+	if(edit_controller_ && !state.controller_.empty()) {
+		MemoryStream stream(const_cast<char *>(state.controller_.data()), state.controller_.size());
+		edit_controller_->setState(&stream);
+	}
+
+	RefreshParameterValues();
+}
+
 float ** Vst3Plugin::Impl::ProcessAudio(size_t frame_pos, size_t duration)
 {
-	ClassInfo &cinfo = *plugin_info_;
-	double const tempo = 120.0;
-	double beat_per_second = tempo / 60.0;
-	Vst::ProcessContext process_context = {};
-	process_context.sampleRate = sampling_rate_;
-	process_context.projectTimeSamples = frame_pos;
-	process_context.projectTimeMusic = frame_pos / 44100.0 * beat_per_second;
-	process_context.tempo = tempo;
-	process_context.timeSigDenominator = 4;
-	process_context.timeSigNumerator = 4;
+	assert(symbolic_sample_size_ == Vst::SymbolicSampleSizes::kSample32);
+	ProcessAudioImpl(frame_pos, duration);
+	return output_buses_.data();
+}
 
-	process_context.state =
-		Vst::ProcessContext::StatesAndFlags::kPlaying |
-		Vst::ProcessContext::StatesAndFlags::kProjectTimeMusicValid |
-		Vst::ProcessContext::StatesAndFlags::kTempoValid |
-		Vst::ProcessContext::StatesAndFlags::kTimeSigValid;
+double ** Vst3Plugin::Impl::ProcessAudio64(size_t frame_pos, size_t duration)
+{
+	assert(symbolic_sample_size_ == Vst::SymbolicSampleSizes::kSample64);
+	ProcessAudioImpl(frame_pos, duration);
+	return output_buses_.data64();
+}
 
-	Vst::EventList input_event_list;
-	Vst::EventList output_event_list;
-	{
-        auto lock = std::unique_lock(note_mutex_);
-		for(auto &note: notes_) {
-			Vst::Event e;
-			e.busIndex = 0;
-			e.sampleOffset = 0;
-			e.ppqPosition = process_context.projectTimeMusic;
-			e.flags = Vst::Event::kIsLive;
-			if(note.note_state_ == Note::kNoteOn) {
-				e.type = Vst::Event::kNoteOnEvent;
-				e.noteOn.channel = 0;
-				e.noteOn.length = 0;
-				e.noteOn.pitch = note.note_number_;
-				e.noteOn.tuning = 0;
-				e.noteOn.noteId = -1;
-				e.noteOn.velocity = 100 / 127.0;
-			} else if(note.note_state_ == Note::kNoteOff) {
-				e.type = Vst::Event::kNoteOffEvent;
-				e.noteOff.channel = 0;
-				e.noteOff.pitch = note.note_number_;
-				e.noteOff.tuning = 0;
-				e.noteOff.noteId = -1;
-				e.noteOff.velocity = 100 / 127.0;
-			} else {
-				continue;
+void Vst3Plugin::Impl::ProcessAudioInto(size_t frame_pos, size_t duration, float ** outputs)
+{
+	assert(symbolic_sample_size_ == Vst::SymbolicSampleSizes::kSample32);
+
+	//! 出力バスのバッファをこのブロックの間だけ外部のバッファに差し替える。
+	//! ポインタの付け替えだけなので、メモリ確保は発生しない。
+	size_t channel_index = 0;
+	for(auto &bus_buffers: output_bus_buffers_) {
+		bus_buffers.channelBuffers32 = outputs + channel_index;
+		channel_index += bus_buffers.numChannels;
+	}
+
+	ProcessAudioImpl(frame_pos, duration);
+
+	for(size_t i = 0; i < output_bus_buffers_.size(); ++i) {
+		output_bus_buffers_[i].channelBuffers32 = output_buses_.GetBus(i).data();
+	}
+}
+
+void Vst3Plugin::Impl::SetInputSource(size_t bus_index, std::shared_ptr<InputSource> source)
+{
+	assert(bus_index < input_buses_.GetBusCount());
+
+	CollectInputSources();
+
+	if(!input_source_inbox_.push(InputSourceChange { bus_index, std::move(source) })) {
+		throw std::runtime_error("input source queue is full");
+	}
+}
+
+void Vst3Plugin::Impl::SetOutputTap(std::shared_ptr<AudioTap> tap)
+{
+	assert(!tap || tap->GetNumChannels() == output_buses_.GetTotalChannels());
+
+	CollectOutputTaps();
+
+	if(!output_tap_inbox_.push(std::move(tap))) {
+		throw std::runtime_error("output tap queue is full");
+	}
+}
+
+void Vst3Plugin::Impl::ReceiveInputSources()
+{
+	//! 返却用のキューに空きがある間だけ受け取る。残りは次のブロックで受け取る。
+	InputSourceChange change;
+	while(!input_source_outbox_.full() && input_source_inbox_.pop(change)) {
+		//! 受け渡しの間にバスの構成が変わった場合は、そのソースを使用せずに返却する
+		if(change.bus_index_ < input_sources_.size()) {
+			std::swap(input_sources_[change.bus_index_], change.source_);
+		}
+		bool const pushed = input_source_outbox_.push(std::move(change));
+		assert(pushed);
+		(void)pushed;
+	}
+}
+
+void Vst3Plugin::Impl::ReceiveOutputTap()
+{
+	//! 返却用のキューに空きがある間だけ受け取る。残りは次のブロックで受け取る。
+	std::shared_ptr<AudioTap> tap;
+	while(!output_tap_outbox_.full() && output_tap_inbox_.pop(tap)) {
+		std::swap(output_tap_, tap);
+		bool const pushed = output_tap_outbox_.push(std::move(tap));
+		assert(pushed);
+		(void)pushed;
+	}
+}
+
+void Vst3Plugin::Impl::CollectInputSources()
+{
+	InputSourceChange change;
+	while(input_source_outbox_.pop(change)) {}
+}
+
+void Vst3Plugin::Impl::CollectOutputTaps()
+{
+	std::shared_ptr<AudioTap> tap;
+	while(output_tap_outbox_.pop(tap)) {}
+}
+
+void Vst3Plugin::Impl::ResetHostState()
+{
+	//! オーディオスレッドに渡されていないイベントやパラメータの変更
+	Vst::Event event;
+	while(event_queue_.pop(event)) {}
+	num_dropped_events_.store(0, std::memory_order_relaxed);
+
+	param_change_slots_.Drain([](size_t, Vst::ParamValue, Steinberg::int32) {});
+	UnlistedParameterChange unlisted_change;
+	while(unlisted_param_changes_.pop(unlisted_change)) {}
+
+	ProgramChange program_change;
+	while(program_changes_.pop(program_change)) {}
+	last_program_value_ = -1;
+	pending_program_sync_.store(-1, std::memory_order_relaxed);
+
+	//! 一括変更とモーフィング、オートメーションは、受け渡し中のものも含めて破棄する
+	ParameterBatch *batch;
+	while(param_batch_inbox_.pop(batch)) { delete batch; }
+	while(param_batch_outbox_.pop(batch)) { delete batch; }
+	morph_.reset();
+
+	AutomationSet *automation;
+	while(automation_inbox_.pop(automation)) { delete automation; }
+	CollectAutomation();
+	automation_.reset();
+
+	//! プロセッサが出力したパラメータの変更で、まだ通知していないもの
+	output_param_slots_.Drain([](size_t, Vst::ParamValue, Steinberg::int32) {});
+	OutputParameterChange output_change;
+	while(unlisted_output_changes_.pop(output_change)) {}
+	pending_output_notifications_.clear();
+	std::fill(pending_output_positions_.begin(), pending_output_positions_.end(), ParameterModel::npos);
+	output_parameter_change_handler_ = nullptr;
+
+	//! 外部のバッファや入出力のオブジェクトは、前の利用者が破棄している可能性がある
+	std::fill(connected_inputs_.begin(), connected_inputs_.end(), nullptr);
+	std::fill(connected_inputs64_.begin(), connected_inputs64_.end(), nullptr);
+	InputSourceChange input_source_change;
+	while(input_source_inbox_.pop(input_source_change)) {}
+	CollectInputSources();
+	std::fill(input_sources_.begin(), input_sources_.end(), nullptr);
+
+	std::shared_ptr<AudioTap> tap;
+	while(output_tap_inbox_.pop(tap)) {}
+	CollectOutputTaps();
+	output_tap_.reset();
+	test_wavetable_pos_ = 0;
+
+	PrepareProcessData();
+}
+
+void Vst3Plugin::Impl::SetAutomation(std::unique_ptr<AutomationSet> automation)
+{
+	CollectAutomation();
+
+	if(!automation_inbox_.push(automation.get())) {
+		throw std::runtime_error("automation queue is full");
+	}
+	automation.release();
+}
+
+void Vst3Plugin::Impl::ApplyParameters(snapshot_t const &changes)
+{
+	auto *controller = GetEditController();
+
+	std::unique_ptr<ParameterBatch> batch(new ParameterBatch());
+	batch->ids_.reserve(changes.size());
+	batch->indices_.reserve(changes.size());
+	batch->to_.reserve(changes.size());
+	for(auto const &change: changes) {
+		auto const index = parameters_.FindIndex(change.first);
+		controller->setParamNormalized(change.first, change.second);
+		if(index != ParameterModel::npos) {
+			parameters_.SetValue(index, change.second);
+		}
+
+		batch->ids_.push_back(change.first);
+		batch->indices_.push_back(index);
+		batch->to_.push_back(change.second);
+	}
+
+	SendParameterBatch(std::move(batch));
+}
+
+void Vst3Plugin::Impl::MorphParameters(snapshot_t const &from, snapshot_t const &to, size_t num_blocks)
+{
+	if(num_blocks == 0) {
+		ApplyParameters(to);
+		return;
+	}
+
+	auto sorted_from = from;
+	std::sort(sorted_from.begin(), sorted_from.end());
+
+	std::unique_ptr<ParameterBatch> batch(new ParameterBatch());
+	batch->num_blocks_ = num_blocks;
+	batch->ids_.reserve(to.size());
+	batch->indices_.reserve(to.size());
+	batch->from_.reserve(to.size());
+	batch->to_.reserve(to.size());
+	for(auto const &target: to) {
+		auto const index = parameters_.FindIndex(target.first);
+
+		Vst::ParamValue start_value;
+		auto found = std::lower_bound(sorted_from.begin(), sorted_from.end(), target.first,
+									  [](snapshot_t::value_type const &entry, Vst::ParamID id) { return entry.first < id; });
+		if(found != sorted_from.end() && found->first == target.first) {
+			start_value = found->second;
+		} else if(index != ParameterModel::npos) {
+			start_value = parameters_.GetValue(index);
+		} else {
+			start_value = target.second;
+		}
+
+		batch->ids_.push_back(target.first);
+		batch->indices_.push_back(index);
+		batch->from_.push_back(start_value);
+		batch->to_.push_back(target.second);
+	}
+
+	SendParameterBatch(std::move(batch));
+}
+
+void Vst3Plugin::Impl::SendParameterBatch(std::unique_ptr<ParameterBatch> batch)
+{
+	CollectParameterBatches();
+
+	if(!param_batch_inbox_.push(batch.get())) {
+		throw std::runtime_error("parameter batch queue is full");
+	}
+	batch.release();
+}
+
+void Vst3Plugin::Impl::CollectParameterBatches()
+{
+	auto *controller = GetEditController();
+
+	ParameterBatch *returned;
+	while(param_batch_outbox_.pop(returned)) {
+		std::unique_ptr<ParameterBatch> batch(returned);
+		//! 即時の変更は送信時に反映済み。開始前に置き換えられたモーフィングは何も変更していない。
+		if(!batch->IsMorph() || batch->position_ == 0) {
+			continue;
+		}
+
+		for(size_t i = 0; i < batch->size(); ++i) {
+			auto const value = batch->GetValueAt(i, static_cast<double>(batch->position_) / batch->num_blocks_);
+			controller->setParamNormalized(batch->ids_[i], value);
+			if(batch->indices_[i] != ParameterModel::npos) {
+				parameters_.SetValue(batch->indices_[i], value);
 			}
-			input_event_list.addEvent(e);
 		}
-		notes_.clear();
 	}
+}
 
-	std::vector<Vst::AudioBusBuffers> inputs(input_buses_.GetBusCount());
+void Vst3Plugin::Impl::OnIdle()
+{
+	CollectParameterBatches();
+
+	auto *controller = GetEditController();
+
+	//! AddProgramChangeで送信したプログラム変更のうち、最後のものだけをコントローラに反映する
+	auto const program_index = pending_program_sync_.exchange(-1, std::memory_order_acquire);
+	if(program_index != -1) {
+		controller->setParamNormalized(program_change_parameter_, program_values_[program_index]);
+	}
+
+	output_param_slots_.Drain([&](size_t index, Vst::ParamValue value, Steinberg::int32 /*sample_offset*/) {
+		auto const id = parameters_.GetSummary(index).id_;
+		controller->setParamNormalized(id, value);
+		UpdateProgramIndex(id, value);
+		AddOutputNotification(index, id, value);
+	});
+
+	OutputParameterChange change;
+	while(unlisted_output_changes_.pop(change)) {
+		controller->setParamNormalized(change.id_, change.value_);
+		UpdateProgramIndex(change.id_, change.value_);
+		AddOutputNotification(ParameterModel::npos, change.id_, change.value_);
+	}
+
+	if(pending_output_notifications_.empty()) {
+		return;
+	}
+
+	//! メーターのように頻繁に変化するパラメータでUIの更新が詰まらないように、通知の頻度を制限する
+	auto const now = std::chrono::steady_clock::now();
+	if(output_parameter_change_handler_ && now - last_output_notification_ < kOutputNotificationInterval) {
+		return;
+	}
+	last_output_notification_ = now;
+
+	for(auto const &notification: pending_output_notifications_) {
+		if(output_parameter_change_handler_) {
+			output_parameter_change_handler_(notification.id_, notification.value_);
+		}
+		if(notification.index_ != ParameterModel::npos) {
+			pending_output_positions_[notification.index_] = ParameterModel::npos;
+		}
+	}
+	pending_output_notifications_.clear();
+}
+
+void Vst3Plugin::Impl::AddOutputNotification(size_t index, Vst::ParamID id, Vst::ParamValue value)
+{
+	if(index != ParameterModel::npos) {
+		auto &position = pending_output_positions_[index];
+		if(position != ParameterModel::npos) {
+			pending_output_notifications_[position].value_ = value;
+			return;
+		}
+		position = pending_output_notifications_.size();
+	} else {
+		auto found = std::find_if(pending_output_notifications_.begin(),
+								  pending_output_notifications_.end(),
+								  [id](PendingOutputNotification const &n) { return n.id_ == id; });
+		if(found != pending_output_notifications_.end()) {
+			found->value_ = value;
+			return;
+		}
+	}
+
+	pending_output_notifications_.push_back(PendingOutputNotification { index, id, value });
+}
+
+void Vst3Plugin::Impl::SetOutputParameterChangeHandler(output_parameter_change_handler_t handler)
+{
+	output_parameter_change_handler_ = std::move(handler);
+}
+
+void Vst3Plugin::Impl::CollectAutomation()
+{
+	AutomationSet *automation;
+	while(automation_outbox_.pop(automation)) {
+		delete automation;
+	}
+}
+
+template<class SampleType>
+void Vst3Plugin::Impl::FillTestSignal(SampleType ** channels, size_t num_channels, size_t duration)
+{
+	if(num_channels == 0 || !test_wavetable_) {
+		return;
+	}
+
+	size_t next_pos = test_wavetable_pos_;
+	for(size_t ch = 0; ch < num_channels; ++ch) {
+		next_pos = test_wavetable_->Read(test_wavetable_pos_, channels[ch], duration);
+	}
+	test_wavetable_pos_ = next_pos;
+}
+
+void Vst3Plugin::Impl::ProcessAudioImpl(size_t frame_pos, size_t duration)
+{
+	//! デバッグビルドでは、このスコープ内でヒープ確保が行われるとassertする
+	HWM_ASSERT_NO_ALLOCATION();
+
+	assert(duration <= static_cast<size_t>(block_size_));
+
+	auto &process_context = process_context_;
+	double const beat_per_second = process_context.tempo / 60.0;
+	process_context.projectTimeSamples = frame_pos;
+	process_context.projectTimeMusic = frame_pos / 44100.0 * beat_per_second;
+
+	auto &input_event_list = input_event_list_;
+	auto &output_event_list = output_event_list_;
+	input_event_list.clear();
+	output_event_list.clear();
+
+	//! イベントリストが一杯になった場合、残りのイベントは次回のProcessAudioで処理する
+	Vst::Event e;
+	while(input_event_list.getEventCount() < kMaxEventsPerBlock && event_queue_.pop(e)) {
+		//! このブロックの範囲外を指すイベントは、ブロックの最後のサンプルで処理する
+		e.sampleOffset = std::max<Steinberg::int32>(0, std::min<Steinberg::int32>(e.sampleOffset, duration - 1));
+		e.ppqPosition = process_context.projectTimeMusic;
+		input_event_list.addEvent(e);
+	}
+
+	bool const is_double = (symbolic_sample_size_ == Vst::SymbolicSampleSizes::kSample64);
+
+	ReceiveInputSources();
+	ReceiveOutputTap();
+
+	auto &inputs = input_bus_buffers_;
 	for(size_t i = 0; i < inputs.size(); ++i) {
-		inputs[i].channelBuffers32 = input_buses_.GetBus(i).data();
-		inputs[i].numChannels = input_buses_.GetBus(i).channels();
-		inputs[i].silenceFlags = false;
+		if(connected_inputs_[i] || connected_inputs64_[i]) {
+			continue;
+		}
 
-		if(inputs[i].numChannels != 0) {
-			for(int ch = 0; ch < inputs[i].numChannels; ++ch) {
-				for(int smp = 0; smp < duration; ++smp) {
-					inputs[i].channelBuffers32[ch][smp] = 
-						wave_data_[(wave_data_index_ + smp) % (int)process_context.sampleRate];
-				}
+		//! 前のブロックでReadInPlaceのバッファに差し替えていた場合のために、内部のバッファに戻しておく。
+		//! そのバッファは前のブロックの間だけ有効なので、ソースが外された場合にも使用してはならない。
+		if(!is_double) {
+			inputs[i].channelBuffers32 = input_buses_.GetBus(i).data();
+		}
+
+		auto *source = input_sources_[i].get();
+		size_t const num_channels = inputs[i].numChannels;
+
+		if(!source) {
+			if(is_double) {
+				FillTestSignal(inputs[i].channelBuffers64, num_channels, duration);
+			} else {
+				FillTestSignal(inputs[i].channelBuffers32, num_channels, duration);
+			}
+		} else if(is_double) {
+			source->Read(input_source_buffer_.data(), num_channels, duration);
+			for(size_t ch = 0; ch < num_channels; ++ch) {
+				std::copy_n(input_source_buffer_.data()[ch], duration, inputs[i].channelBuffers64[ch]);
+			}
+		} else {
+			//! ソースが直接参照できるバッファを持っていれば、コピーせずにそのまま渡す。
+			//! プラグインは入力バッファに書き込まないので、constを外してもよい。
+			if(auto direct = source->ReadInPlace(num_channels, duration)) {
+				inputs[i].channelBuffers32 = const_cast<float **>(direct);
+			} else {
+				source->Read(inputs[i].channelBuffers32, num_channels, duration);
 			}
-			wave_data_index_ = (wave_data_index_ + duration) % (int)process_context.sampleRate;
 		}
 	}
 
-	std::vector<Vst::AudioBusBuffers> outputs(output_buses_.GetBusCount());
-	for(size_t i = 0; i < outputs.size(); ++i) {
-		outputs[i].channelBuffers32 = output_buses_.GetBus(i).data();
-		outputs[i].numChannels = output_buses_.GetBus(i).channels();
-		outputs[i].silenceFlags = false;
-	}
+	auto &outputs = output_bus_buffers_;
 
 	input_changes_.clearQueue();
 	output_changes_.clearQueue();
 
-	TakeParameterChanges(input_changes_);
+	TakeParameterChanges(input_changes_, duration);
+
+	ReceiveParameterBatches(input_changes_);
+	RenderMorph(input_changes_, duration);
+
+	ReceiveAutomation();
+	RenderAutomation(input_changes_, frame_pos, duration);
 
 	Vst::ProcessData process_data;
 	process_data.processContext = &process_context;
-	process_data.processMode = Vst::ProcessModes::kRealtime;
-	process_data.symbolicSampleSize = Vst::SymbolicSampleSizes::kSample32;
+	process_data.processMode = process_mode_;
+	process_data.symbolicSampleSize = symbolic_sample_size_;
 	process_data.numSamples = duration;
 	process_data.numInputs = inputs.size();
 	process_data.numOutputs = outputs.size();
@@ -435,58 +1032,397 @@ float ** Vst3Plugin::Impl::ProcessAudio(size_t frame_pos, size_t duration)
 	process_data.inputParameterChanges = &input_changes_;
 	process_data.outputParameterChanges = &output_changes_;
 
-	GetAudioProcessor()->process(process_data);
+	{
+		//! プラグイン内部でのメモリ確保はプラグイン側の責任なので、ここではチェックしない
+		HWM_ALLOW_ALLOCATION();
+		GetAudioProcessor()->process(process_data);
+	}
+
+	if(output_meter_ || output_tap_) {
+		//! メーターとタップはfloatのサンプルを受け取るので、64bitで処理している場合は作業用のバッファに変換して渡す
+		bool const write_tap = output_tap_ && output_tap_->BeginWrite(duration);
+		size_t first_channel = 0;
+		for(auto const &bus_buffers: outputs) {
+			float **channels = bus_buffers.channelBuffers32;
+			if(is_double) {
+				channels = output_convert_buffer_.data();
+				for(int ch = 0; ch < bus_buffers.numChannels; ++ch) {
+					std::copy_n(bus_buffers.channelBuffers64[ch], duration, channels[ch]);
+				}
+			}
+
+			if(output_meter_) {
+				output_meter_->SetSamples(first_channel, channels, bus_buffers.numChannels, duration);
+			}
+			if(write_tap) {
+				output_tap_->WriteChannels(first_channel, channels, bus_buffers.numChannels);
+			}
+			first_channel += bus_buffers.numChannels;
+		}
 
+		if(output_meter_) {
+			output_meter_->Publish();
+		}
+		if(output_tap_) {
+			output_tap_->EndWrite();
+		}
+	}
+
+	//! 出力パラメータの変更はブロックの最後の値だけを値のミラーに反映して、OnIdleでコントローラに渡す
 	for(int i = 0; i < output_changes_.getParameterCount(); ++i) {
 		auto *queue = output_changes_.getParameterData(i);
-		if(queue && queue->getPointCount() > 0) {
-			hwm::dout << "Output parameter count [" << i << "] : " << queue->getPointCount() << std::endl;
+		if(!queue || queue->getPointCount() == 0) {
+			continue;
+		}
+
+		Steinberg::int32 sample_offset;
+		Vst::ParamValue value;
+		if(queue->getPoint(queue->getPointCount() - 1, sample_offset, value) != kResultOk) {
+			continue;
+		}
+
+		auto const id = queue->getParameterId();
+		auto const index = parameters_.FindIndex(id);
+		if(index != ParameterModel::npos) {
+			parameters_.SetValue(index, value);
+			output_param_slots_.Set(index, value, sample_offset);
+		} else {
+			unlisted_output_changes_.push(OutputParameterChange { id, value });
 		}
 	}
+}
 
-	return output_buses_.data();
+void Vst3Plugin::Impl::PrepareProcessData()
+{
+	connected_inputs_.resize(input_buses_.GetBusCount());
+	connected_inputs64_.resize(input_buses_.GetBusCount());
+	input_sources_.resize(input_buses_.GetBusCount());
+
+	size_t max_input_channels = 0;
+	for(size_t i = 0; i < input_buses_.GetBusCount(); ++i) {
+		max_input_channels = std::max(max_input_channels, input_buses_.GetBus(i).channels());
+	}
+	input_source_buffer_.resize(max_input_channels, block_size_);
+
+	bool const is_double = (symbolic_sample_size_ == Vst::SymbolicSampleSizes::kSample64);
+
+	size_t max_output_channels = 0;
+	if(is_double) {
+		for(size_t i = 0; i < output_buses_.GetBusCount(); ++i) {
+			max_output_channels = std::max(max_output_channels, output_buses_.GetBus(i).channels());
+		}
+	}
+	output_convert_buffer_.resize(max_output_channels, block_size_);
+
+	std::vector<Vst::AudioBusBuffers> inputs(input_buses_.GetBusCount());
+	for(size_t i = 0; i < inputs.size(); ++i) {
+		if(is_double) {
+			inputs[i].channelBuffers64 =
+				connected_inputs64_[i] ? connected_inputs64_[i] : input_buses_.GetBus(i).data64();
+		} else {
+			inputs[i].channelBuffers32 =
+				connected_inputs_[i] ? connected_inputs_[i] : input_buses_.GetBus(i).data();
+		}
+		inputs[i].numChannels = input_buses_.GetBus(i).channels();
+		inputs[i].silenceFlags = false;
+	}
+
+	std::vector<Vst::AudioBusBuffers> outputs(output_buses_.GetBusCount());
+	for(size_t i = 0; i < outputs.size(); ++i) {
+		if(is_double) {
+			outputs[i].channelBuffers64 = output_buses_.GetBus(i).data64();
+		} else {
+			outputs[i].channelBuffers32 = output_buses_.GetBus(i).data();
+		}
+		outputs[i].numChannels = output_buses_.GetBus(i).channels();
+		outputs[i].silenceFlags = false;
+	}
+
+	input_bus_buffers_.swap(inputs);
+	output_bus_buffers_.swap(outputs);
+
+	size_t const num_output_channels = output_buses_.GetTotalChannels();
+	if(!output_meter_ ||
+	   output_meter_->GetNumChannels() != num_output_channels ||
+	   output_meter_->GetSamplingRate() != static_cast<size_t>(sampling_rate_))
+	{
+		output_meter_.reset(new PeakMeterBank(num_output_channels, sampling_rate_));
+	}
+
+	Vst::ProcessContext process_context = {};
+	process_context.sampleRate = sampling_rate_;
+	process_context.tempo = 120.0;
+	process_context.timeSigDenominator = 4;
+	process_context.timeSigNumerator = 4;
+
+	process_context.state =
+		Vst::ProcessContext::StatesAndFlags::kPlaying |
+		Vst::ProcessContext::StatesAndFlags::kProjectTimeMusicValid |
+		Vst::ProcessContext::StatesAndFlags::kTempoValid |
+		Vst::ProcessContext::StatesAndFlags::kTimeSigValid;
+
+	process_context_ = process_context;
+
+	//! テスト用の信号のテーブルはサンプリングレートごとに共有されているので、
+	//! 同じサンプリングレートのプラグインを複数作成しても、生成は一度しか行われない
+	if(!test_wavetable_ || test_wavetable_->GetSamplingRate() != static_cast<size_t>(sampling_rate_)) {
+		test_wavetable_ = TestWavetable::Get(TestWaveform::kSawSweep, sampling_rate_);
+		test_wavetable_pos_ = 0;
+	}
+}
+
+//! どのスレッドから呼び出してもよい。TakeParameterChangesとの呼び出しもスレッドセーフ
+void Vst3Plugin::Impl::EnqueueParameterChange(Vst::ParamID id, Vst::ParamValue value, Steinberg::int32 sample_offset)
+{
+	auto const index = parameters_.FindIndex(id);
+	if(index != ParameterModel::npos) {
+		param_change_slots_.Set(index, value, sample_offset);
+		return;
+	}
+
+	UnlistedParameterChange change;
+	change.id_ = id;
+	change.value_ = value;
+	change.sample_offset_ = sample_offset;
+	//! キューが一杯の場合は変更を破棄する。
+	//! リアルタイムスレッドから呼び出されてもブロックしないように、ここではログを出力しない。
+	unlisted_param_changes_.push(change);
 }
 
-//! TakeParameterChangesとの呼び出しはスレッドセーフ
-void Vst3Plugin::Impl::EnqueueParameterChange(Vst::ParamID id, Vst::ParamValue value)
+//! 同じIDに点を追加する処理の、1ブロックあたりの点の数の合計。
+//! param_change_slots_(1点)、ParameterBatch(オフセット0の1点)、モーフィング(2点)、オートメーション、
+//! プログラム変更(1つの変更につき2点)。
+//! unlisted_param_changes_の点の数は制限できないので、AddPointで上限を超えないようにする。
+static_assert(1 + 1 + 2 + Vst3Plugin::Impl::kMaxAutomationPointsPerBlock
+			  + 2 * Vst3Plugin::Impl::kMaxProgramChangesPerBlock
+			  <= Vst3Plugin::Impl::kMaxParameterPointsPerBlock,
+			  "parameter points per block may exceed the reserved capacity");
+
+void Vst3Plugin::Impl::ReserveParameterPoints()
 {
-	auto lock = std::unique_lock(parameter_queue_mutex_);
-	Steinberg::int32 parameter_index = 0;
-	param_changes_queue_.addParameterData(id, parameter_index);
-	auto *queue = param_changes_queue_.getParameterData(parameter_index);
-	Steinberg::int32 point_index = 0;
-	queue->addPoint(0, value, point_index);
+	//! 使用中のキューの数を増やしながら、それぞれのキューに点を追加して領域を確保する。
+	//! clearQueueの後もキューの領域は解放されない。
+	auto reserve = [](Vst::ParameterChanges &changes, size_t num_queues) {
+		changes.clearQueue();
+		for(size_t i = 0; i < num_queues; ++i) {
+			Steinberg::int32 queue_index;
+			auto *queue = changes.addParameterData(static_cast<Vst::ParamID>(i), queue_index);
+			if(!queue) {
+				break;
+			}
+			for(size_t j = 0; j < kMaxParameterPointsPerBlock; ++j) {
+				Steinberg::int32 point_index;
+				queue->addPoint(static_cast<Steinberg::int32>(j), 0.0, point_index);
+			}
+		}
+		changes.clearQueue();
+	};
+
+	reserve(input_changes_, parameters_.size() + kUnlistedParameterQueueCapacity);
+	reserve(output_changes_, parameters_.size());
+}
+
+void Vst3Plugin::Impl::AddPoint(Vst::IParamValueQueue &queue, Steinberg::int32 sample_offset, Vst::ParamValue value)
+{
+	auto const num_points = queue.getPointCount();
+	if(num_points >= static_cast<Steinberg::int32>(kMaxParameterPointsPerBlock)) {
+		Steinberg::int32 last_offset;
+		Vst::ParamValue last_value;
+		queue.getPoint(num_points - 1, last_offset, last_value);
+		if(sample_offset < last_offset) {
+			return;
+		}
+		//! ブロックの終わりの値が正しくなるように、最後の点を新しい値で置き換える
+		sample_offset = last_offset;
+	}
+
+	Steinberg::int32 point_index;
+	queue.addPoint(sample_offset, value, point_index);
 }
 
 //! EnqueueParameterChangeとの呼び出しはスレッドセーフ
-void Vst3Plugin::Impl::TakeParameterChanges(Vst::ParameterChanges &dest)
+void Vst3Plugin::Impl::TakeParameterChanges(Vst::ParameterChanges &dest, Steinberg::int32 num_samples)
 {
-	auto lock = std::unique_lock(parameter_queue_mutex_);
+	auto add_point = [&dest, num_samples](Vst::ParamID id, Vst::ParamValue value, Steinberg::int32 sample_offset) {
+		Steinberg::int32 index;
+		auto *dest_queue = dest.addParameterData(id, index);
+		if(!dest_queue) {
+			return;
+		}
+
+		sample_offset = std::max<Steinberg::int32>(0, std::min<Steinberg::int32>(sample_offset, num_samples - 1));
+		AddPoint(*dest_queue, sample_offset, value);
+	};
+
+	param_change_slots_.Drain([&](size_t index, Vst::ParamValue value, Steinberg::int32 sample_offset) {
+		add_point(parameters_.GetSummary(index).id_, value, sample_offset);
+	});
 
-	for(size_t i = 0; i < param_changes_queue_.getParameterCount(); ++i) {
-		auto *src_queue = param_changes_queue_.getParameterData(i);
+	UnlistedParameterChange change;
+	while(unlisted_param_changes_.pop(change)) {
+		add_point(change.id_, change.value_, change.sample_offset_);
+	}
+
+	TakeProgramChanges(dest, num_samples);
+}
 
-		//! Boz Digital LabsのPANIPULATORではここでsrc_queueのgetPointCountが0になることがある。
-		//! その時は単にaddParameterDataでdestにエントリが追加されるだけになってpointのデータが追加されず、
-		//! ParameterChanges::getParameterDataでアクセス違反をが発生する。
-		if(src_queue->getPointCount() == 0) {
+void Vst3Plugin::Impl::TakeProgramChanges(Vst::ParameterChanges &dest, Steinberg::int32 num_samples)
+{
+	Vst::IParamValueQueue *queue = nullptr;
+	Steinberg::int32 last_offset = 0;
+
+	ProgramChange change;
+	for(size_t n = 0; n < kMaxProgramChangesPerBlock && program_changes_.pop(change); ++n) {
+		if(!queue) {
+			Steinberg::int32 queue_index;
+			queue = dest.addParameterData(program_change_parameter_, queue_index);
+			if(!queue) {
+				return;
+			}
+		}
+
+		//! 複数のスレッドから追加された変更の位置が前後していても、追加された順に適用されるようにする
+		auto const offset = std::max<Steinberg::int32>(
+			last_offset, std::min<Steinberg::int32>(change.sample_offset_, num_samples - 1));
+		auto const value = program_values_[change.index_];
+
+		//! ParamValueQueueの点の間は線形に補間されるので、変更の直前まで前の値を保持する点を置いて、
+		//! 値がその位置で切り替わるようにする
+		//! 直前の変更の点がoffset - 1にある場合は、その点が前の値を保持している
+		bool const follows_previous_point = (n > 0 && offset - 1 <= last_offset);
+		if(last_program_value_ >= 0 && offset > 0 && !follows_previous_point) {
+			AddPoint(*queue, offset - 1, last_program_value_);
+		}
+		AddPoint(*queue, offset, value);
+
+		last_offset = offset;
+		last_program_value_ = value;
+	}
+}
+
+void Vst3Plugin::Impl::ReceiveParameterBatches(Vst::ParameterChanges &dest)
+{
+	auto give_back = [this](ParameterBatch *batch) {
+		bool const pushed = param_batch_outbox_.push(batch);
+		assert(pushed);
+		(void)pushed;
+	};
+
+	//! 1つ受け取るごとに返却するのは多くても1つなので、返却用のキューに空きがある間だけ受け取る。
+	//! 残りは次のブロックで受け取る。
+	ParameterBatch *received;
+	while(!param_batch_outbox_.full() && param_batch_inbox_.pop(received)) {
+		if(received->IsMorph()) {
+			//! 新しいモーフィングは、実行中のものを置き換える
+			if(morph_) {
+				give_back(morph_.release());
+			}
+			morph_.reset(received);
 			continue;
 		}
 
-		Steinberg::int32 index;
-		dest.addParameterData(src_queue->getParameterId(), index);
-		auto *dest_queue = dest.getParameterData(index);
+		//! 値のミラーとコントローラには、UIスレッドで反映済み
+		for(size_t i = 0; i < received->size(); ++i) {
+			Steinberg::int32 queue_index;
+			if(auto *queue = dest.addParameterData(received->ids_[i], queue_index)) {
+				AddPoint(*queue, 0, received->to_[i]);
+			}
+		}
+		give_back(received);
+	}
+}
 
-		for(size_t v = 0; v < src_queue->getPointCount(); ++v) {
-			Steinberg::int32 offset;
-			Vst::ParamValue value;
-			src_queue->getPoint(v, offset, value);
-			Steinberg::int32 point_index;
-			dest_queue->addPoint(offset, value, point_index);
+void Vst3Plugin::Impl::RenderMorph(Vst::ParameterChanges &dest, size_t num_samples)
+{
+	if(!morph_) {
+		return;
+	}
+
+	auto &morph = *morph_;
+	if(morph.position_ < morph.num_blocks_ && num_samples > 0) {
+		//! このブロックの中では、ホストが実際に処理するサンプル数で補間する。
+		//! 最初のサンプルで1サンプル分進んだ値に、最後のサンプルでこのブロックの終わりの値になる。
+		size_t const block = morph.position_;
+		double const first_progress = (block + 1.0 / num_samples) / morph.num_blocks_;
+		double const last_progress = (block + 1.0) / morph.num_blocks_;
+		auto const last_offset = static_cast<Steinberg::int32>(num_samples - 1);
+
+		//! 直線的に補間するので、プラグイン側の補間と一致するようにブロック内の始点と終点だけを送ればよい
+		for(size_t i = 0; i < morph.size(); ++i) {
+			if(morph.from_[i] == morph.to_[i] && block > 0) {
+				continue;
+			}
+
+			Steinberg::int32 queue_index;
+			auto *queue = dest.addParameterData(morph.ids_[i], queue_index);
+			if(!queue) {
+				continue;
+			}
+
+			auto const first_value = morph.GetValueAt(i, first_progress);
+			auto const last_value = morph.GetValueAt(i, last_progress);
+
+			AddPoint(*queue, 0, first_value);
+			if(last_offset > 0) {
+				AddPoint(*queue, last_offset, last_value);
+			}
+
+			if(morph.indices_[i] != ParameterModel::npos) {
+				parameters_.SetValue(morph.indices_[i], last_value);
+			}
 		}
+
+		morph.position_ = block + 1;
+	}
+
+	//! 返却用のキューが一杯の場合は、終わったモーフィングを保持したまま次のブロックでもう一度返却する
+	if(morph.position_ >= morph.num_blocks_ && param_batch_outbox_.push(morph_.get())) {
+		morph_.release();
 	}
+}
+
+void Vst3Plugin::Impl::ReceiveAutomation()
+{
+	//! 複数貯まっている場合は、最後に渡されたものだけを使用する
+	AutomationSet *received;
+	while(automation_inbox_.pop(received)) {
+		if(automation_) {
+			bool const pushed = automation_outbox_.push(automation_.release());
+			assert(pushed);
+			(void)pushed;
+		}
+		automation_.reset(received);
+	}
+}
+
+void Vst3Plugin::Impl::RenderAutomation(Vst::ParameterChanges &dest, size_t frame_pos, size_t num_samples)
+{
+	if(!automation_) {
+		return;
+	}
+
+	for(size_t i = 0; i < automation_->GetNumLanes(); ++i) {
+		auto const num_points = automation_->GetLaneByIndex(i).RenderBlock(
+			frame_pos, num_samples, AutomationLane::kDefaultTolerance,
+			automation_->GetPlaybackState(i),
+			automation_points_, kMaxAutomationPointsPerBlock);
+		if(num_points == 0) {
+			continue;
+		}
+
+		auto const id = automation_->GetParamID(i);
+		Steinberg::int32 queue_index;
+		auto *queue = dest.addParameterData(id, queue_index);
+		if(!queue) {
+			continue;
+		}
+
+		for(size_t j = 0; j < num_points; ++j) {
+			AddPoint(*queue, automation_points_[j].offset_, automation_points_[j].value_);
+		}
 
-	param_changes_queue_.clearQueue();
+		parameters_.SetValueByID(id, automation_points_[num_points - 1].value_);
+	}
 }
 
 void Vst3Plugin::Impl::LoadPlugin(IPluginFactory *factory, ClassInfo const &info, host_context_type host_context)
@@ -538,6 +1474,10 @@ void Vst3Plugin::Impl::LoadInterfaces(IPluginFactory *factory, ClassInfo const &
 		throw Error(ErrorContext::kAudioProcessorError, res);
 	}
 
+	//! 64bitでの処理は、対応しているプラグインでのみSetSymbolicSampleSizeで有効にできる
+	bool const can_process_double =
+		(audio_processor->canProcessSampleSize(Vst::SymbolicSampleSizes::kSample64) == kResultOk);
+
 	// $(DOCUMENT_ROOT)/vstsdk360_22_11_2013_build_100/VST3%20SDK/doc/vstinterfaces/index.html
 	// Although it is not recommended, it is possible to implement both, 
 	// the processing part and the controller part in one component class.
@@ -597,6 +1537,7 @@ void Vst3Plugin::Impl::LoadInterfaces(IPluginFactory *factory, ClassInfo const &
 	edit_controller_ = std::move(edit_controller);
 	edit_controller2_ = std::move(edit_controller2);
 	edit_controller_is_created_new_ = edit_controller_is_created_new;
+	can_process_double_ = can_process_double;
 }
 
 void Vst3Plugin::Impl::Initialize(std::unique_ptr<Vst::IComponentHandler, SelfReleaser> component_handler)
@@ -659,6 +1600,7 @@ void Vst3Plugin::Impl::Initialize(std::unique_ptr<Vst::IComponentHandler, SelfRe
 
 		input_buses_.UpdateBufferHeads();
 		output_buses_.UpdateBufferHeads();
+		PrepareProcessData();
 
 		//! 可能であればこのあたりでIPlugViewを取得して、このプラグインがエディターを持っているかどうかを
 		//! チェックしたかったが、いくつかのプラグイン(e.g., TyrellN6, Podolski)では
@@ -668,8 +1610,13 @@ void Vst3Plugin::Impl::Initialize(std::unique_ptr<Vst::IComponentHandler, SelfRe
 		PrepareParameters();
 		PrepareProgramList();
 
-		input_changes_.setMaxParameters(parameters_.size());
+		input_changes_.setMaxParameters(parameters_.size() + kUnlistedParameterQueueCapacity);
 		output_changes_.setMaxParameters(parameters_.size());
+		ReserveParameterPoints();
+
+		param_change_slots_.Resize(parameters_.size());
+		output_param_slots_.Resize(parameters_.size());
+		pending_output_positions_.assign(parameters_.size(), ParameterModel::npos);
 	}
 }
 
@@ -728,13 +1675,41 @@ std::wstring
 
 void Vst3Plugin::Impl::PrepareParameters()
 {
-	for(Steinberg::int32 i = 0; i < edit_controller_->getParameterCount(); ++i) {
-		Vst::ParameterInfo info = {};
-		edit_controller_->getParameterInfo(i, info);
-		parameters_.AddInfo(info);
+	Steinberg::int32 const num_params = edit_controller_->getParameterCount();
+
+	ParameterModel::container infos(num_params);
+	std::vector<Vst::ParamValue> values(num_params);
+	for(Steinberg::int32 i = 0; i < num_params; ++i) {
+		edit_controller_->getParameterInfo(i, infos[i]);
+		values[i] = edit_controller_->getParamNormalized(infos[i].id);
+	}
+
+	parameters_.Assign(std::move(infos), values);
+}
+
+void Vst3Plugin::Impl::RefreshParameterValues()
+{
+	if(!edit_controller_) {
+		return;
+	}
+
+	for(size_t i = 0; i < parameters_.size(); ++i) {
+		parameters_.SetValue(i, edit_controller_->getParamNormalized(parameters_.GetSummary(i).id_));
+	}
+
+	auto const program_param_index = parameters_.FindIndex(program_change_parameter_);
+	if(program_param_index != ParameterModel::npos) {
+		UpdateProgramIndex(program_change_parameter_, parameters_.GetValue(program_param_index));
 	}
 }
 
+void Vst3Plugin::Impl::PerformEdit(Vst::ParamID id, Vst::ParamValue value)
+{
+	parameters_.SetValueByID(id, value);
+	EnqueueParameterChange(id, value, 0);
+	UpdateProgramIndex(id, value);
+}
+
 void Vst3Plugin::Impl::PrepareProgramList()
 {
 	parameter_for_program_ = -1;
@@ -795,13 +1770,11 @@ void Vst3Plugin::Impl::PrepareProgramList()
 			continue;
 		}
 
+		//! プログラム数が多いプラグインもあるので、ここではプログラム名を取得しない
+		tmp_programs.reserve(tmp_programs.size() + plinfo.programCount);
 		for(int i = 0; i < plinfo.programCount; ++i) {
-			Steinberg::Vst::String128 name_buf;
-			unit_info_->getProgramName(plinfo.id, i, name_buf);
-
 			ProgramInfo prginfo;
 
-            prginfo.name_ = hwm::to_wstr(name_buf);
 			prginfo.list_id_ = plinfo.id;
 			prginfo.index_ = i;
 
@@ -810,6 +1783,30 @@ void Vst3Plugin::Impl::PrepareProgramList()
 	}
 
 	programs_.swap(tmp_programs);
+
+	//! プログラム変更のたびにパラメータ情報を引かなくて済むように、変換表を作成しておく
+	program_change_parameter_ =
+		(parameter_for_program_ != -1)
+		?	parameter_for_program_
+		:	programs_.empty() ? -1 : programs_.front().list_id_;
+
+	program_step_count_ =
+		(parameter_for_program_ != -1)
+		?	parameters_.GetInfoByID(parameter_for_program_).stepCount
+		:	static_cast<Steinberg::int32>(programs_.size()) - 1;
+
+	program_values_.resize(programs_.size());
+	for(size_t i = 0; i < programs_.size(); ++i) {
+		program_values_[i] =
+			(program_step_count_ > 0)
+			?	std::min<Vst::ParamValue>(1.0, i / static_cast<Vst::ParamValue>(program_step_count_))
+			:	0.0;
+	}
+
+	auto const program_param_index = parameters_.FindIndex(program_change_parameter_);
+	if(program_param_index != ParameterModel::npos) {
+		UpdateProgramIndex(program_change_parameter_, parameters_.GetValue(program_param_index));
+	}
 }
 
 void Vst3Plugin::Impl::UnloadPlugin()
@@ -860,7 +1857,9 @@ void Vst3Plugin::Impl::OutputUnitInfo(Steinberg::Vst::IUnitInfo &info_interface)
 
 		hwm::wdout << L"[" << i << L"] " << ProgramListInfoToString(program_list_info) << std::endl;
 
-		for(size_t program_index = 0; program_index < program_list_info.programCount; ++program_index) {
+		//! プログラム数が多いプラグインでロードが遅くならないように、先頭のいくつかだけを出力する
+		size_t const num_programs_to_output = std::min<size_t>(program_list_info.programCount, kMaxProgramsToOutput);
+		for(size_t program_index = 0; program_index < num_programs_to_output; ++program_index) {
 
 			hwm::wdout << L"\t[" << program_index << L"] ";
 
@@ -897,6 +1896,11 @@ void Vst3Plugin::Impl::OutputUnitInfo(Steinberg::Vst::IUnitInfo &info_interface)
 
 			hwm::wdout << std::endl;
 		}
+
+		if(num_programs_to_output < static_cast<size_t>(program_list_info.programCount)) {
+			hwm::wdout << L"\t... and " << (program_list_info.programCount - num_programs_to_output)
+					   << L" more programs" << std::endl;
+		}
 	}
 }
 
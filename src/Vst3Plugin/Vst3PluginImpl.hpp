@@ -1,6 +1,8 @@
 #include "../Vst3Plugin.hpp"
 
+#include <chrono>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <unordered_map>
 #include <atomic>
@@ -23,9 +25,20 @@
 #include "../Vst3Utils.hpp"
 #include "../Vst3Plugin.hpp"
 #include "../Vst3PluginFactory.hpp"
+#include "../Vst3Module.hpp"
 
 #include "../Flag.hpp"
+#include "../AudioTap.hpp"
+#include "../AutomationLane.hpp"
 #include "../Buffer.hpp"
+#include "../InputSource.hpp"
+#include "../PeakMeterBank.hpp"
+#include "../MpscQueue.hpp"
+#include "../SpscQueue.hpp"
+#include "../TestWavetable.hpp"
+#include "./ParameterBatch.hpp"
+#include "./ParameterChangeSlots.hpp"
+#include "./ParameterModel.hpp"
 #include "../debugger_output.hpp"
 #include <experimental/optional>
 
@@ -81,62 +94,31 @@ struct Vst3Plugin::Impl
 	};
 
 	typedef Vst3PluginFactory::host_context_type host_context_type;
+	typedef Vst3Plugin::output_parameter_change_handler_t output_parameter_change_handler_t;
 
-	struct ParameterInfoList
-	{
-		typedef Vst::ParameterInfo value_type;
-		typedef std::vector<value_type> container;
-		typedef container::iterator iterator;
-		typedef container::const_iterator const_iterator;
-		typedef size_t size_type;
-
-		Vst::ParameterInfo const & GetInfoByID(Vst::ParamID id) const
-		{
-			return parameters_[IDToIndex(id)];
-		}
-
-		Vst::ParameterInfo const & GetInfoByIndex(size_type index) const
-		{
-			assert(index < parameters_.size());
-			return parameters_[index];
-		}
-
-		size_type
-			IDToIndex(Vst::ParamID id) const
-		{
-			assert(param_id_to_index_.find(id) != param_id_to_index_.end());
-			return param_id_to_index_.find(id)->second;
-		}
-
-		void AddInfo(Vst::ParameterInfo const &info)
-		{
-			parameters_.push_back(info);
-			param_id_to_index_[info.id] = parameters_.size()-1;
-		}
-
-		size_type size() const { return parameters_.size(); }
-		bool empty() const { return parameters_.empty(); }
-
-		const_iterator begin() const { return parameters_.begin(); }
-		const_iterator end() const { return parameters_.end(); }
-
-	private:
-		std::vector<Vst::ParameterInfo> parameters_;
-		std::unordered_map<Vst::ParamID, size_type> param_id_to_index_;
-	};
-
+	//! プログラム名は、GetProgramNameで最初に要求されたときにIUnitInfoから取得する。
+	//! name_はprogram_names_mutex_で保護する。
 	struct ProgramInfo
 	{
-		String		        name_;
+		mutable std::experimental::optional<String>
+							name_;
 		Vst::ProgramListID	list_id_;
 		Steinberg::int32	index_;
 	};
 
-	ParameterInfoList parameters_;
+	//! このプラグインを作成したモジュール。
+	//! 他のメンバーよりも後に破棄されるように、最初に宣言する。
+	std::shared_ptr<Vst3Module> module_;
+
+	//! パラメータ情報と値のキャッシュ
+	ParameterModel parameters_;
+	//! プログラム変更を送信するパラメータのID。
+	//! kIsProgramChangeのパラメータがない場合は、プログラムリストのIDを使用する。
 	Steinberg::Vst::ParamID program_change_parameter_;
 
-	std::vector<double> wave_data_;
-	int wave_data_index_;
+	//! 接続されていない入力バスに流すテスト用の信号。PrepareProcessDataで取得する。
+	std::shared_ptr<TestWavetable const> test_wavetable_;
+	size_t test_wavetable_pos_;
 
 	Status status_;
 
@@ -144,7 +126,7 @@ struct Vst3Plugin::Impl
 	Vst::ParameterChanges output_changes_;
 
 public:
-	Impl(IPluginFactory *factory, ClassInfo const &info, host_context_type host_context);
+	Impl(std::shared_ptr<Vst3Module> module, ClassInfo const &info, host_context_type host_context);
 	~Impl();
 
 	Impl(Impl &&) = delete;
@@ -162,8 +144,20 @@ public:
 
 	String GetEffectName() const;
 
+	ClassInfo::cid_t GetClassID() const;
+
 	size_t GetNumOutputs() const;
 
+	size_t GetNumInputBuses() const;
+	size_t GetNumOutputBuses() const;
+	size_t GetInputBusChannels(size_t bus_index) const;
+	size_t GetOutputBusChannels(size_t bus_index) const;
+	float ** GetOutputBusBuffers(size_t bus_index);
+	double ** GetOutputBusBuffers64(size_t bus_index);
+
+	void ConnectInputBus(size_t bus_index, float ** channels);
+	void ConnectInputBus64(size_t bus_index, double ** channels);
+
 	bool HasEditor() const;
 
 	//bool OpenEditor(HWND parent, IPlugFrame *frame);
@@ -184,9 +178,23 @@ public:
 
 	void SetSamplingRate(int sampling_rate);
 
-	void	AddNoteOn(int note_number);
+	void SetProcessMode(Steinberg::int32 process_mode);
+
+	Steinberg::int32 GetProcessMode() const;
+
+	bool CanProcessDouble() const;
 
-	void	AddNoteOff(int note_number);
+	void SetSymbolicSampleSize(Steinberg::int32 sample_size);
+
+	Steinberg::int32 GetSymbolicSampleSize() const;
+
+	bool	AddEvent(Vst::Event const &event);
+
+	bool	AddNoteOn(int note_number, Steinberg::int32 sample_offset, float velocity, Steinberg::int16 channel, Steinberg::int32 note_id);
+
+	bool	AddNoteOff(int note_number, Steinberg::int32 sample_offset, float velocity, Steinberg::int16 channel, Steinberg::int32 note_id);
+
+	size_t	GetNumDroppedEvents() const;
 
 	size_t	GetProgramCount() const;
 
@@ -201,18 +209,161 @@ public:
 
 	void	SetProgramIndex(size_t index);
 
+	//! プログラム変更を、sample_offsetの位置でプロセッサに送信する
+	/*!
+		PrepareProgramListで作成した変換表を使用するので、コントローラは呼び出さない。
+		コントローラへの反映は、次回のOnIdleで行う。
+		変更はprogram_changes_に貯められ、どのスレッドから呼び出してもよい。
+		@return indexがプログラム数以上の場合や、キューが一杯の場合はfalse
+	*/
+	bool	AddProgramChange(size_t index, Steinberg::int32 sample_offset);
+
 	void	RestartComponent(Steinberg::int32 flags);
 
+	//! コントローラからperformEditで通知された変更を、値のミラーとプロセッサに反映する
+	void	PerformEdit(Vst::ParamID id, Vst::ParamValue value);
+
+	//! 値のミラーを、コントローラの現在の値で更新する
+	void	RefreshParameterValues();
+
+	StateData
+			GetState() const;
+	void	SetState(StateData const &state);
+
 	float ** ProcessAudio(size_t frame_pos, size_t duration);
 
+	double ** ProcessAudio64(size_t frame_pos, size_t duration);
+
+	void	ProcessAudioInto(size_t frame_pos, size_t duration, float ** outputs);
+
+	PeakMeterBank * GetOutputMeter() { return output_meter_.get(); }
+
+	//! ソースをオーディオスレッドに渡す。差し替えられたソースは、オーディオスレッドから返却された後に解放する。
+	void	SetInputSource(size_t bus_index, std::shared_ptr<InputSource> source);
+
+	//! タップをオーディオスレッドに渡す。差し替えられたタップは、オーディオスレッドから返却された後に解放する。
+	void	SetOutputTap(std::shared_ptr<AudioTap> tap);
+
+	typedef Vst3Plugin::ParameterAccessor::snapshot_t snapshot_t;
+
+	//! コントローラに値を設定して、プロセッサへの変更を1つのParameterBatchで渡す
+	void	ApplyParameters(snapshot_t const &changes);
+
+	//! num_blocksブロックかけて補間するParameterBatchを渡す
+	void	MorphParameters(snapshot_t const &from, snapshot_t const &to, size_t num_blocks);
+
+	//! プロセッサの出力パラメータの変更をコントローラに反映し、UIに通知する。
+	//! 処理し終わったParameterBatchの破棄もここで行う。
+	void	OnIdle();
+
+	void	SetOutputParameterChangeHandler(output_parameter_change_handler_t handler);
+
+	//! オートメーションをオーディオスレッドに渡す。前回渡したものは、オーディオスレッドから返却された後に破棄する。
+	void	SetAutomation(std::unique_ptr<AutomationSet> automation);
+
+	//! ホストがこのインスタンスに設定した、プラグインの状態以外のものをすべて破棄する
+	void	ResetHostState();
+
+	//! 1回のProcessAudioで処理できるイベントの最大数
+	static Steinberg::int32 const kMaxEventsPerBlock = 512;
+
+	//! ProcessAudioが呼ばれるまでに貯めておけるイベントの最大数
+	static size_t const kEventQueueCapacity = 1024;
+
+	//! SetInputSource/SetOutputTapの変更を、オーディオスレッドが受け取るまで貯めておける数
+	static constexpr size_t kInputSourceQueueCapacity = 16;
+	static constexpr size_t kOutputTapQueueCapacity = 8;
+
 //! Parameter Change
 public:
-	//! TakeParameterChangesとの呼び出しはスレッドセーフ
-	void EnqueueParameterChange(Vst::ParamID id, Vst::ParamValue value);
+	//! どのスレッドから呼び出してもよい。TakeParameterChangesとの呼び出しもスレッドセーフ
+	void EnqueueParameterChange(Vst::ParamID id, Vst::ParamValue value, Steinberg::int32 sample_offset);
+
+	//! parameters_に含まれないIDへの変更を貯めておけるキューのサイズ
+	static size_t const kUnlistedParameterQueueCapacity = 256;
+
+	//! OnIdleでSetOutputParameterChangeHandlerのハンドラを呼び出す最小の間隔
+	static constexpr std::chrono::milliseconds kOutputNotificationInterval { 33 };
+
+	//! ApplyParameters/MorphParametersで渡したParameterBatchを、オーディオスレッドが受け取るまで貯めておける数
+	static constexpr size_t kParameterBatchQueueCapacity = 8;
+
+	//! SetAutomationで渡したAutomationSetを、オーディオスレッドが受け取るまで貯めておける数
+	static constexpr size_t kAutomationQueueCapacity = 8;
+
+	//! AddProgramChangeで、オーディオスレッドが受け取るまで貯めておけるプログラム変更の数
+	static constexpr size_t kProgramChangeQueueCapacity = 128;
+
+	//! 1ブロックで処理するプログラム変更の最大数。残りは次のブロックで処理する。
+	//! 1つの変更につき、直前の値を保持する点と変更後の値の点の2点を送信する。
+	static constexpr size_t kMaxProgramChangesPerBlock = 16;
+
+	//! OutputUnitInfoで、プログラムリストごとに情報を出力するプログラムの最大数
+	static constexpr size_t kMaxProgramsToOutput = 16;
+
+	//! 1つのパラメータに、1ブロックで送信する点の最大数。
+	/*!
+		SDKのParameterValueQueueは5点分しか領域を予約しないので、
+		ReserveParameterPointsでこの点数分の領域を確保しておき、
+		オーディオスレッドではAddPointでこの点数を超えないように追加する。
+	*/
+	static constexpr size_t kMaxParameterPointsPerBlock = 64;
+
+	//! 1つのパラメータのオートメーションから、1ブロックに送信する点の最大数。
+	static constexpr size_t kMaxAutomationPointsPerBlock = 15;
 
 private:
+	//! idがプログラム変更のパラメータであれば、valueからcurrent_program_index_を更新する
+	void UpdateProgramIndex(Vst::ParamID id, Vst::ParamValue value);
+
+	//! input_changes_とoutput_changes_のすべてのキューに、kMaxParameterPointsPerBlock点分の領域を確保する。
+	//! オーディオスレッドでキューの領域が拡張されないように、setMaxParametersの後に呼び出す。
+	void ReserveParameterPoints();
+
+	//! queueの点がkMaxParameterPointsPerBlockに達している場合は、領域を拡張せずに
+	//! 最後の点を置き換える。最後の点より前の位置への追加は破棄する。
+	static void AddPoint(Vst::IParamValueQueue &queue, Steinberg::int32 sample_offset, Vst::ParamValue value);
+
+	//! program_changes_に貯められたプログラム変更を、それぞれ1つの点としてdestに追加する
+	void TakeProgramChanges(Vst::ParameterChanges &dest, Steinberg::int32 num_samples);
+
 	//! EnqueueParameterChangeとの呼び出しはスレッドセーフ
-	void TakeParameterChanges(Vst::ParameterChanges &dest);
+	//! 前回の呼び出し以降に変更されたパラメータだけをdestに追加する。
+	void TakeParameterChanges(Vst::ParameterChanges &dest, Steinberg::int32 num_samples);
+
+	//! ParameterBatchを受け取って、即時の変更はdestに追加する。オーディオスレッドから呼び出す。
+	void ReceiveParameterBatches(Vst::ParameterChanges &dest);
+
+	//! 実行中のモーフィングのnum_samplesサンプル分をdestに追加する
+	void RenderMorph(Vst::ParameterChanges &dest, size_t num_samples);
+
+	//! オーディオスレッドから返却されたParameterBatchを破棄する。
+	//! モーフィングの場合は、終了(または中断)した時点の値をコントローラと値のミラーに反映する。
+	void CollectParameterBatches();
+
+	//! オーディオスレッドにParameterBatchを渡す
+	void SendParameterBatch(std::unique_ptr<ParameterBatch> batch);
+
+	//! SetAutomationで渡されたオートメーションを受け取る。オーディオスレッドから呼び出す。
+	void ReceiveAutomation();
+
+	//! オートメーションの[frame_pos, frame_pos + num_samples)の区間を、destに追加する
+	void RenderAutomation(Vst::ParameterChanges &dest, size_t frame_pos, size_t num_samples);
+
+	//! OnIdleで、UIへの通知を待っている変更に追加する。
+	//! parameters_に含まれないIDの場合、indexにはParameterModel::nposを指定する。
+	void AddOutputNotification(size_t index, Vst::ParamID id, Vst::ParamValue value);
+
+	//! オーディオスレッドから返却されたAutomationSetを破棄する
+	void CollectAutomation();
+
+	//! SetInputSource/SetOutputTapで渡されたものを受け取って差し替える。オーディオスレッドから呼び出す。
+	void ReceiveInputSources();
+	void ReceiveOutputTap();
+
+	//! オーディオスレッドから返却された入力ソースとタップを解放する
+	void CollectInputSources();
+	void CollectOutputTaps();
 
 private:
 	void LoadPlugin(IPluginFactory *factory, ClassInfo const &info, host_context_type host_context);
@@ -231,6 +382,17 @@ private:
 
 	void UnloadPlugin();
 
+	//! ProcessAudioで使用するProcessDataの構築に必要なオブジェクトを事前に準備する。
+	//! バスの構成やブロックサイズが変わったときに呼び出す。
+	void PrepareProcessData();
+
+	//! ProcessAudio/ProcessAudio64の共通部分
+	void ProcessAudioImpl(size_t frame_pos, size_t duration);
+
+	//! 接続されていない入力バスをテスト用の信号で埋める
+	template<class SampleType>
+	void FillTestSignal(SampleType ** channels, size_t num_channels, size_t duration);
+
 //! デバッグ用関数
 private:
 	std::wstring
@@ -249,8 +411,59 @@ private:
 
 	void OutputBusInfo(Vst::IComponent *component, Vst::IEditController *edit_controller);
 
-	std::mutex			parameter_queue_mutex_;
-	Vst::ParameterChanges	param_changes_queue_;
+	//! パラメータのインデックスごとの変更値。オーディオスレッドへロックフリーに受け渡す
+	ParameterChangeSlots	param_change_slots_;
+
+	struct UnlistedParameterChange
+	{
+		Vst::ParamID		id_;
+		Vst::ParamValue		value_;
+		Steinberg::int32	sample_offset_;
+	};
+
+	//! parameters_に含まれないID(ProgramListIDなど)への変更を受け渡すためのキュー。
+	//! EnqueueParameterChangeは複数のスレッドから呼び出されるので、MPSCキューを使用する。
+	MpscQueue<UnlistedParameterChange>	unlisted_param_changes_;
+
+	struct OutputParameterChange
+	{
+		Vst::ParamID		id_;
+		Vst::ParamValue		value_;
+	};
+
+	//! プロセッサの出力パラメータの変更を、オーディオスレッドからOnIdleを呼び出すスレッドへ受け渡す。
+	//! 同じパラメータの変更はスロットで最新の値にまとめられるので、出力の頻度が高くてもあふれない。
+	ParameterChangeSlots				output_param_slots_;
+	//! parameters_に含まれないIDの出力パラメータの変更。一杯の場合は破棄する。
+	SpscQueue<OutputParameterChange>	unlisted_output_changes_;
+
+	//! UIへの通知を待っている出力パラメータの変更。IDごとに最新の値だけを保持する。
+	//! OnIdleを呼び出すスレッドからのみアクセスする。
+	struct PendingOutputNotification
+	{
+		size_t				index_;
+		Vst::ParamID		id_;
+		Vst::ParamValue		value_;
+	};
+	std::vector<PendingOutputNotification>	pending_output_notifications_;
+	//! parameters_のインデックスごとの、pending_output_notifications_内の位置
+	std::vector<size_t>						pending_output_positions_;
+	output_parameter_change_handler_t		output_parameter_change_handler_;
+	std::chrono::steady_clock::time_point	last_output_notification_;
+
+	//! オーディオスレッドが実行中のモーフィング。
+	//! 即時の変更と、終了したモーフィングはparam_batch_outbox_で返却する。
+	std::unique_ptr<ParameterBatch>	morph_;
+	SpscQueue<ParameterBatch *>		param_batch_inbox_;
+	SpscQueue<ParameterBatch *>		param_batch_outbox_;
+
+	//! オーディオスレッドが再生しているオートメーション。
+	//! オーディオスレッドでメモリ解放が起きないように、差し替えたものはautomation_outbox_で返却する。
+	//! automation_outbox_は、受け取ったものと再生中だったものをすべて返却できる容量にしておく。
+	std::unique_ptr<AutomationSet>	automation_;
+	SpscQueue<AutomationSet *>		automation_inbox_;
+	SpscQueue<AutomationSet *>		automation_outbox_;
+	AutomationLane::RenderedPoint	automation_points_[kMaxAutomationPointsPerBlock];
 
 private:
     std::experimental::optional<ClassInfo> plugin_info_;
@@ -263,9 +476,29 @@ private:
 	plug_view_ptr_t			plug_view_;
 	unit_info_ptr_t			unit_info_;
 	program_list_data_ptr_t	program_list_data_;
-	Steinberg::int32		current_program_index_;
+	std::atomic<Steinberg::int32>	current_program_index_;
 	std::vector<ProgramInfo> programs_;
+	//! GetProgramNameは複数のスレッドから呼び出されることがあるので、遅延取得したプログラム名のキャッシュを保護する
+	mutable std::mutex		program_names_mutex_;
 	Steinberg::Vst::ParamID	parameter_for_program_; //Presetを表すParameterのID
+	//! プログラムのインデックスから、program_change_parameter_の正規化された値への変換表
+	std::vector<Vst::ParamValue>	program_values_;
+	//! DiscretizeProgramIndexで使用するステップ数
+	Steinberg::int32		program_step_count_;
+	//! コントローラにまだ反映していないプログラム変更のインデックス。ない場合は-1
+	std::atomic<Steinberg::int32>	pending_program_sync_;
+
+	struct ProgramChange
+	{
+		Steinberg::int32	index_;
+		Steinberg::int32	sample_offset_;
+	};
+
+	//! AddProgramChangeからオーディオスレッドへプログラム変更を受け渡すキュー。
+	//! MIDIのスレッドとUIスレッドの両方から追加されるので、MPSCキューを使用する。
+	MpscQueue<ProgramChange>	program_changes_;
+	//! オーディオスレッドが最後に送信したプログラム変更の値。まだ送信していない場合は負の値
+	Vst::ParamValue			last_program_value_;
 
 	Flag					is_processing_started_;
 	Flag					edit_controller_is_created_new_;
@@ -276,48 +509,62 @@ private:
 
 	int	sampling_rate_;
 	int block_size_;
-
-	struct Note
-	{
-		enum State {
-			kNoteOn,
-			kNoteOff
-		};
-
-		Note()
-			: note_number_(-1)
-			, note_state_(State::kNoteOff)
-		{}
-
-		int note_number_;
-		State note_state_;
-	};
-
-	std::mutex note_mutex_;
-	std::vector<Note> notes_;
-
+	//! Vst::ProcessModes
+	Steinberg::int32 process_mode_;
+	//! Vst::SymbolicSampleSizes
+	Steinberg::int32 symbolic_sample_size_;
+	Flag			can_process_double_;
+
+	//! AddEventで追加されたイベントを、オーディオスレッドへ渡すためのキュー。
+	//! プロデューサーは1つのスレッドに限る。
+	SpscQueue<Vst::Event>	event_queue_;
+	//! キューが一杯で追加できなかったイベントの数
+	std::atomic<size_t>		num_dropped_events_;
+
+	//! 1つのオーディオバスのバッファ。
+	//! 32bit/64bitのうち、SetSampleSizeで指定された方のバッファだけを確保する。
 	struct AudioBus
 	{
 		typedef Buffer<float> buffer_type;
+		typedef Buffer<double> buffer64_type;
 
 		AudioBus()
 			:	speaker_arrangement_(Steinberg::Vst::SpeakerArr::kEmpty)
+			,	num_channels_(0)
+			,	num_samples_(0)
+			,	sample_size_(Vst::SymbolicSampleSizes::kSample32)
 		{}
 
-		void SetBlockSize(size_t num_samples)
+		//! バッファの容量の範囲内であれば、確保し直さずにサンプル数だけを変更する。
+		//! @return バッファを確保し直してチャンネルの先頭のポインタが変化した場合はtrue
+		bool SetBlockSize(size_t num_samples)
 		{
-			buffer_.resize_samples(num_samples);
+			num_samples_ = num_samples;
+			return Reallocate();
 		}
 
 		void SetChannels(size_t num_channels, Steinberg::Vst::SpeakerArrangement speaker_arrangement)
 		{
-			buffer_.resize_channels(num_channels);
+			num_channels_ = num_channels;
 			speaker_arrangement_ = speaker_arrangement;
+			Reallocate();
+		}
+
+		//! Vst::SymbolicSampleSizes
+		void SetSampleSize(Steinberg::int32 sample_size)
+		{
+			sample_size_ = sample_size;
+			Reallocate();
 		}
 
 		size_t channels() const
 		{
-			return buffer_.channels();
+			return num_channels_;
+		}
+
+		bool is_double() const
+		{
+			return sample_size_ == Vst::SymbolicSampleSizes::kSample64;
 		}
 
 		float **data()
@@ -330,14 +577,53 @@ private:
 			return buffer_.data();
 		}
 
+		double **data64()
+		{
+			return buffer64_.data();
+		}
+
+		double const * const * data64() const
+		{
+			return buffer64_.data();
+		}
+
 		Steinberg::Vst::SpeakerArrangement GetSpeakerArrangement() const
 		{
 			return speaker_arrangement_;
 		}
 
 	private:
+		//! ブロックサイズの変更で確保し直さないように、少なくともこのサンプル数の容量を確保しておく
+		static constexpr size_t kReservedSamples = 4096;
+
+		template<class BufferType>
+		bool ReallocateImpl(BufferType &buffer)
+		{
+			bool const fits = buffer.fits(num_channels_, num_samples_);
+			if(!fits) {
+				buffer.reserve(num_channels_, std::max<size_t>(num_samples_, kReservedSamples));
+			}
+			buffer.resize(num_channels_, num_samples_);
+			return !fits;
+		}
+
+		bool Reallocate()
+		{
+			if(is_double()) {
+				buffer_ = buffer_type();
+				return ReallocateImpl(buffer64_);
+			} else {
+				buffer64_ = buffer64_type();
+				return ReallocateImpl(buffer_);
+			}
+		}
+
 		buffer_type buffer_;
+		buffer64_type buffer64_;
 		Steinberg::uint64 speaker_arrangement_;
+		size_t num_channels_;
+		size_t num_samples_;
+		Steinberg::int32 sample_size_;
 	};
 
 	struct AudioBuses
@@ -375,12 +661,22 @@ private:
 			return block_size_;
 		}
 
-		void SetBlockSize(size_t num_samples)
+		//! @return いずれかのバスのバッファが確保し直された場合はtrue
+		bool SetBlockSize(size_t num_samples)
 		{
+			bool reallocated = false;
 			for(auto &bus: buses_) {
-				bus.SetBlockSize(num_samples);
+				reallocated |= bus.SetBlockSize(num_samples);
 			}
 			block_size_ = num_samples;
+			return reallocated;
+		}
+
+		void SetSampleSize(Steinberg::int32 sample_size)
+		{
+			for(auto &bus: buses_) {
+				bus.SetSampleSize(sample_size);
+			}
 		}
 
 		AudioBus & GetBus(size_t index)
@@ -401,15 +697,18 @@ private:
 			}
 
 			std::vector<float *> tmp_heads(n);
+			std::vector<double *> tmp_heads64(n);
 			n = 0;
 			for(auto &bus: buses_) {
 				for(size_t i = 0; i < bus.channels(); ++i) {
-					tmp_heads[n] = bus.data()[i];
+					tmp_heads[n] = bus.is_double() ? nullptr : bus.data()[i];
+					tmp_heads64[n] = bus.is_double() ? bus.data64()[i] : nullptr;
 					++n;
 				}
 			}
 
 			heads_ = std::move(tmp_heads);
+			heads64_ = std::move(tmp_heads64);
 		}
 
 		float ** data()
@@ -422,6 +721,16 @@ private:
 			return heads_.data();
 		}
 
+		double ** data64()
+		{
+			return heads64_.data();
+		}
+
+		double const * const * data64() const
+		{
+			return heads64_.data();
+		}
+
 		size_t GetTotalChannels() const
 		{
 			return heads_.size();
@@ -431,10 +740,50 @@ private:
 		size_t block_size_;
 		std::vector<AudioBus> buses_;
 		std::vector<float *> heads_;
+		std::vector<double *> heads64_;
 	};
 
 	AudioBuses output_buses_;
 	AudioBuses input_buses_;
+
+	//! ConnectInputBus/ConnectInputBus64で入力バスに接続された外部のバッファ。
+	//! nullptrのバスには内部のバッファ(input_buses_)を使用する。
+	std::vector<float **>	connected_inputs_;
+	std::vector<double **>	connected_inputs64_;
+	//! SetInputSourceで入力バスに設定されたソース。オーディオスレッドだけが参照する。
+	//! 接続も設定もされていないバスにはテスト用の信号を使用する。
+	std::vector<std::shared_ptr<InputSource>>	input_sources_;
+
+	//! SetInputSourceで設定されたソースをオーディオスレッドに渡すキューと、差し替えられたソースを返却するキュー。
+	//! ソースのデストラクタ（FileInputSourceのスレッドの終了など）がオーディオスレッドで実行されないように、
+	//! オーディオスレッドでは最後の参照を手放さない。
+	struct InputSourceChange
+	{
+		size_t							bus_index_;
+		std::shared_ptr<InputSource>	source_;
+	};
+	SpscQueue<InputSourceChange>	input_source_inbox_;
+	SpscQueue<InputSourceChange>	input_source_outbox_;
+	//! kSample64で処理する場合に、ソースからfloatで読み出すための作業用バッファ
+	Buffer<float>			input_source_buffer_;
+
+	//! ProcessAudioの中でメモリ確保が発生しないように、
+	//! 毎回のProcessDataの構築に必要なものはPrepareProcessDataで事前に確保しておく
+	std::vector<Vst::AudioBusBuffers>	input_bus_buffers_;
+	std::vector<Vst::AudioBusBuffers>	output_bus_buffers_;
+	Vst::EventList			input_event_list_;
+	Vst::EventList			output_event_list_;
+	Vst::ProcessContext		process_context_;
+
+	//! すべての出力バスのチャンネルのピークメーター。PrepareProcessDataで作り直す。
+	std::unique_ptr<PeakMeterBank>	output_meter_;
+	//! kSample64で処理する場合に、メーターとタップに渡す出力をfloatに変換するための作業用バッファ
+	Buffer<float>					output_convert_buffer_;
+	//! SetOutputTapで設定された、出力を書き込むタップ。オーディオスレッドだけが参照する。
+	std::shared_ptr<AudioTap>		output_tap_;
+	//! 入力ソースと同じく、タップもキューで受け渡しして、差し替えられたものはUIスレッドで解放する
+	SpscQueue<std::shared_ptr<AudioTap>>	output_tap_inbox_;
+	SpscQueue<std::shared_ptr<AudioTap>>	output_tap_outbox_;
 };
 
 } // ::hwm
@@ -8,7 +8,7 @@
 #include "./pluginterfaces/base/ftypes.h"
 #include "./Vst3Utils.hpp"
 #include "./Vst3Plugin.hpp"
-#include "./Module.hpp"
+#include "./Vst3Module.hpp"
 #include "./StrCnv.hpp"
 
 #include "debugger_output.hpp"
@@ -18,7 +18,7 @@ namespace hwm {
 
 extern
 std::unique_ptr<Vst3Plugin>
-	CreatePlugin(IPluginFactory *factory, ClassInfo const &info, Vst3PluginFactory::host_context_type host_context);
+	CreatePlugin(std::shared_ptr<Vst3Module> module, ClassInfo const &info, Vst3PluginFactory::host_context_type host_context);
 
 FactoryInfo::FactoryInfo(PFactoryInfo const &info)
     :	vendor_(hwm::to_wstr(info.vendor))
@@ -27,6 +27,13 @@ FactoryInfo::FactoryInfo(PFactoryInfo const &info)
 	,	flags_(info.flags)
 {}
 
+FactoryInfo::FactoryInfo(String vendor, String url, String email, Steinberg::int32 flags)
+	:	vendor_(std::move(vendor))
+	,	url_(std::move(url))
+	,	email_(std::move(email))
+	,	flags_(flags)
+{}
+
 bool FactoryInfo::discardable				() const
 {
 	return (flags_ & Steinberg::PFactoryInfo::FactoryFlags::kClassesDiscardable) != 0; 
@@ -62,6 +69,11 @@ String	FactoryInfo::email	() const
 	return email_;
 }
 
+Steinberg::int32	FactoryInfo::flags	() const
+{
+	return flags_;
+}
+
 ClassInfo2Data::ClassInfo2Data(Steinberg::PClassInfo2 const &info)
 	:	sub_categories_(hwm::to_wstr(info.subCategories))
 	,	vendor_(hwm::to_wstr(info.vendor))
@@ -78,6 +90,14 @@ ClassInfo2Data::ClassInfo2Data(Steinberg::PClassInfoW const &info)
 {
 }
 
+ClassInfo2Data::ClassInfo2Data(String sub_categories, String vendor, String version, String sdk_version)
+	:	sub_categories_(std::move(sub_categories))
+	,	vendor_(std::move(vendor))
+	,	version_(std::move(version))
+	,	sdk_version_(std::move(sdk_version))
+{
+}
+
 ClassInfo::ClassInfo(Steinberg::PClassInfo const &info)
 	:	cid_()
 	,	name_(hwm::to_wstr(info.name))
@@ -107,166 +127,39 @@ ClassInfo::ClassInfo(Steinberg::PClassInfoW const &info)
 	std::copy(std::begin(info.cid), std::end(info.cid), cid_.begin());
 }
 
+ClassInfo::ClassInfo(cid_t const &cid,
+					 String name,
+					 String category,
+					 Steinberg::int32 cardinality,
+					 std::experimental::optional<ClassInfo2Data> classinfo2)
+	:	cid_(cid)
+	,	name_(std::move(name))
+	,	category_(std::move(category))
+	,	cardinality_(cardinality)
+	,	classinfo2_data_(std::move(classinfo2))
+{
+}
+
 struct Vst3PluginFactory::Impl
 {
-	Impl(String module_path);
-	~Impl();
+	Impl(String module_path)
+		:	module_(Vst3Module::Load(module_path))
+	{}
 
-	size_t	GetComponentCount() { return class_info_list_.size(); }
+	size_t	GetComponentCount() { return module_->GetClassInfoList().size(); }
 	ClassInfo const &
-			GetComponent(size_t index) { return class_info_list_[index]; }
+			GetComponent(size_t index) { return module_->GetClassInfoList()[index]; }
 
 	FactoryInfo const &
-			GetFactoryInfo() { return factory_info_; }
+			GetFactoryInfo() { return module_->GetFactoryInfo(); }
 
-	IPluginFactory *
-			GetFactory()
-	{
-		return factory_.get();
-	}
+	std::shared_ptr<Vst3Module> const &
+			GetModule() { return module_; }
 
 private:
-	Module module_;
-	typedef void (*SetupProc)();
-
-	typedef std::unique_ptr<IPluginFactory, SelfReleaser> factory_ptr;
-
-	factory_ptr				factory_;
-	FactoryInfo				factory_info_;
-	std::vector<ClassInfo>	class_info_list_;
+	std::shared_ptr<Vst3Module> module_;
 };
 
-String FormatCid(Steinberg::int8 const *cid_array)
-{
-	int const reg_str_len = 48; // including null-terminator
-	std::string reg_str(reg_str_len, '\0');
-    FUID fuid;
-    fuid.fromTUID(cid_array);
-    fuid.toRegistryString(&reg_str[0]);
-    return hwm::to_wstr(reg_str.c_str());
-}
-
-std::wstring
-		ClassInfoToString(ClassInfo const &info)
-{
-	std::wstringstream ss;
-	ss	<< info.name()
-		<< L", " << FormatCid(info.cid())
-		<< L", " << info.category()
-		<< L", " << info.cardinality();
-
-	if(info.is_classinfo2_enabled()) {
-		ss	<< L", " << info.classinfo2().sub_categories()
-			<< L", " << info.classinfo2().vendor()
-			<< L", " << info.classinfo2().version()
-			<< L", " << info.classinfo2().sdk_version()
-			;
-	}
-	return ss.str();
-}
-
-template<class Container>
-void OutputClassInfoList(Container const &cont)
-{
-	hwm::wdout << "--- Output Class Info ---" << std::endl;
-	int count = 0;
-	for(ClassInfo const &info: cont) {
-		hwm::wdout
-			<< L"[" << count++ << L"] " << ClassInfoToString(info) << std::endl;
-	}
-}
-
-std::wstring
-		FactoryInfoToString(FactoryInfo const &info)
-{
-	std::wstringstream ss;
-	ss	<< info.vendor()
-		<< L", " << info.url()
-		<< L", " << info.email()
-		<< std::boolalpha
-		<< L", " << L"Discardable: " << info.discardable()
-		<< L", " << L"License Check: "<< info.license_check()
-		<< L", " << L"Component Non Discardable: " << info.component_non_discardable()
-		<< L", " << L"Unicode: " << info.unicode();
-	return ss.str();
-}
-
-void OutputFactoryInfo(FactoryInfo const &info)
-{
-	hwm::wdout << "--- Output Factory Info ---" << std::endl;
-	hwm::wdout << FactoryInfoToString(info) << std::endl;
-}
-
-Vst3PluginFactory::Impl::Impl(String module_path)
-{
-    Module mod(module_path.c_str());
-	if(!mod) {
-		throw std::runtime_error("cannot load library");
-	}
-
-    auto init_dll = reinterpret_cast<SetupProc>(mod.get_proc_address("InitDll"));
-	if(init_dll) {
-		init_dll();
-	}
-
-	//! GetPluginFactoryという名前でエクスポートされている、
-	//! Factory取得用の関数を探す。
-	GetFactoryProc get_factory = (GetFactoryProc)mod.get_proc_address("GetPluginFactory");
-	if(!get_factory) {
-		throw std::runtime_error("not a vst3 module");
-	}
-
-	auto factory = to_unique(get_factory());
-	if(!factory) {
-		throw std::runtime_error("Failed to get factory function");
-	}
-	
-	PFactoryInfo loaded_factory_info;
-	factory->getFactoryInfo(&loaded_factory_info);
-
-	std::vector<ClassInfo> class_info_list;
-
-	for(int i = 0; i < factory->countClasses(); ++i) {
-		auto maybe_factory3 = queryInterface<IPluginFactory3>(factory);
-		if(maybe_factory3.is_right()) {
-			PClassInfoW info;
-			maybe_factory3.right()->getClassInfoUnicode(i, &info);
-			class_info_list.emplace_back(info);
-		} else {
-			auto maybe_factory2 = queryInterface<IPluginFactory2>(factory);
-			if(maybe_factory2.is_right()) {
-				PClassInfo2 info;
-				maybe_factory2.right()->getClassInfo2(i, &info);
-				class_info_list.emplace_back(info);
-			} else {
-				PClassInfo info;
-				factory->getClassInfo(i, &info);
-				class_info_list.emplace_back(info);
-			}
-		}
-	}
-
-	module_ = std::move(mod);
-	factory_ = std::move(factory);
-	factory_info_ = FactoryInfo(loaded_factory_info);
-	class_info_list_ = std::move(class_info_list);
-
-	OutputFactoryInfo(factory_info_);
-	OutputClassInfoList(class_info_list_);
-}
-
-Vst3PluginFactory::Impl::~Impl()
-{
-	factory_.reset();
-
-	if(module_) {
-		auto exit_dll = (SetupProc)module_.get_proc_address("ExitDll");
-		if(exit_dll) {
-			exit_dll();
-		}
-	}
-}
-
 Vst3PluginFactory::Vst3PluginFactory(String module_path)
 {
 	pimpl_ = std::unique_ptr<Impl>(new Impl(module_path));
@@ -296,7 +189,7 @@ ClassInfo const &
 std::unique_ptr<Vst3Plugin>
 		Vst3PluginFactory::CreateByIndex(size_t index, host_context_type host_context)
 {
-	return CreatePlugin(pimpl_->GetFactory(), GetComponentInfo(index), std::move(host_context));
+	return CreatePlugin(pimpl_->GetModule(), GetComponentInfo(index), std::move(host_context));
 }
 
 std::unique_ptr<Vst3Plugin>
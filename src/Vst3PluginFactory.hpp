@@ -28,10 +28,13 @@ public:
 	String	vendor	() const;
 	String	url		() const;
 	String	email	() const;
+	Steinberg::int32
+			flags	() const;
 
 public:
-	FactoryInfo() {}
+	FactoryInfo() : flags_(0) {}
 	FactoryInfo(Steinberg::PFactoryInfo const &info);
+	FactoryInfo(String vendor, String url, String email, Steinberg::int32 flags);
 
 private:
 	String vendor_;
@@ -44,6 +47,7 @@ struct ClassInfo2Data
 {
 	ClassInfo2Data(Steinberg::PClassInfo2 const &info);
 	ClassInfo2Data(Steinberg::PClassInfoW const &info);
+	ClassInfo2Data(String sub_categories, String vendor, String version, String sdk_version);
 
 	String const &	sub_categories() const { return sub_categories_; }
 	String const &	vendor() const { return vendor_;; }
@@ -64,6 +68,13 @@ public:
 	ClassInfo(Steinberg::PClassInfo2 const &info);
 	ClassInfo(Steinberg::PClassInfoW const &info);
 
+	typedef std::array<Steinberg::int8, 16> cid_t;
+	ClassInfo(cid_t const &cid,
+			  String name,
+			  String category,
+			  Steinberg::int32 cardinality,
+			  std::experimental::optional<ClassInfo2Data> classinfo2);
+
 	Steinberg::int8	const *	cid() const { return cid_.data(); }
 	String const &	name() const { return name_; }
 	String const &	category() const { return category_; }
@@ -0,0 +1,195 @@
+#include "./Vst3PluginPool.hpp"
+
+#include <stdexcept>
+
+#include "./StrCnv.hpp"
+
+#include "debugger_output.hpp"
+
+namespace hwm {
+
+Vst3PluginPool::Vst3PluginPool(Vst3PluginFactory &factory, Setup const &setup, host_context_creator_t create_host_context)
+	:	factory_(factory)
+	,	setup_(setup)
+	,	create_host_context_(std::move(create_host_context))
+	,	stop_(false)
+{
+	fill_thread_ = std::thread([this] { FillThread(); });
+}
+
+Vst3PluginPool::~Vst3PluginPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cond_.notify_all();
+	fill_thread_.join();
+}
+
+void Vst3PluginPool::Reserve(cid_t const &cid, size_t num_instances)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pools_[cid].num_reserved_ = num_instances;
+	}
+	cond_.notify_all();
+}
+
+std::unique_ptr<Vst3Plugin>
+		Vst3PluginPool::Checkout(cid_t const &cid)
+{
+	std::unique_ptr<Vst3Plugin> plugin;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto &pool = pools_[cid];
+		if(!pool.available_.empty()) {
+			plugin = std::move(pool.available_.front());
+			pool.available_.pop_front();
+		}
+	}
+
+	if(plugin) {
+		//! 取り出した分を補充する
+		cond_.notify_all();
+		return plugin;
+	}
+
+	hwm::dout << "Plugin pool is empty. Creating a new instance." << std::endl;
+	return CreateInstance(cid);
+}
+
+void Vst3PluginPool::Checkin(cid_t const &cid, std::unique_ptr<Vst3Plugin> plugin)
+{
+	if(!plugin) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		pools_[cid].to_reset_.push_back(std::move(plugin));
+	}
+	cond_.notify_all();
+}
+
+size_t Vst3PluginPool::GetNumAvailable(cid_t const &cid) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto found = pools_.find(cid);
+	return (found != pools_.end()) ? found->second.available_.size() : 0;
+}
+
+std::unique_ptr<Vst3Plugin>
+		Vst3PluginPool::CreateInstance(cid_t const &cid)
+{
+	auto plugin = factory_.CreateByID(cid.data(), create_host_context_());
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto &pool = pools_[cid];
+		if(!pool.default_state_) {
+			pool.default_state_ = std::make_shared<Vst3Plugin::StateData const>(plugin->GetState());
+		}
+	}
+
+	ApplySetup(*plugin);
+
+	return plugin;
+}
+
+void Vst3PluginPool::ApplySetup(Vst3Plugin &plugin) const
+{
+	//! 利用者が設定を変更している場合があるので、処理の設定はResumeし直して適用する
+	if(plugin.IsResumed()) {
+		plugin.Suspend();
+	}
+
+	plugin.SetSamplingRate(setup_.sampling_rate_);
+	plugin.SetBlockSize(setup_.block_size_);
+	plugin.SetProcessMode(setup_.process_mode_);
+	if(setup_.symbolic_sample_size_ == Steinberg::Vst::SymbolicSampleSizes::kSample64 && plugin.CanProcessDouble()) {
+		plugin.SetSymbolicSampleSize(Steinberg::Vst::SymbolicSampleSizes::kSample64);
+	} else {
+		plugin.SetSymbolicSampleSize(Steinberg::Vst::SymbolicSampleSizes::kSample32);
+	}
+	plugin.Resume();
+}
+
+void Vst3PluginPool::FillThread()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	for( ; ; ) {
+		if(stop_) {
+			break;
+		}
+
+		//! 返却されたインスタンスのリセットを優先し、次に不足しているインスタンスを作成する
+		bool did_work = false;
+		for(auto &entry: pools_) {
+			auto const cid = entry.first;
+			auto &pool = entry.second;
+
+			if(!pool.to_reset_.empty()) {
+				auto plugin = std::move(pool.to_reset_.front());
+				pool.to_reset_.pop_front();
+				auto default_state = pool.default_state_;
+
+				lock.unlock();
+				bool reset = false;
+				try {
+					plugin->ResetHostState();
+					if(default_state) {
+						plugin->SetState(*default_state);
+					}
+					ApplySetup(*plugin);
+					reset = true;
+				} catch(std::exception &e) {
+					hwm::dout << "Failed to reset a pooled plugin : " << e.what() << std::endl;
+				}
+
+				//! リセットできなかったインスタンスは破棄する
+				if(!reset) {
+					plugin.reset();
+				}
+				lock.lock();
+
+				if(plugin) {
+					pools_[cid].available_.push_back(std::move(plugin));
+				}
+				did_work = true;
+				break;
+			}
+
+			if(pool.available_.size() + pool.num_creating_ < pool.num_reserved_) {
+				pool.num_creating_ += 1;
+
+				lock.unlock();
+				std::unique_ptr<Vst3Plugin> plugin;
+				try {
+					plugin = CreateInstance(cid);
+				} catch(std::exception &e) {
+					hwm::dout << "Failed to create a pooled plugin : " << e.what() << std::endl;
+				}
+				lock.lock();
+
+				auto &target = pools_[cid];
+				target.num_creating_ -= 1;
+				if(plugin) {
+					target.available_.push_back(std::move(plugin));
+				} else {
+					//! 作成に失敗するクラスを繰り返し作成しないように、予約を取り消す
+					target.num_reserved_ = 0;
+				}
+				did_work = true;
+				break;
+			}
+		}
+
+		if(!did_work) {
+			cond_.wait(lock);
+		}
+	}
+}
+
+}	// ::hwm
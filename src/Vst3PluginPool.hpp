@@ -0,0 +1,107 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "./Vst3Plugin.hpp"
+#include "./Vst3PluginFactory.hpp"
+
+namespace hwm {
+
+//! 初期化済みでResume済みのプラグインを、クラスIDごとにあらかじめ用意しておくプール
+/*!
+	プラグインの作成（LoadInterfaces、Initialize、パラメータやプログラムリストの準備）と
+	Resume（setupProcessing、setActive、CreatePlugView）は重いプラグインでは数百ミリ秒かかるため、
+	これらをバックグラウンドスレッドで実行して、Checkout()ではすぐにインスタンスを返せるようにする。
+
+	Checkin()で返却されたインスタンスは、バックグラウンドスレッドでResetHostState()を呼び出して
+	ホストが設定したものを破棄し、最初に作成したインスタンスから取得しておいたデフォルトの状態と
+	Setupの設定に戻してからプールに戻される。
+
+	バックグラウンドスレッドでプラグインを作成するので、
+	UIスレッド以外での作成に対応していないプラグインには使用できない。
+	Vst3PluginPoolが破棄されるまで、factoryを破棄してはならない。
+*/
+class Vst3PluginPool
+{
+public:
+	typedef Vst3PluginFactory::host_context_type host_context_type;
+	//! プールのインスタンスを作成するたびに、そのインスタンス用のホストコンテキストを作成する関数
+	typedef std::function<host_context_type()> host_context_creator_t;
+	typedef ClassInfo::cid_t cid_t;
+
+	//! プールのインスタンスに適用する設定
+	struct Setup
+	{
+		Setup()
+			:	sampling_rate_(44100)
+			,	block_size_(512)
+			,	process_mode_(Steinberg::Vst::ProcessModes::kRealtime)
+			,	symbolic_sample_size_(Steinberg::Vst::SymbolicSampleSizes::kSample32)
+		{}
+
+		int					sampling_rate_;
+		int					block_size_;
+		Steinberg::int32	process_mode_;
+		//! kSample64を指定しても、プラグインが対応していない場合はkSample32で処理する
+		Steinberg::int32	symbolic_sample_size_;
+	};
+
+	Vst3PluginPool(Vst3PluginFactory &factory, Setup const &setup, host_context_creator_t create_host_context);
+	~Vst3PluginPool();
+
+	//! cidのインスタンスを常にnum_instances個用意しておくように指定する。
+	//! インスタンスはバックグラウンドスレッドで作成される。
+	void	Reserve(cid_t const &cid, size_t num_instances);
+
+	//! cidのインスタンスをプールから取り出す。
+	/*!
+		プールにインスタンスが無い場合は、この関数の中で作成してResumeする。
+		@throw std::runtime_error インスタンスを作成できなかった場合
+	*/
+	std::unique_ptr<Vst3Plugin>
+			Checkout(cid_t const &cid);
+
+	//! Checkoutしたインスタンスをプールに戻す。
+	//! インスタンスの状態と設定はバックグラウンドスレッドでデフォルトの状態に戻される。
+	//! pluginのProcessAudioやOnIdleは、この呼び出しの前に止めておくこと。
+	void	Checkin(cid_t const &cid, std::unique_ptr<Vst3Plugin> plugin);
+
+	//! すぐにCheckoutできるcidのインスタンスの数
+	size_t	GetNumAvailable(cid_t const &cid) const;
+
+private:
+	struct ClassPool
+	{
+		ClassPool() : num_reserved_(0), num_creating_(0) {}
+
+		size_t										num_reserved_;
+		size_t										num_creating_;
+		std::deque<std::unique_ptr<Vst3Plugin>>		available_;
+		std::deque<std::unique_ptr<Vst3Plugin>>		to_reset_;
+		std::shared_ptr<Vst3Plugin::StateData const>	default_state_;
+	};
+
+	std::unique_ptr<Vst3Plugin>
+			CreateInstance(cid_t const &cid);
+	void	FillThread();
+	//! setup_の設定をpluginに適用して、Resumeする
+	void	ApplySetup(Vst3Plugin &plugin) const;
+
+	Vst3PluginFactory &		factory_;
+	Setup					setup_;
+	host_context_creator_t	create_host_context_;
+
+	mutable std::mutex		mutex_;
+	std::condition_variable	cond_;
+	std::map<cid_t, ClassPool>	pools_;
+	bool					stop_;
+	std::thread				fill_thread_;
+};
+
+}	// ::hwm
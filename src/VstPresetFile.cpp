@@ -0,0 +1,247 @@
+#include "./VstPresetFile.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include "pluginterfaces/base/funknown.h"
+
+#include "./StrCnv.hpp"
+
+namespace hwm {
+
+constexpr char VstPresetFile::kComponentState[];
+constexpr char VstPresetFile::kControllerState[];
+constexpr char VstPresetFile::kMetaInfo[];
+
+namespace {
+
+	constexpr char kHeaderMagic[4] = { 'V', 'S', 'T', '3' };
+	constexpr char kChunkListMagic[4] = { 'L', 'i', 's', 't' };
+	constexpr std::int32_t kFormatVersion = 1;
+
+	constexpr size_t kClassIDStringSize = 32;
+	//! マジック、バージョン、クラスID、チャンクリストの位置
+	constexpr size_t kHeaderSize = 4 + 4 + kClassIDStringSize + 8;
+	//! ID、位置、サイズ
+	constexpr size_t kChunkEntrySize = 4 + 8 + 8;
+
+	//! クラスIDの文字列の各バイトが、TUIDの何バイト目に対応するか。
+	//! FUID::toStringと同じく、COM互換のTUIDでは先頭8バイトをGUIDの構造体のバイト順として扱う。
+#if COM_COMPATIBLE
+	constexpr int kClassIDByteOrder[16] = { 3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15 };
+#else
+	constexpr int kClassIDByteOrder[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+#endif
+
+	void ClassIDToString(VstPresetFile::cid_t const &class_id, char *dest)
+	{
+		static char const kHexDigits[] = "0123456789ABCDEF";
+		for(int i = 0; i < 16; ++i) {
+			auto const byte = static_cast<std::uint8_t>(class_id[kClassIDByteOrder[i]]);
+			dest[i * 2] = kHexDigits[byte >> 4];
+			dest[i * 2 + 1] = kHexDigits[byte & 0x0F];
+		}
+	}
+
+	bool StringToClassID(char const *src, VstPresetFile::cid_t &class_id)
+	{
+		auto hex = [](char c) -> int {
+			if('0' <= c && c <= '9') { return c - '0'; }
+			if('A' <= c && c <= 'F') { return c - 'A' + 10; }
+			if('a' <= c && c <= 'f') { return c - 'a' + 10; }
+			return -1;
+		};
+
+		for(int i = 0; i < 16; ++i) {
+			int const high = hex(src[i * 2]);
+			int const low = hex(src[i * 2 + 1]);
+			if(high < 0 || low < 0) {
+				return false;
+			}
+			class_id[kClassIDByteOrder[i]] = static_cast<Steinberg::int8>((high << 4) | low);
+		}
+		return true;
+	}
+
+	template<class T>
+	T ReadValue(char const *pos)
+	{
+		T value;
+		std::memcpy(&value, pos, sizeof(value));
+		return value;
+	}
+
+	template<class T>
+	void WriteValue(std::vector<char> &dest, T value)
+	{
+		char buf[sizeof(T)];
+		std::memcpy(buf, &value, sizeof(T));
+		dest.insert(dest.end(), buf, buf + sizeof(T));
+	}
+
+	//! ヘッダを解析して、クラスIDとチャンクリストの位置を取得する
+	bool ParseHeader(char const *header, VstPresetFile::cid_t &class_id, std::int64_t &list_offset)
+	{
+		if(std::memcmp(header, kHeaderMagic, 4) != 0) {
+			return false;
+		}
+		if(!StringToClassID(header + 8, class_id)) {
+			return false;
+		}
+		list_offset = ReadValue<std::int64_t>(header + 8 + kClassIDStringSize);
+		return true;
+	}
+
+}	// unnamed
+
+VstPresetFile::VstPresetFile(String const &path)
+	:	file_(path)
+{
+	char const *data = file_.data();
+	size_t const size = file_.size();
+
+	std::int64_t list_offset;
+	if(size < kHeaderSize || !ParseHeader(data, class_id_, list_offset)) {
+		throw std::runtime_error("not a vstpreset file");
+	}
+
+	if(list_offset < static_cast<std::int64_t>(kHeaderSize) ||
+	   static_cast<std::uint64_t>(list_offset) + 8 > size ||
+	   std::memcmp(data + list_offset, kChunkListMagic, 4) != 0)
+	{
+		throw std::runtime_error("the chunk list of the vstpreset file is broken");
+	}
+
+	auto const num_entries = ReadValue<std::int32_t>(data + list_offset + 4);
+	if(num_entries < 0 ||
+	   static_cast<std::uint64_t>(list_offset) + 8 + static_cast<std::uint64_t>(num_entries) * kChunkEntrySize > size)
+	{
+		throw std::runtime_error("the chunk list of the vstpreset file is broken");
+	}
+
+	chunks_.resize(num_entries);
+	char const *entry = data + list_offset + 8;
+	for(auto &chunk: chunks_) {
+		auto const offset = ReadValue<std::int64_t>(entry + 4);
+		auto const chunk_size = ReadValue<std::int64_t>(entry + 12);
+		if(offset < 0 || chunk_size < 0 ||
+		   static_cast<std::uint64_t>(offset) + static_cast<std::uint64_t>(chunk_size) > size)
+		{
+			throw std::runtime_error("a chunk of the vstpreset file is out of range");
+		}
+
+		std::memcpy(chunk.id_, entry, 4);
+		chunk.data_ = data + offset;
+		chunk.size_ = static_cast<size_t>(chunk_size);
+		entry += kChunkEntrySize;
+	}
+}
+
+VstPresetFile::Chunk const *
+		VstPresetFile::FindChunk(char const *id) const
+{
+	for(auto const &chunk: chunks_) {
+		if(std::memcmp(chunk.id_, id, 4) == 0) {
+			return &chunk;
+		}
+	}
+	return nullptr;
+}
+
+Vst3Plugin::StateData
+		VstPresetFile::GetState() const
+{
+	Vst3Plugin::StateData state;
+	if(auto const *chunk = FindChunk(kComponentState)) {
+		state.component_.assign(chunk->data_, chunk->data_ + chunk->size_);
+	}
+	if(auto const *chunk = FindChunk(kControllerState)) {
+		state.controller_.assign(chunk->data_, chunk->data_ + chunk->size_);
+	}
+	return state;
+}
+
+bool VstPresetFile::ReadClassID(String const &path, cid_t &class_id)
+{
+	std::FILE *file = std::fopen(to_utf8(path).c_str(), "rb");
+	if(!file) {
+		return false;
+	}
+
+	char header[kHeaderSize];
+	bool const read = (std::fread(header, 1, kHeaderSize, file) == kHeaderSize);
+	std::fclose(file);
+
+	std::int64_t list_offset;
+	return read && ParseHeader(header, class_id, list_offset);
+}
+
+void VstPresetFile::Write(String const &path,
+						  cid_t const &class_id,
+						  Vst3Plugin::StateData const &state,
+						  std::string const &meta_info)
+{
+	std::vector<char> data;
+	data.insert(data.end(), std::begin(kHeaderMagic), std::end(kHeaderMagic));
+	WriteValue<std::int32_t>(data, kFormatVersion);
+	char class_id_string[kClassIDStringSize];
+	ClassIDToString(class_id, class_id_string);
+	data.insert(data.end(), std::begin(class_id_string), std::end(class_id_string));
+	//! チャンクリストの位置は、チャンクを書き出した後で埋める
+	WriteValue<std::int64_t>(data, 0);
+
+	struct Entry
+	{
+		char const *	id_;
+		std::int64_t	offset_;
+		std::int64_t	size_;
+	};
+	std::vector<Entry> entries;
+
+	auto add_chunk = [&](char const *id, char const *chunk_data, size_t chunk_size) {
+		entries.push_back(Entry { id, static_cast<std::int64_t>(data.size()), static_cast<std::int64_t>(chunk_size) });
+		data.insert(data.end(), chunk_data, chunk_data + chunk_size);
+	};
+
+	if(!state.component_.empty()) {
+		add_chunk(kComponentState, state.component_.data(), state.component_.size());
+	}
+	if(!state.controller_.empty()) {
+		add_chunk(kControllerState, state.controller_.data(), state.controller_.size());
+	}
+	if(!meta_info.empty()) {
+		add_chunk(kMetaInfo, meta_info.data(), meta_info.size());
+	}
+
+	auto const list_offset = static_cast<std::int64_t>(data.size());
+	std::memcpy(data.data() + 8 + kClassIDStringSize, &list_offset, sizeof(list_offset));
+
+	data.insert(data.end(), std::begin(kChunkListMagic), std::end(kChunkListMagic));
+	WriteValue<std::int32_t>(data, static_cast<std::int32_t>(entries.size()));
+	for(auto const &entry: entries) {
+		data.insert(data.end(), entry.id_, entry.id_ + 4);
+		WriteValue<std::int64_t>(data, entry.offset_);
+		WriteValue<std::int64_t>(data, entry.size_);
+	}
+
+	//! 既存のプリセットを上書きする場合に、書き込みの途中で失敗しても壊れないように、
+	//! 一時ファイルに書き出してから置き換える
+	std::string const dest_path = to_utf8(path);
+	std::string const tmp_path = dest_path + ".tmp";
+
+	std::FILE *file = std::fopen(tmp_path.c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("cannot open the vstpreset file");
+	}
+
+	bool const written = (std::fwrite(data.data(), 1, data.size(), file) == data.size());
+	bool const closed = (std::fclose(file) == 0);
+	if(!written || !closed || std::rename(tmp_path.c_str(), dest_path.c_str()) != 0) {
+		std::remove(tmp_path.c_str());
+		throw std::runtime_error("failed to write the vstpreset file");
+	}
+}
+
+}	// ::hwm
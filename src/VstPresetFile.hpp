@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "./MappedFile.hpp"
+#include "./Vst3Plugin.hpp"
+#include "./Vst3PluginFactory.hpp"
+
+namespace hwm {
+
+//! .vstpresetファイルを読み書きするクラス
+/*!
+	.vstpresetは、ヘッダ(マジック、バージョン、クラスID、チャンクリストの位置)、
+	各チャンクのデータ、チャンクリストの順に並んだファイル形式。
+
+	読み込みではファイルをメモリにマップして、チャンクリストだけを解析する。
+	各チャンクのデータはコピーせず、マップされた領域を直接参照する。
+*/
+class VstPresetFile
+{
+public:
+	typedef ClassInfo::cid_t cid_t;
+
+	//! IComponentの状態
+	static constexpr char kComponentState[] = "Comp";
+	//! IEditControllerの状態
+	static constexpr char kControllerState[] = "Cont";
+	//! XML形式のメタ情報
+	static constexpr char kMetaInfo[] = "Info";
+
+	//! マップされた領域を参照するチャンク
+	struct Chunk
+	{
+		char			id_[4];
+		char const *	data_;
+		size_t			size_;
+	};
+
+	//! @throw std::runtime_error ファイルを開けない場合や、形式が正しくない場合
+	explicit
+	VstPresetFile(String const &path);
+
+	cid_t const &	GetClassID() const { return class_id_; }
+
+	std::vector<Chunk> const &
+					GetChunks() const { return chunks_; }
+
+	//! idのチャンクを返す。ない場合はnullptr
+	Chunk const *	FindChunk(char const *id) const;
+
+	//! ComponentとControllerのチャンクを、Vst3Plugin::SetStateに渡せる形式で取得する
+	Vst3Plugin::StateData
+					GetState() const;
+
+	//! ファイルの先頭のヘッダだけを読んで、クラスIDを取得する。ファイル全体はマップしない。
+	//! @return ファイルを開けない場合や、.vstpresetでない場合はfalse
+	static
+	bool	ReadClassID(String const &path, cid_t &class_id);
+
+	//! .vstpresetファイルを書き出す
+	/*!
+		@param meta_info 空でなければ、Infoチャンクとして書き出す
+		@throw std::runtime_error 書き込みに失敗した場合
+	*/
+	static
+	void	Write(String const &path,
+				  cid_t const &class_id,
+				  Vst3Plugin::StateData const &state,
+				  std::string const &meta_info = std::string());
+
+private:
+	MappedFile			file_;
+	cid_t				class_id_;
+	std::vector<Chunk>	chunks_;
+};
+
+}	// ::hwm
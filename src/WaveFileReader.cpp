@@ -0,0 +1,208 @@
+#include "./WaveFileReader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "./StrCnv.hpp"
+
+namespace hwm {
+
+namespace {
+
+	size_t const kFileBufferSize = 1 << 16;
+	//! 一度にファイルから読み込むフレーム数
+	size_t const kReadFrames = 2048;
+	//! ReadInterleavedが扱えるチャンネル数の上限
+	size_t const kMaxChannels = 64;
+
+	std::uint16_t const kWaveFormatPcm = 1;
+	std::uint16_t const kWaveFormatIeeeFloat = 3;
+	std::uint16_t const kWaveFormatExtensible = 0xFFFE;
+
+	template<class T>
+	T ReadLE(char const *src)
+	{
+		T value = 0;
+		for(size_t i = 0; i < sizeof(T); ++i) {
+			value |= static_cast<T>(static_cast<unsigned char>(src[i])) << (i * 8);
+		}
+		return value;
+	}
+
+	bool ReadExactly(std::FILE *file, char *dest, size_t size)
+	{
+		return std::fread(dest, 1, size, file) == size;
+	}
+
+}	// unnamed
+
+WaveFileReader::WaveFileReader()
+	:	file_(nullptr)
+	,	num_channels_(0)
+	,	sampling_rate_(0)
+	,	sample_format_(SampleFormat::kFloat32)
+	,	data_offset_(0)
+	,	num_frames_(0)
+	,	position_(0)
+{}
+
+WaveFileReader::~WaveFileReader()
+{
+	Close();
+}
+
+void WaveFileReader::Open(String const &path)
+{
+	Close();
+
+	std::FILE *file = std::fopen(to_utf8(path).c_str(), "rb");
+	if(!file) {
+		throw std::runtime_error("cannot open the input file");
+	}
+
+	file_buffer_.resize(kFileBufferSize);
+	std::setvbuf(file, file_buffer_.data(), _IOFBF, file_buffer_.size());
+	file_ = file;
+
+	try {
+		ReadHeader();
+	} catch(...) {
+		Close();
+		throw;
+	}
+
+	position_ = 0;
+	read_buffer_.resize(kReadFrames * num_channels_ * GetBytesPerSample(sample_format_));
+}
+
+void WaveFileReader::Close()
+{
+	if(file_) {
+		std::fclose(file_);
+		file_ = nullptr;
+	}
+}
+
+bool WaveFileReader::IsOpened() const
+{
+	return file_ != nullptr;
+}
+
+void WaveFileReader::ReadHeader()
+{
+	char riff[12];
+	if(!ReadExactly(file_, riff, sizeof(riff)) ||
+	   std::memcmp(riff, "RIFF", 4) != 0 ||
+	   std::memcmp(riff + 8, "WAVE", 4) != 0)
+	{
+		throw std::runtime_error("the input file is not a wave file");
+	}
+
+	bool found_format = false;
+	for( ; ; ) {
+		char chunk_header[8];
+		if(!ReadExactly(file_, chunk_header, sizeof(chunk_header))) {
+			throw std::runtime_error("the wave file has no data chunk");
+		}
+
+		std::uint32_t const chunk_size = ReadLE<std::uint32_t>(chunk_header + 4);
+
+		if(std::memcmp(chunk_header, "fmt ", 4) == 0) {
+			std::vector<char> fmt(std::max<std::uint32_t>(chunk_size, 16));
+			if(!ReadExactly(file_, fmt.data(), chunk_size)) {
+				throw std::runtime_error("failed to read the fmt chunk");
+			}
+
+			std::uint16_t format_tag = ReadLE<std::uint16_t>(fmt.data());
+			num_channels_ = ReadLE<std::uint16_t>(fmt.data() + 2);
+			sampling_rate_ = static_cast<int>(ReadLE<std::uint32_t>(fmt.data() + 4));
+			std::uint16_t const bits_per_sample = ReadLE<std::uint16_t>(fmt.data() + 14);
+
+			//! WAVE_FORMAT_EXTENSIBLEでは、SubFormatのGUIDの先頭2バイトが実際のフォーマット
+			if(format_tag == kWaveFormatExtensible && chunk_size >= 26) {
+				format_tag = ReadLE<std::uint16_t>(fmt.data() + 24);
+			}
+
+			if(format_tag == kWaveFormatPcm && bits_per_sample == 16) {
+				sample_format_ = SampleFormat::kInt16;
+			} else if(format_tag == kWaveFormatPcm && bits_per_sample == 24) {
+				sample_format_ = SampleFormat::kInt24;
+			} else if(format_tag == kWaveFormatPcm && bits_per_sample == 32) {
+				sample_format_ = SampleFormat::kInt32;
+			} else if(format_tag == kWaveFormatIeeeFloat && bits_per_sample == 32) {
+				sample_format_ = SampleFormat::kFloat32;
+			} else {
+				throw std::runtime_error("unsupported wave format");
+			}
+
+			if(num_channels_ == 0 || num_channels_ > kMaxChannels) {
+				throw std::runtime_error("unsupported number of channels");
+			}
+			found_format = true;
+		} else if(std::memcmp(chunk_header, "data", 4) == 0) {
+			if(!found_format) {
+				throw std::runtime_error("the data chunk appears before the fmt chunk");
+			}
+
+			data_offset_ = std::ftell(file_);
+			num_frames_ = chunk_size / (num_channels_ * GetBytesPerSample(sample_format_));
+			return;
+		} else {
+			//! チャンクは2バイト境界に揃えられている
+			if(std::fseek(file_, chunk_size + (chunk_size & 1), SEEK_CUR) != 0) {
+				throw std::runtime_error("failed to skip a chunk");
+			}
+		}
+	}
+}
+
+size_t WaveFileReader::Read(float * const * channels, size_t num_frames)
+{
+	assert(IsOpened());
+
+	size_t const bytes_per_frame = num_channels_ * GetBytesPerSample(sample_format_);
+
+	size_t total = 0;
+	while(total < num_frames && position_ < num_frames_) {
+		size_t const n = static_cast<size_t>(
+			std::min<std::uint64_t>({ num_frames - total, kReadFrames, num_frames_ - position_ }));
+
+		size_t const read = std::fread(read_buffer_.data(), bytes_per_frame, n, file_);
+		if(read == 0) {
+			if(std::ferror(file_)) {
+				throw std::runtime_error("failed to read the input file");
+			}
+			//! ヘッダーのサイズより実際のデータが短い
+			num_frames_ = position_;
+			break;
+		}
+
+		//! ReadInterleavedはチャンネルの先頭ポインタの配列を受け取るので、書き込み位置をずらしたものを用意する
+		float *heads[kMaxChannels];
+		for(size_t ch = 0; ch < num_channels_; ++ch) {
+			heads[ch] = channels[ch] + total;
+		}
+		ReadInterleaved(read_buffer_.data(), sample_format_, num_channels_, heads, read);
+
+		total += read;
+		position_ += read;
+	}
+
+	return total;
+}
+
+void WaveFileReader::Seek(std::uint64_t frame)
+{
+	assert(IsOpened());
+
+	frame = std::min(frame, num_frames_);
+	std::uint64_t const offset = data_offset_ + frame * num_channels_ * GetBytesPerSample(sample_format_);
+	if(std::fseek(file_, static_cast<long>(offset), SEEK_SET) != 0) {
+		throw std::runtime_error("failed to seek the input file");
+	}
+	position_ = frame;
+}
+
+}	// ::hwm
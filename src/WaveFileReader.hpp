@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "./SampleConvert.hpp"
+
+namespace hwm {
+
+//! Waveファイルを読み込んで、チャンネルごとの32bit浮動小数点数のバッファに変換するクラス
+/*!
+	16/24/32bitの整数(WAVE_FORMAT_PCM)と32bit浮動小数点数(WAVE_FORMAT_IEEE_FLOAT)、
+	およびそれらを表すWAVE_FORMAT_EXTENSIBLEに対応する。
+	データは必要な分だけ順にファイルから読み込むので、長いファイルでもメモリ使用量は一定になる。
+*/
+struct WaveFileReader
+{
+	WaveFileReader();
+	~WaveFileReader();
+
+	WaveFileReader(WaveFileReader const &) = delete;
+	WaveFileReader & operator=(WaveFileReader const &) = delete;
+
+	//! @throw std::runtime_error ファイルが開けなかった場合や、対応していないフォーマットの場合
+	void	Open(String const &path);
+	void	Close();
+	bool	IsOpened() const;
+
+	size_t	GetNumChannels() const { return num_channels_; }
+	int		GetSamplingRate() const { return sampling_rate_; }
+	SampleFormat
+			GetSampleFormat() const { return sample_format_; }
+
+	//! ファイル全体のフレーム数
+	std::uint64_t
+			GetNumFrames() const { return num_frames_; }
+
+	//! 次に読み込むフレームの位置
+	std::uint64_t
+			GetPosition() const { return position_; }
+
+	//! 最大でnum_framesフレームを読み込んでchannelsに書き出す。
+	//! channelsはGetNumChannels()個のチャンネルの先頭ポインタの配列
+	//! @return 読み込んだフレーム数。ファイルの終端に達していれば0
+	//! @throw std::runtime_error 読み込みに失敗した場合
+	size_t	Read(float * const * channels, size_t num_frames);
+
+	//! 次に読み込む位置をframeに移動する
+	void	Seek(std::uint64_t frame);
+
+private:
+	void	ReadHeader();
+
+	std::FILE *			file_;
+	size_t				num_channels_;
+	int					sampling_rate_;
+	SampleFormat		sample_format_;
+	std::uint64_t		data_offset_;
+	std::uint64_t		num_frames_;
+	std::uint64_t		position_;
+	std::vector<char>	read_buffer_;
+	std::vector<char>	file_buffer_;
+};
+
+}	// ::hwm
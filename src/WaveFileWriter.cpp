@@ -0,0 +1,175 @@
+#include "./WaveFileWriter.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include "./SampleConvert.hpp"
+#include "./ScopeExit.hpp"
+#include "./StrCnv.hpp"
+
+namespace hwm {
+
+namespace {
+
+	size_t const kFileBufferSize = 1 << 20;
+	std::uint16_t const kWaveFormatIeeeFloat = 3;
+
+	template<class T>
+	void WriteLE(std::vector<char> &dest, T value)
+	{
+		for(size_t i = 0; i < sizeof(T); ++i) {
+			dest.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+		}
+	}
+
+}	// unnamed
+
+WaveFileWriter::WaveFileWriter()
+	:	file_(nullptr)
+	,	format_(Format::kWave)
+	,	num_channels_(0)
+	,	sampling_rate_(0)
+	,	written_samples_(0)
+{}
+
+WaveFileWriter::~WaveFileWriter()
+{
+	try {
+		Close();
+	} catch(std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+	}
+}
+
+WaveFileWriter::Format
+		WaveFileWriter::FormatFromPath(String const &path)
+{
+	String const ext = L".raw";
+	if(path.size() >= ext.size() && std::equal(ext.rbegin(), ext.rend(), path.rbegin())) {
+		return Format::kRaw;
+	}
+	return Format::kWave;
+}
+
+void WaveFileWriter::Open(String const &path, Format format, size_t num_channels, int sampling_rate)
+{
+	assert(num_channels > 0);
+	Close();
+
+	std::FILE *file = std::fopen(to_utf8(path).c_str(), "wb");
+	if(!file) {
+		throw std::runtime_error("cannot open the output file");
+	}
+
+	file_buffer_.resize(kFileBufferSize);
+	std::setvbuf(file, file_buffer_.data(), _IOFBF, file_buffer_.size());
+
+	file_ = file;
+	format_ = format;
+	num_channels_ = num_channels;
+	sampling_rate_ = sampling_rate;
+	written_samples_ = 0;
+
+	if(format_ == Format::kWave) {
+		//! サイズ情報はCloseの時に書き直す
+		WriteHeader();
+	}
+}
+
+void WaveFileWriter::Close()
+{
+	if(!file_) {
+		return;
+	}
+
+	std::FILE *file = file_;
+	HWM_SCOPE_EXIT([&file, this] {
+		std::fclose(file);
+		file_ = nullptr;
+	});
+
+	if(format_ == Format::kWave) {
+		std::fseek(file_, 0, SEEK_SET);
+		WriteHeader();
+	}
+}
+
+bool WaveFileWriter::IsOpened() const
+{
+	return file_ != nullptr;
+}
+
+void WaveFileWriter::Write(float const * const * channels, size_t num_samples)
+{
+	assert(IsOpened());
+
+	interleaved_.resize(num_samples * num_channels_);
+	Interleave(channels, num_channels_, interleaved_.data(), num_samples);
+	FlushInterleaved(num_samples);
+}
+
+void WaveFileWriter::Write(double const * const * channels, size_t num_samples)
+{
+	WriteImpl(channels, num_samples);
+}
+
+template<class SampleType>
+void WaveFileWriter::WriteImpl(SampleType const * const * channels, size_t num_samples)
+{
+	assert(IsOpened());
+
+	interleaved_.resize(num_samples * num_channels_);
+	for(size_t ch = 0; ch < num_channels_; ++ch) {
+		SampleType const *src = channels[ch];
+		float *dest = interleaved_.data() + ch;
+		for(size_t smp = 0; smp < num_samples; ++smp) {
+			dest[smp * num_channels_] = static_cast<float>(src[smp]);
+		}
+	}
+
+	FlushInterleaved(num_samples);
+}
+
+void WaveFileWriter::FlushInterleaved(size_t num_samples)
+{
+	size_t const written = std::fwrite(interleaved_.data(), sizeof(float), interleaved_.size(), file_);
+	if(written != interleaved_.size()) {
+		throw std::runtime_error("failed to write the output file");
+	}
+
+	written_samples_ += num_samples;
+}
+
+void WaveFileWriter::WriteHeader()
+{
+	std::uint64_t const data_bytes = written_samples_ * num_channels_ * sizeof(float);
+	//! RIFFのサイズフィールドは32bitなので、4GBを超える場合は上限に張り付かせる
+	std::uint32_t const data_size =
+		static_cast<std::uint32_t>(std::min<std::uint64_t>(data_bytes, 0xFFFFFFFFu - 36));
+
+	std::uint16_t const block_align = static_cast<std::uint16_t>(num_channels_ * sizeof(float));
+
+	std::vector<char> header;
+	header.reserve(44);
+	header.insert(header.end(), { 'R', 'I', 'F', 'F' });
+	WriteLE<std::uint32_t>(header, 36 + data_size);
+	header.insert(header.end(), { 'W', 'A', 'V', 'E' });
+	header.insert(header.end(), { 'f', 'm', 't', ' ' });
+	WriteLE<std::uint32_t>(header, 16);
+	WriteLE<std::uint16_t>(header, kWaveFormatIeeeFloat);
+	WriteLE<std::uint16_t>(header, static_cast<std::uint16_t>(num_channels_));
+	WriteLE<std::uint32_t>(header, static_cast<std::uint32_t>(sampling_rate_));
+	WriteLE<std::uint32_t>(header, static_cast<std::uint32_t>(sampling_rate_ * block_align));
+	WriteLE<std::uint16_t>(header, block_align);
+	WriteLE<std::uint16_t>(header, 32);
+	header.insert(header.end(), { 'd', 'a', 't', 'a' });
+	WriteLE<std::uint32_t>(header, data_size);
+
+	if(std::fwrite(header.data(), 1, header.size(), file_) != header.size()) {
+		throw std::runtime_error("failed to write the wave header");
+	}
+}
+
+}	// ::hwm
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace hwm {
+
+//! オーディオデータを32bit浮動小数点形式でファイルに書き出すクラス
+/*!
+	kWave形式では、WAVE_FORMAT_IEEE_FLOATのWaveファイルとして書き出す。
+	kRaw形式では、ヘッダーなしのインターリーブされたfloat(リトルエンディアン)として書き出す。
+	Waveファイルのヘッダーのサイズ情報は、Closeまたはデストラクタで確定する。
+*/
+struct WaveFileWriter
+{
+	enum class Format {
+		kWave,
+		kRaw,
+	};
+
+	WaveFileWriter();
+	~WaveFileWriter();
+
+	WaveFileWriter(WaveFileWriter const &) = delete;
+	WaveFileWriter & operator=(WaveFileWriter const &) = delete;
+
+	//! @throw std::runtime_error ファイルが開けなかった場合
+	void	Open(String const &path, Format format, size_t num_channels, int sampling_rate);
+	void	Close();
+	bool	IsOpened() const;
+
+	//! channelsはnum_channels個のチャンネルの先頭ポインタの配列
+	//! @throw std::runtime_error 書き込みに失敗した場合
+	void	Write(float const * const * channels, size_t num_samples);
+	//! 64bitのデータは32bit浮動小数点数に変換して書き出す
+	void	Write(double const * const * channels, size_t num_samples);
+
+	size_t	GetNumChannels() const { return num_channels_; }
+	std::uint64_t
+			GetWrittenSamples() const { return written_samples_; }
+
+	//! 拡張子が.rawであればkRaw、それ以外はkWaveを返す
+	static Format
+			FormatFromPath(String const &path);
+
+private:
+	void	WriteHeader();
+
+	//! interleaved_の内容を書き出す
+	void	FlushInterleaved(size_t num_samples);
+
+	template<class SampleType>
+	void	WriteImpl(SampleType const * const * channels, size_t num_samples);
+
+	std::FILE *			file_;
+	Format				format_;
+	size_t				num_channels_;
+	int					sampling_rate_;
+	std::uint64_t		written_samples_;
+	std::vector<float>	interleaved_;
+	std::vector<char>	file_buffer_;
+};
+
+}	// ::hwm
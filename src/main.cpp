@@ -1,13 +1,27 @@
 #include <stdio.h>
 #include <math.h>
 #include <portaudio.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <string>
+#include <thread>
 
 #include "./Vst3PluginFactory.hpp"
 #include "./Vst3HostCallback.hpp"
 #include "./Vst3Plugin.hpp"
 #include "./Buffer.hpp"
 #include "./StrCnv.hpp"
+#include "./InputSource.hpp"
+#include "./LoudnessAnalyzer.hpp"
+#include "./OfflineRenderer.hpp"
+#include "./WaveFileWriter.hpp"
+#include "./SampleConvert.hpp"
+#include "./AudioDevice.hpp"
+#include "./NullAudioDevice.hpp"
+#include "./PluginScanner.hpp"
+#include "./PortAudioDevice.hpp"
+#include "./VstPresetFile.hpp"
 #include <pluginterfaces/vst/ivstaudioprocessor.h>
 
 #define NUM_SECONDS   (4)
@@ -19,56 +33,137 @@
 #endif
 
 hwm::Vst3Plugin *g_plugin;
+//! --input liveが指定された場合に、デバイスの入力をプラグインの入力バスに渡すソース
+std::shared_ptr<hwm::LiveInputSource> g_live_input;
 std::vector<int> const g_notes = { 48, 50, 52, 53 };
 int g_last_note_index = -1;
 int g_current_pos = 0;
 
-/* This routine will be called by the PortAudio engine when audio is needed.
- ** It may called at interrupt level on some machines so don't do anything
- ** that could mess up the system like calling malloc() or free().
+/*
+ * This routine will be called from the audio thread of the AudioDevice.
+ * Don't do anything that could mess up the system like calling malloc() or free().
+ * outputs are the buffers of the device itself, so the plugin renders into them directly.
  */
-static int patestCallback( const void *inputBuffer, void *outputBuffer,
-                          unsigned long framesPerBuffer,
-                          const PaStreamCallbackTimeInfo* timeInfo,
-                          PaStreamCallbackFlags statusFlags,
-                          void *userData )
+static void AudioCallback(float const * const * inputs, size_t num_inputs,
+                          float ** outputs, size_t num_outputs,
+                          size_t num_frames)
 {
     assert(g_plugin);
-    
-    int note_index = ((int)timeInfo->currentTime) % g_notes.size();
+
+    if(g_live_input) {
+        g_live_input->SetDeviceInputs(inputs, num_inputs, num_frames);
+    }
+
+    int note_index = (g_current_pos / SAMPLE_RATE) % g_notes.size();
     if(note_index != g_last_note_index) {
-        if(g_last_note_index >= 0) { g_plugin->AddNoteOff(g_notes[note_index]); }
+        if(g_last_note_index >= 0) { g_plugin->AddNoteOff(g_notes[g_last_note_index]); }
         g_plugin->AddNoteOn(g_notes[note_index]);
     }
     g_last_note_index = note_index;
-    
-    float *out = (float*)outputBuffer;
-    
-    (void) timeInfo; /* Prevent unused variable warnings. */
-    (void) statusFlags;
-    (void) inputBuffer;
-
-    auto const result = g_plugin->ProcessAudio(g_current_pos, framesPerBuffer);
-    for(int i = 0; i<framesPerBuffer; i++ ) {
-        *out++ = result[0][i];
-        *out++ = result[1][i];
+
+    if(g_plugin->GetNumOutputs() == num_outputs) {
+        g_plugin->ProcessAudioInto(g_current_pos, num_frames, outputs);
+    } else {
+        //! プラグインの出力チャンネル数がデバイスと異なる場合は、内部のバッファから合う分だけコピーする
+        auto const result = g_plugin->ProcessAudio(g_current_pos, num_frames);
+        for(size_t ch = 0; ch < num_outputs; ++ch) {
+            if(ch < g_plugin->GetNumOutputs()) {
+                std::copy_n(result[ch], num_frames, outputs[ch]);
+            } else {
+                std::fill_n(outputs[ch], num_frames, 0.0f);
+            }
+        }
     }
-    g_current_pos += framesPerBuffer;
-    
-    return paContinue;
+    g_current_pos += num_frames;
 }
 
 /*
- * This routine is called by portaudio when playback is done.
+ * Render the plugin output into a file as fast as possible, without any audio device.
  */
-static void StreamFinished( void* userData )
+static int RenderOffline(hwm::Vst3Plugin &plugin, std::string const &path, double seconds)
 {
-    printf( "Stream Completed.\n" );
+    hwm::WaveFileWriter writer;
+    String const output_path = hwm::to_wstr(path);
+    writer.Open(output_path,
+                hwm::WaveFileWriter::FormatFromPath(output_path),
+                plugin.GetNumOutputs(),
+                SAMPLE_RATE);
+
+    hwm::OfflineRenderer renderer(plugin, SAMPLE_RATE, FRAMES_PER_BUFFER);
+    int last_note_index = -1;
+    renderer.SetBlockCallback([&last_note_index](hwm::Vst3Plugin &plugin, size_t frame_pos, size_t /*num_samples*/) {
+        int note_index = (frame_pos / SAMPLE_RATE) % g_notes.size();
+        if(note_index != last_note_index) {
+            if(last_note_index >= 0) { plugin.AddNoteOff(g_notes[last_note_index]); }
+            plugin.AddNoteOn(g_notes[note_index]);
+        }
+        last_note_index = note_index;
+    });
+
+    //! レンダリングした出力のラウドネスとトゥルーピークを、別スレッドで並行して測定する
+    hwm::LoudnessAnalyzer analyzer;
+    auto tap = analyzer.CreateTap(plugin.GetNumOutputs(), SAMPLE_RATE, SAMPLE_RATE,
+                                  hwm::AudioTap::OverflowPolicy::kWait);
+    plugin.SetOutputTap(tap);
+
+    auto const result = renderer.Render(static_cast<std::uint64_t>(seconds * SAMPLE_RATE), writer);
+    writer.Close();
+
+    plugin.SetOutputTap(nullptr);
+    analyzer.Flush();
+
+    printf("Rendered %llu samples in %.3f seconds (x%.2f realtime).\n",
+           (unsigned long long)result.rendered_samples_,
+           result.elapsed_seconds_,
+           result.realtime_factor_);
+
+    hwm::LoudnessStatistics loudness;
+    if(analyzer.GetStatistics(tap.get(), loudness)) {
+        printf("Integrated: %.1f LUFS, Max momentary: %.1f LUFS, Max short-term: %.1f LUFS, True peak: %.1f dBTP\n",
+               loudness.integrated_,
+               loudness.max_momentary_,
+               loudness.max_short_term_,
+               loudness.true_peak_);
+    }
+    return 0;
 }
 
 /*******************************************************************/
-int main(void)
+int main(int argc, char **argv)
 {
+    //! PluginScannerがワーカープロセスとしてこの実行ファイルを起動した場合は、スキャンだけを行って終了する
+    if(hwm::PluginScanner::IsWorkerCommandLine(argc, argv)) {
+        return hwm::PluginScanner::WorkerMain(argc, argv);
+    }
+
+    //! --render <output.wav|output.raw> [seconds] が指定された場合は、
+    //! オーディオデバイスを使用せずにオフラインでファイルに書き出す
+    //! --driver <portaudio|null|null-free> で再生に使用するドライバーを指定する
+    //! --input <generator|sine|live|ファイルのパス> で、プラグインの最初の入力バスに渡す信号を指定する
+    //! --preset <.vstpresetのパス> で、プラグインのロード後に適用するプリセットを指定する
+    //! --bench-kernels が指定された場合は、サンプルフォーマット変換のカーネルのベンチマークを実行する
+    std::string render_path;
+    double render_seconds = NUM_SECONDS;
+    std::string driver_name = "portaudio";
+    std::string input_name = "generator";
+    std::string preset_path;
+    for(int i = 1; i < argc; ++i) {
+        std::string const arg = argv[i];
+        if(arg == "--bench-kernels") {
+            hwm::RunSampleConvertBenchmark();
+            return 0;
+        } else if(arg == "--render" && i + 1 < argc) {
+            render_path = argv[++i];
+            if(i + 1 < argc && argv[i + 1][0] != '-') { render_seconds = std::stod(argv[++i]); }
+        } else if(arg == "--driver" && i + 1 < argc) {
+            driver_name = argv[++i];
+        } else if(arg == "--input" && i + 1 < argc) {
+            input_name = argv[++i];
+        } else if(arg == "--preset" && i + 1 < argc) {
+            preset_path = argv[++i];
+        }
+    }
+
     hwm::Vst3HostCallback host_context;
     
     String path = L"/Library/Audio/Plug-Ins/VST3/Zebra2.vst3/Contents/MacOS/Zebra2";
@@ -98,72 +193,119 @@ int main(void)
             plugin->RestartComponent(flags);
         }
     });
+    host_context.SetParameterChangeNotificationHandler([&plugin](Steinberg::Vst::ParamID id, Steinberg::Vst::ParamValue value) {
+        if(plugin) {
+            plugin->PerformEdit(id, value);
+        }
+    });
     
     plugin = factory.CreateByIndex(effect_indices[0], host_context.GetUnknownPtr());
 
+    if(!preset_path.empty()) {
+        try {
+            hwm::VstPresetFile const preset(hwm::to_wstr(preset_path));
+            if(preset.GetClassID() != plugin->GetClassID()) {
+                std::cout << "Warning: the preset is not for " << hwm::to_utf8(plugin->GetEffectName()) << "." << std::endl;
+            } else {
+                plugin->SetState(preset.GetState());
+            }
+        } catch(std::exception &e) {
+            std::cout << "Failed to apply the preset : " << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-    
-    PaStreamParameters outputParameters;
-    PaStream *stream;
-    PaError err;
-    
-    printf("PortAudio Test: output sine wave. SR = %d, BufSize = %d\n", SAMPLE_RATE, FRAMES_PER_BUFFER);
-    
-    err = Pa_Initialize();
-    if( err != paNoError ) goto error;
-    
-    outputParameters.device = Pa_GetDefaultOutputDevice(); /* default output device */
-    if (outputParameters.device == paNoDevice) {
-        fprintf(stderr,"Error: No default output device.\n");
-        goto error;
+    size_t const num_plugin_inputs = plugin->GetNumInputBuses() > 0 ? plugin->GetInputBusChannels(0) : 0;
+    if(num_plugin_inputs > 0) {
+        if(input_name == "sine") {
+            plugin->SetInputSource(0, std::make_shared<hwm::GeneratorInputSource>(hwm::TestWaveform::kSine, SAMPLE_RATE));
+        } else if(input_name == "live") {
+            if(!render_path.empty()) {
+                std::cout << "Live input is not available while rendering offline." << std::endl;
+                return 1;
+            }
+            g_live_input = std::make_shared<hwm::LiveInputSource>(0, num_plugin_inputs);
+            plugin->SetInputSource(0, g_live_input);
+        } else if(input_name != "generator") {
+            try {
+                auto source = std::make_shared<hwm::FileInputSource>(hwm::to_wstr(input_name), true);
+                if(source->GetSamplingRate() != SAMPLE_RATE) {
+                    std::cout << "Warning: the sampling rate of the input file is " << source->GetSamplingRate() << "Hz." << std::endl;
+                }
+                plugin->SetInputSource(0, source);
+            } catch(std::exception &e) {
+                std::cout << "Failed to open the input file : " << e.what() << std::endl;
+                return 1;
+            }
+        }
     }
-    outputParameters.channelCount = 2;       /* stereo output */
-    outputParameters.sampleFormat = paFloat32; /* 32 bit floating point output */
-    outputParameters.suggestedLatency = Pa_GetDeviceInfo( outputParameters.device )->defaultLowOutputLatency;
-    outputParameters.hostApiSpecificStreamInfo = NULL;
+
+    if(!render_path.empty()) {
+        int const ret = RenderOffline(*plugin, render_path, render_seconds);
+        plugin.reset();
+        return ret;
+    }
+
     
+    printf("PortAudio Test: output sine wave. SR = %d, BufSize = %d\n", SAMPLE_RATE, FRAMES_PER_BUFFER);
+
     plugin->SetBlockSize(FRAMES_PER_BUFFER);
     plugin->SetSamplingRate(SAMPLE_RATE);
     plugin->Resume();
     g_plugin = plugin.get();
-    
-    err = Pa_OpenStream(
-                        &stream,
-                        NULL, /* no input */
-                        &outputParameters,
-                        SAMPLE_RATE,
-                        FRAMES_PER_BUFFER,
-                        paClipOff,      /* we won't output out of range samples so don't bother clipping them */
-                        patestCallback,
-                        nullptr );
-    if( err != paNoError ) goto error;
-    
-    err = Pa_SetStreamFinishedCallback( stream, &StreamFinished );
-    if( err != paNoError ) goto error;
-    
-    err = Pa_StartStream( stream );
-    if( err != paNoError ) goto error;
-    
-    printf("Play for %d seconds.\n", NUM_SECONDS );
-    Pa_Sleep( NUM_SECONDS * 1000 );
-    
-    err = Pa_StopStream( stream );
-    if( err != paNoError ) goto error;
-    
-    err = Pa_CloseStream( stream );
-    if( err != paNoError ) goto error;
-    
-    Pa_Terminate();
+
+    plugin->SetOutputParameterChangeHandler([](Steinberg::Vst::ParamID id, Steinberg::Vst::ParamValue value) {
+        std::cout << "Output parameter [" << id << "] : " << value << std::endl;
+    });
+
+    try {
+        auto device = hwm::CreateAudioDevice(driver_name);
+        hwm::AudioDevice::Config config;
+        config.sampling_rate_ = SAMPLE_RATE;
+        config.block_size_ = FRAMES_PER_BUFFER;
+        //! ライブ入力を使用する場合は、全二重でストリームを開く
+        config.num_inputs_ = g_live_input ? num_plugin_inputs : 0;
+        config.num_outputs_ = 2;
+        device->Open(config, AudioCallback);
+        printf("Driver : %s\n", device->GetDriverName());
+        if(auto *pa_device = dynamic_cast<hwm::PortAudioDevice *>(device.get())) {
+            printf("Stream is %s.\n", pa_device->IsNonInterleaved() ? "non-interleaved" : "interleaved");
+        }
+
+        device->Start();
+        printf("Play for %d seconds.\n", NUM_SECONDS );
+        //! 再生中は、プロセッサの出力パラメータの変更をコントローラに反映し続ける
+        auto const play_end = std::chrono::steady_clock::now() + std::chrono::seconds(NUM_SECONDS);
+        while(std::chrono::steady_clock::now() < play_end) {
+            plugin->OnIdle();
+            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        }
+        device->Stop();
+
+        printf("Stream Completed. xruns : %d\n", (int)device->GetNumXruns());
+        if(auto *null_device = dynamic_cast<hwm::NullAudioDevice *>(device.get())) {
+            auto const stat = null_device->GetStatistics();
+            double const block_seconds = (double)FRAMES_PER_BUFFER / SAMPLE_RATE;
+            double const average = stat.num_callbacks_ ? stat.total_callback_seconds_ / stat.num_callbacks_ : 0;
+            printf("Callbacks : %llu, average : %.3f ms (%.1f%% of a block), max : %.3f ms, x%.2f realtime\n",
+                   (unsigned long long)stat.num_callbacks_,
+                   average * 1000,
+                   average / block_seconds * 100,
+                   stat.max_callback_seconds_ * 1000,
+                   stat.elapsed_seconds_ > 0 ? (stat.num_frames_ / (double)SAMPLE_RATE) / stat.elapsed_seconds_ : 0);
+        }
+        device->Close();
+    } catch(std::exception &e) {
+        fprintf( stderr, "An error occured while using the audio device\n" );
+        fprintf( stderr, "Error message: %s\n", e.what() );
+        plugin->Suspend();
+        return 1;
+    }
+
     printf("Test finished.\n");
-    
+
     plugin->Suspend();
     plugin.reset();
-    
-    return err;
-error:
-    Pa_Terminate();
-    fprintf( stderr, "An error occured while using the portaudio stream\n" );
-    fprintf( stderr, "Error number: %d\n", err );
-    fprintf( stderr, "Error message: %s\n", Pa_GetErrorText( err ) );
-    return err;
+
+    return 0;
 }